@@ -1,6 +1,8 @@
 // App.cpp
 #include "App.h"
 #include "CoreServices.h"
+#include "FileMapping.h"
+#include "MemoryBudget.h"
 
 #include <windows.h>
 #include <commctrl.h>
@@ -8,8 +10,11 @@
 
 #include <cstdint>
 #include <cwchar>
+#include <list>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 #include <algorithm>
 
 #pragma comment(lib, "Comctl32.lib")
@@ -107,6 +112,84 @@ namespace EmbedPack
             return (int)sz.cx;
         }
 
+        // Generated headers are ASCII, so the first bytes of a spill file widen one to one.
+        static std::wstring ReadPreview(const std::wstring& path)
+        {
+            constexpr DWORD PREVIEW_BYTES = 64u * 1024u;
+
+            HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (h == INVALID_HANDLE_VALUE)
+                return {};
+
+            std::string text(PREVIEW_BYTES, '\0');
+            DWORD read = 0;
+            if (!ReadFile(h, &text[0], PREVIEW_BYTES, &read, nullptr))
+                read = 0;
+            CloseHandle(h);
+
+            text.resize(read);
+            return std::wstring(text.begin(), text.end()) + L"\r\n...";
+        }
+
+        // Takes the result of a job nobody waits for any more and deletes its spill file, if any.
+        static void DiscardResult(Converter::ConversionHandle& job)
+        {
+            const Converter::ConversionResult r = job.Take();
+            if (!r.spillPath.empty())
+                DeleteFileW(r.spillPath.c_str());
+        }
+
+        // Finished in-memory outputs of the selected file, one per format, most recently used
+        // first. Each entry holds a memory budget reservation, so cached text counts against the
+        // budget like a running job's, and older entries make way when a new one does not fit.
+        class OutputCache final
+        {
+        public:
+            static constexpr size_t MAX_ENTRIES = 8u;
+
+            std::shared_ptr<const Text::Rope> Find(const Converter::Format& fmt)
+            {
+                for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+                {
+                    if (it->format == fmt)
+                    {
+                        m_entries.splice(m_entries.begin(), m_entries, it);
+                        return it->text;
+                    }
+                }
+                return nullptr;
+            }
+
+            void Insert(const Converter::Format& fmt, std::shared_ptr<const Text::Rope> text)
+            {
+                m_entries.remove_if([&](const Entry& e) { return e.format == fmt; });
+
+                Memory::Reservation memory;
+                while (!Memory::TryReserve(text->Size(), memory))
+                {
+                    if (m_entries.empty())
+                        return;
+                    m_entries.pop_back();
+                }
+
+                if (m_entries.size() == MAX_ENTRIES)
+                    m_entries.pop_back();
+                m_entries.push_front(Entry{ fmt, std::move(text), std::move(memory) });
+            }
+
+            void Clear() noexcept { m_entries.clear(); }
+
+        private:
+            struct Entry
+            {
+                Converter::Format format;
+                std::shared_ptr<const Text::Rope> text;
+                Memory::Reservation memory;
+            };
+
+            std::list<Entry> m_entries;
+        };
+
         static std::wstring NormalizeSlashes(std::wstring s)
         {
             for (auto& ch : s)
@@ -298,8 +381,26 @@ namespace EmbedPack
 
         constexpr int ID_TT_PATH = 2001;
 
-        constexpr int ID_CMB_TYPE  = 3001;
-        constexpr int ID_CMB_STYLE = 3002;
+        constexpr int ID_CMB_TYPE   = 3001;
+        constexpr int ID_CMB_STYLE  = 3002;
+        constexpr int ID_CMB_LAYOUT = 3003;
+
+        struct LayoutPreset
+        {
+            const wchar_t* label;
+            uint32_t alignment;
+            const char* sectionName;
+            Converter::TailPadding tailPadding;
+        };
+
+        static const LayoutPreset kLayoutPresets[] = {
+            { L"Default layout",                     0u,    "",         Converter::TailPadding::None },
+            { L"alignas(16)",                        16u,   "",         Converter::TailPadding::None },
+            { L"alignas(32)",                        32u,   "",         Converter::TailPadding::None },
+            { L"alignas(64), cache-line padded",     64u,   "",         Converter::TailPadding::CacheLine },
+            { L"alignas(4096), page padded",         4096u, "",         Converter::TailPadding::Page },
+            { L"alignas(4096), page padded, .embpack", 4096u, ".embpack", Converter::TailPadding::Page },
+        };
 
         struct Layout
         {
@@ -316,12 +417,13 @@ namespace EmbedPack
 
             int editPad = 12;
 
-            int comboTypeW  = 140;
-            int comboStyleW = 200;
-            int comboH      = 28;
+            int comboTypeW   = 140;
+            int comboStyleW  = 200;
+            int comboLayoutW = 220;
+            int comboH       = 28;
         };
 
-        constexpr int MIN_CLIENT_W_96 = 600;
+        constexpr int MIN_CLIENT_W_96 = 720;
         constexpr int MIN_CLIENT_H_96 = 400;
 
         bool AdjustWindowRectExForDpiSafe(RECT* rc, DWORD style, BOOL hasMenu, DWORD exStyle, UINT dpi)
@@ -355,32 +457,19 @@ namespace EmbedPack
             return pt;
         }
 
-        struct StreamCookie
-        {
-            const BYTE* bytes = nullptr;
-            size_t sizeBytes = 0;
-            size_t posBytes = 0;
-        };
-
+        // The cookie is a Text::Rope::Reader; the edit control pulls the text chunk by chunk.
         DWORD CALLBACK RichEditStreamInCallback(DWORD_PTR cookie, LPBYTE buffer, LONG cb, LONG* pcb)
         {
             if (!pcb) return 1;
 
-            StreamCookie* sc = reinterpret_cast<StreamCookie*>(cookie);
-            if (!sc || !sc->bytes || sc->posBytes > sc->sizeBytes)
+            Text::Rope::Reader* reader = reinterpret_cast<Text::Rope::Reader*>(cookie);
+            if (!reader || cb <= 0)
             {
                 *pcb = 0;
                 return 0;
             }
 
-            const size_t remaining = sc->sizeBytes - sc->posBytes;
-            const size_t toCopy = std::min<size_t>((size_t)cb, remaining);
-
-            if (toCopy > 0)
-                memcpy(buffer, sc->bytes + sc->posBytes, toCopy);
-
-            sc->posBytes += toCopy;
-            *pcb = (LONG)toCopy;
+            *pcb = (LONG)reader->Read(buffer, (size_t)cb);
             return 0;
         }
 
@@ -410,13 +499,20 @@ namespace EmbedPack
             void OnConvert();
             void OnCopy();
             void OnProgress(int pct);
-            void OnDone(bool ok, wchar_t* heapMsg);
+            void OnDone(uint64_t jobId);
+            void DiscardSpill();
+            void ShowOutput(std::shared_ptr<const Text::Rope> text);
+
+            void StartSpeculation();
+            void CancelSpeculation();
+            void OnFormatChanged();
 
             void LockUi(bool lock);
             void UpdateStatusText(const std::wstring& s);
             void UpdatePathText(const std::wstring& s);
             void UpdatePathTooltip();
             void SetOutputText(const std::wstring& s);
+            void SetOutputText(const Text::Rope& text);
             void SetBusyCursor(bool busy);
             void InvalidateToolbarAndStatus();
 
@@ -426,6 +522,7 @@ namespace EmbedPack
             void PopulateDropdowns();
             void OnArrayTypeChanged();
             void OnArrayStyleChanged();
+            void OnArrayLayoutChanged();
 
             void TrackHotButton(HWND btn);
             void SetButtonHot(HWND btn, bool hot);
@@ -447,6 +544,7 @@ namespace EmbedPack
 
             HWND m_cmbType = nullptr;
             HWND m_cmbStyle = nullptr;
+            HWND m_cmbLayout = nullptr;
 
             HWND m_lblPath = nullptr;
             HWND m_editOutput = nullptr;
@@ -466,7 +564,21 @@ namespace EmbedPack
             Converter::Format m_format{};
 
             std::wstring m_selectedFilePath;
-            std::wstring m_outputW;
+            // The selected file stays mapped until another one replaces it; every job on it
+            // reads this view.
+            std::shared_ptr<const FileIo::MappedInput> m_input;
+            std::shared_ptr<const Text::Rope> m_output;
+            // Output over the memory budget, left in a temp file until saved or discarded.
+            std::wstring m_spillPath;
+            Converter::ConversionHandle m_job;
+            Converter::Format m_jobFormat{};
+            // Low-priority conversion of the selected file for the current format, started before
+            // the user asks for it; its result only fills m_cache.
+            Converter::ConversionHandle m_specJob;
+            Converter::Format m_specFormat{};
+            // Cancelled speculative jobs, kept until they report back so their results are freed.
+            std::vector<Converter::ConversionHandle> m_abandoned;
+            OutputCache m_cache;
             std::wstring m_statusText = L"Ready";
             std::wstring m_pathText = L"No input file selected";
 
@@ -507,9 +619,10 @@ namespace EmbedPack
             m_lay.gap = DpiScale(10, m_dpi);
             m_lay.editPad = DpiScale(12, m_dpi);
 
-            m_lay.comboTypeW  = DpiScale(160, m_dpi);
-            m_lay.comboStyleW = DpiScale(200, m_dpi);
-            m_lay.comboH      = DpiScale(28, m_dpi);
+            m_lay.comboTypeW   = DpiScale(180, m_dpi);
+            m_lay.comboStyleW  = DpiScale(200, m_dpi);
+            m_lay.comboLayoutW = DpiScale(220, m_dpi);
+            m_lay.comboH       = DpiScale(28, m_dpi);
 
             if (m_fontUi) { DeleteObject(m_fontUi); m_fontUi = nullptr; }
             if (m_fontMono) { DeleteObject(m_fontMono); m_fontMono = nullptr; }
@@ -538,6 +651,7 @@ namespace EmbedPack
 
             if (m_cmbType)    SendMessageW(m_cmbType,    WM_SETFONT, (WPARAM)m_fontUi, TRUE);
             if (m_cmbStyle)   SendMessageW(m_cmbStyle,   WM_SETFONT, (WPARAM)m_fontUi, TRUE);
+            if (m_cmbLayout)  SendMessageW(m_cmbLayout,  WM_SETFONT, (WPARAM)m_fontUi, TRUE);
 
             if (m_lblPath)    SendMessageW(m_lblPath,    WM_SETFONT, (WPARAM)m_fontUi, TRUE);
             if (m_editOutput) SendMessageW(m_editOutput, WM_SETFONT, (WPARAM)m_fontMono, TRUE);
@@ -574,17 +688,22 @@ namespace EmbedPack
             struct TypeItem
             {
                 Converter::ElementType type;
+                Converter::ByteOrder order;
                 const wchar_t* label;
             };
 
+            using Converter::ByteOrder;
             static const TypeItem kTypes[] = {
-                { Converter::ElementType::UnsignedChar,  L"unsigned char" },
-                { Converter::ElementType::Uint8,         L"uint8_t" },
-                { Converter::ElementType::StdByte,       L"std::byte" },
-                { Converter::ElementType::UnsignedShort, L"unsigned short" },
-                { Converter::ElementType::Uint16,        L"uint16_t" },
-                { Converter::ElementType::Uint32,        L"uint32_t" },
-                { Converter::ElementType::Uint64,        L"uint64_t" },
+                { Converter::ElementType::UnsignedChar,  ByteOrder::LittleEndian, L"unsigned char" },
+                { Converter::ElementType::Uint8,         ByteOrder::LittleEndian, L"uint8_t" },
+                { Converter::ElementType::StdByte,       ByteOrder::LittleEndian, L"std::byte" },
+                { Converter::ElementType::UnsignedShort, ByteOrder::LittleEndian, L"unsigned short" },
+                { Converter::ElementType::Uint16,        ByteOrder::LittleEndian, L"uint16_t" },
+                { Converter::ElementType::Uint32,        ByteOrder::LittleEndian, L"uint32_t" },
+                { Converter::ElementType::Uint64,        ByteOrder::LittleEndian, L"uint64_t" },
+                { Converter::ElementType::Uint16,        ByteOrder::BigEndian,    L"uint16_t (big-endian)" },
+                { Converter::ElementType::Uint32,        ByteOrder::BigEndian,    L"uint32_t (big-endian)" },
+                { Converter::ElementType::Uint64,        ByteOrder::BigEndian,    L"uint64_t (big-endian)" },
             };
 
             if (m_cmbType)
@@ -593,7 +712,8 @@ namespace EmbedPack
                 for (const auto& t : kTypes)
                 {
                     const int idx = (int)SendMessageW(m_cmbType, CB_ADDSTRING, 0, (LPARAM)t.label);
-                    SendMessageW(m_cmbType, CB_SETITEMDATA, idx, (LPARAM)static_cast<int>(t.type));
+                    const int data = static_cast<int>(t.type) | (static_cast<int>(t.order) << 8);
+                    SendMessageW(m_cmbType, CB_SETITEMDATA, idx, (LPARAM)data);
                 }
                 SendMessageW(m_cmbType, CB_SETCURSEL, 0, 0);
                 OnArrayTypeChanged();
@@ -624,6 +744,18 @@ namespace EmbedPack
                 SendMessageW(m_cmbStyle, CB_SETCURSEL, 0, 0);
                 OnArrayStyleChanged();
             }
+
+            if (m_cmbLayout)
+            {
+                SendMessageW(m_cmbLayout, CB_RESETCONTENT, 0, 0);
+                for (size_t i = 0; i < std::size(kLayoutPresets); ++i)
+                {
+                    const int idx = (int)SendMessageW(m_cmbLayout, CB_ADDSTRING, 0, (LPARAM)kLayoutPresets[i].label);
+                    SendMessageW(m_cmbLayout, CB_SETITEMDATA, idx, (LPARAM)i);
+                }
+                SendMessageW(m_cmbLayout, CB_SETCURSEL, 0, 0);
+                OnArrayLayoutChanged();
+            }
         }
 
         void UiWindow::OnArrayTypeChanged()
@@ -636,7 +768,9 @@ namespace EmbedPack
                 return;
 
             const auto typeVal = static_cast<int>(SendMessageW(m_cmbType, CB_GETITEMDATA, idx, 0));
-            m_format.elementType = static_cast<Converter::ElementType>(typeVal);
+            m_format.elementType = static_cast<Converter::ElementType>(typeVal & 0xFF);
+            m_format.byteOrder = static_cast<Converter::ByteOrder>((typeVal >> 8) & 0xFF);
+            OnFormatChanged();
         }
 
         void UiWindow::OnArrayStyleChanged()
@@ -650,6 +784,84 @@ namespace EmbedPack
 
             const auto styleVal = static_cast<int>(SendMessageW(m_cmbStyle, CB_GETITEMDATA, idx, 0));
             m_format.arrayStyle = static_cast<Converter::ArrayStyle>(styleVal);
+            OnFormatChanged();
+        }
+
+        void UiWindow::OnArrayLayoutChanged()
+        {
+            if (!m_cmbLayout)
+                return;
+
+            const int idx = (int)SendMessageW(m_cmbLayout, CB_GETCURSEL, 0, 0);
+            if (idx < 0)
+                return;
+
+            const auto presetIdx = static_cast<size_t>(SendMessageW(m_cmbLayout, CB_GETITEMDATA, idx, 0));
+            if (presetIdx >= std::size(kLayoutPresets))
+                return;
+
+            const LayoutPreset& p = kLayoutPresets[presetIdx];
+            m_format.alignment = p.alignment;
+            m_format.sectionName = p.sectionName;
+            m_format.tailPadding = p.tailPadding;
+            OnFormatChanged();
+        }
+
+        // An output on screen is swapped for the new format's right away when that is cached;
+        // otherwise the new format is prepared in the background.
+        void UiWindow::OnFormatChanged()
+        {
+            if (m_job.Valid() || m_selectedFilePath.empty())
+                return;
+
+            if (m_output)
+            {
+                if (std::shared_ptr<const Text::Rope> cached = m_cache.Find(m_format))
+                {
+                    ShowOutput(std::move(cached));
+                    UpdateStatusText(L"Done");
+                    return;
+                }
+            }
+
+            StartSpeculation();
+        }
+
+        void UiWindow::StartSpeculation()
+        {
+            if (m_job.Valid() || m_selectedFilePath.empty())
+                return;
+            if (m_specJob.Valid() && m_specFormat == m_format)
+                return;
+            if (m_cache.Find(m_format))
+                return;
+
+            CancelSpeculation();
+
+            // Outputs that would spill are left for an explicit Convert.
+            const uint64_t inputBytes = m_input ? m_input->size : 0u;
+            if (Converter::PredictOutputBytes(m_format, inputBytes) > Memory::Budget() / Memory::IN_MEMORY_BYTES_PER_CHAR)
+                return;
+
+            Converter::Job job{};
+            job.hwndNotify = m_hwnd;
+            job.inPath = m_selectedFilePath;
+            job.input = m_input;
+            job.format = m_format;
+            job.priority = Threading::Priority::Low;
+
+            m_specJob = Converter::StartConversionAsync(job);
+            m_specFormat = m_format;
+        }
+
+        void UiWindow::CancelSpeculation()
+        {
+            if (!m_specJob.Valid())
+                return;
+
+            m_specJob.Cancel();
+            m_abandoned.push_back(std::move(m_specJob));
+            m_specJob = {};
         }
 
         void UiWindow::CacheEditRect()
@@ -730,6 +942,13 @@ namespace EmbedPack
         }
 
         void UiWindow::SetOutputText(const std::wstring& s)
+        {
+            Text::Rope text;
+            text.Append(s.data(), s.size());
+            SetOutputText(text);
+        }
+
+        void UiWindow::SetOutputText(const Text::Rope& text)
         {
             if (!m_editOutput)
                 return;
@@ -739,13 +958,10 @@ namespace EmbedPack
             SendMessageW(m_editOutput, EM_SETSEL, 0, -1);
             SendMessageW(m_editOutput, EM_REPLACESEL, FALSE, (LPARAM)L"");
 
-            StreamCookie sc{};
-            sc.bytes = reinterpret_cast<const BYTE*>(s.data());
-            sc.sizeBytes = s.size() * sizeof(wchar_t);
-            sc.posBytes = 0;
+            Text::Rope::Reader reader(text);
 
             EDITSTREAM es{};
-            es.dwCookie = (DWORD_PTR)&sc;
+            es.dwCookie = (DWORD_PTR)&reader;
             es.dwError = 0;
             es.pfnCallback = RichEditStreamInCallback;
 
@@ -854,6 +1070,14 @@ namespace EmbedPack
                 right -= gap;
             }
 
+            if (m_cmbLayout)
+            {
+                const int w = m_lay.comboLayoutW;
+                right -= w;
+                SetWindowPos(m_cmbLayout, nullptr, right, comboY, w, comboDropH, SWP_NOZORDER | SWP_NOACTIVATE);
+                right -= gap;
+            }
+
             const int editY = y + toolbarH + pad;
             const int editH = innerH - pad;
             const int editX = x;
@@ -966,6 +1190,7 @@ namespace EmbedPack
 
             clampRightForCtrl(m_cmbType);
             clampRightForCtrl(m_cmbStyle);
+            clampRightForCtrl(m_cmbLayout);
 
             if (sRc.right < sRc.left)
                 sRc.right = sRc.left;
@@ -1024,6 +1249,12 @@ namespace EmbedPack
                 0, 0, 0, 0,
                 m_hwnd, (HMENU)(INT_PTR)ID_CMB_STYLE, m_hInstance, nullptr);
 
+            m_cmbLayout = CreateWindowExW(
+                0, L"COMBOBOX", nullptr,
+                WS_CHILD | WS_VISIBLE | WS_TABSTOP | CBS_DROPDOWNLIST | CBS_HASSTRINGS,
+                0, 0, 0, 0,
+                m_hwnd, (HMENU)(INT_PTR)ID_CMB_LAYOUT, m_hInstance, nullptr);
+
             m_lblPath = CreateWindowExW(
                 0, L"STATIC", L"",
                 WS_CHILD | WS_VISIBLE | SS_LEFT | SS_CENTERIMAGE | SS_PATHELLIPSIS | SS_NOPREFIX,
@@ -1089,6 +1320,27 @@ namespace EmbedPack
             if (m_ttPath) { DestroyWindow(m_ttPath); m_ttPath = nullptr; }
 
             if (m_hMsftEdit) { FreeLibrary(m_hMsftEdit); m_hMsftEdit = nullptr; }
+
+            // The user's conversion is cancelled too: cancelled speculative jobs still queued
+            // would otherwise wait behind it for a worker, holding up the close until it is done.
+            CancelSpeculation();
+            if (m_job.Valid())
+                m_job.Cancel();
+            for (Converter::ConversionHandle& job : m_abandoned)
+            {
+                job.Wait();
+                DiscardResult(job);
+            }
+            m_abandoned.clear();
+            if (m_job.Valid())
+            {
+                m_job.Wait();
+                DiscardResult(m_job);
+                m_job = {};
+            }
+            m_cache.Clear();
+
+            DiscardSpill();
         }
 
         bool UiWindow::CreateAndShow(int nCmdShow)
@@ -1161,16 +1413,29 @@ namespace EmbedPack
             if (!FileDialogs::PromptOpenInputFile(m_hwnd, path))
                 return;
 
+            CancelSpeculation();
+            m_cache.Clear();
+
             m_selectedFilePath = std::move(path);
-            m_outputW.clear();
+            m_output.reset();
+            DiscardSpill();
             EnableWindow(m_btnCopy, FALSE);
 
+            // A file that cannot be mapped now is left to the conversion, which reports why.
+            auto input = std::make_shared<FileIo::MappedInput>();
+            std::wstring mapErr;
+            if (FileIo::MapInputFile(m_selectedFilePath, *input, mapErr))
+                m_input = std::move(input);
+            else
+                m_input.reset();
+
             UpdatePathText(m_selectedFilePath);
             UpdateStatusText(L"Ready");
             m_progress = 0;
             m_lastOk = true;
 
             SetOutputText(L"File selected.\r\nClick Convert to generate output.");
+            StartSpeculation();
         }
 
         void UiWindow::LockUi(bool lock)
@@ -1180,7 +1445,7 @@ namespace EmbedPack
             EnableWindow(m_btnSelect,  lock ? FALSE : TRUE);
             EnableWindow(m_btnConvert, lock ? FALSE : TRUE);
 
-            const bool canCopy = (!lock && !m_outputW.empty());
+            const bool canCopy = (!lock && (m_output || !m_spillPath.empty()));
             EnableWindow(m_btnCopy, canCopy ? TRUE : FALSE);
 
             InvalidateRect(m_btnSelect, nullptr, TRUE);
@@ -1196,51 +1461,50 @@ namespace EmbedPack
                 return;
             }
 
-            uint64_t fsize = 0;
-            if (!Converter::GetFileSizeU64(m_selectedFilePath, fsize))
-            {
-                MessageBoxW(m_hwnd, L"Failed to query file size.", L"Error", MB_OK | MB_ICONERROR);
-                return;
-            }
-
-            const bool largeMode = (fsize > Converter::UI_SOFT_LIMIT);
+            DiscardSpill();
+            m_progress = 0;
+            m_lastOk = true;
 
-            std::wstring outPath;
-            if (largeMode)
+            if (std::shared_ptr<const Text::Rope> cached = m_cache.Find(m_format))
             {
-                if (!FileDialogs::PromptSaveOutputPath(m_hwnd, m_selectedFilePath, outPath))
-                    return;
+                ShowOutput(std::move(cached));
+                UpdateStatusText(L"Done");
+                return;
             }
 
             LockUi(true);
             SetBusyCursor(true);
-            m_outputW.clear();
-            m_progress = 0;
-            m_lastOk = true;
+            m_output.reset();
 
-            if (largeMode)
-            {
-                UpdateStatusText(L"Converting (large file mode: saving to disk) ...");
-                SetOutputText(L"Converting large file.\r\nOutput will be saved to the selected file.\r\n\r\nProgress: 0%");
-            }
-            else
+            UpdateStatusText(L"Converting ...");
+            SetOutputText(L"Converting ...\r\n\r\nProgress: 0%");
+
+            m_jobFormat = m_format;
+
+            // A speculative job for this format is already under way; it becomes this conversion.
+            if (m_specJob.Valid() && m_specFormat == m_format)
             {
-                UpdateStatusText(L"Converting ...");
-                SetOutputText(L"Converting ...\r\n\r\nProgress: 0%");
+                m_job = std::move(m_specJob);
+                m_specJob = {};
+                InvalidateToolbarAndStatus();
+                return;
             }
+            CancelSpeculation();
 
+            // Small mode decides on its own whether the output fits in memory; one that does not
+            // comes back as a spill file, offered through the Save button.
             Converter::Job job{};
             job.hwndNotify = m_hwnd;
             job.inPath = m_selectedFilePath;
-            job.outPath = outPath;
-            job.largeMode = largeMode;
+            job.input = m_input;
             job.format = m_format;
 
-            if (!Converter::StartConversionAsync(job, m_outputW))
+            m_job = Converter::StartConversionAsync(job);
+            if (!m_job.Valid())
             {
                 SetBusyCursor(false);
                 LockUi(false);
-                MessageBoxW(m_hwnd, L"Failed to start worker thread.", L"Error", MB_OK | MB_ICONERROR);
+                MessageBoxW(m_hwnd, L"Failed to queue the conversion job.", L"Error", MB_OK | MB_ICONERROR);
                 return;
             }
 
@@ -1249,19 +1513,43 @@ namespace EmbedPack
 
         void UiWindow::OnCopy()
         {
-            if (m_outputW.empty())
+            if (!m_spillPath.empty())
+            {
+                std::wstring outPath;
+                if (!FileDialogs::PromptSaveOutputPath(m_hwnd, m_selectedFilePath, outPath))
+                    return;
+
+                if (!MoveFileExW(m_spillPath.c_str(), outPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED))
+                {
+                    MessageBoxW(m_hwnd, L"Failed to save the output file.", L"Error", MB_OK | MB_ICONERROR);
+                    return;
+                }
+
+                m_spillPath.clear();
+                SetWindowTextW(m_btnCopy, L"Copy");
+                EnableWindow(m_btnCopy, FALSE);
+                UpdateStatusText(L"Saved");
+                SetOutputText(L"OK: saved to file:\r\n" + outPath);
+                return;
+            }
+
+            if (!m_output)
             {
                 MessageBoxW(m_hwnd, L"No data to copy.", L"Error", MB_OK | MB_ICONERROR);
                 return;
             }
 
-            Clipboard::SetClipboardUnicode(m_hwnd, m_outputW);
+            Clipboard::SetClipboardUnicode(m_hwnd, *m_output);
             UpdateStatusText(L"Copied to clipboard");
             MessageBoxW(m_hwnd, L"Copied to clipboard.", L"Success", MB_OK | MB_ICONINFORMATION);
         }
 
         void UiWindow::OnProgress(int pct)
         {
+            // Speculative jobs post progress as well; only a conversion the user started shows it.
+            if (!m_job.Valid())
+                return;
+
             m_progress = pct;
             if (pct < 0) m_progress = 0;
             if (pct > 100) m_progress = 100;
@@ -1283,8 +1571,44 @@ namespace EmbedPack
             InvalidateToolbarAndStatus();
         }
 
-        void UiWindow::OnDone(bool ok, wchar_t* heapMsg)
+        void UiWindow::OnDone(uint64_t jobId)
         {
+            for (auto it = m_abandoned.begin(); it != m_abandoned.end(); ++it)
+            {
+                if (it->Id() == jobId)
+                {
+                    DiscardResult(*it);
+                    m_abandoned.erase(it);
+                    return;
+                }
+            }
+
+            if (m_specJob.Valid() && m_specJob.Id() == jobId)
+            {
+                Converter::ConversionResult result = m_specJob.Take();
+                m_specJob = {};
+
+                if (result.ok && result.spillPath.empty())
+                    m_cache.Insert(m_specFormat, std::make_shared<const Text::Rope>(std::move(result.output)));
+                else if (!result.spillPath.empty())
+                    DeleteFileW(result.spillPath.c_str());
+                return;
+            }
+
+            if (!m_job.Valid() || m_job.Id() != jobId)
+                return;
+
+            Converter::ConversionResult result = m_job.Take();
+            m_job = {};
+
+            const bool ok = result.ok;
+            if (ok && result.spillPath.empty() && !result.output.Empty())
+            {
+                m_output = std::make_shared<const Text::Rope>(std::move(result.output));
+                m_cache.Insert(m_jobFormat, m_output);
+            }
+            m_spillPath = std::move(result.spillPath);
+
             SetBusyCursor(false);
             LockUi(false);
 
@@ -1294,32 +1618,57 @@ namespace EmbedPack
             if (ok)
             {
                 UpdateStatusText(L"Done");
-                if (!m_outputW.empty())
+                if (!m_spillPath.empty())
                 {
-                    SetOutputText(m_outputW);
+                    SetOutputText(L"The output is over the memory budget and was written to a temporary file.\r\n"
+                                  L"Click Save to keep it. It starts with:\r\n\r\n" + ReadPreview(m_spillPath));
+                    SetWindowTextW(m_btnCopy, L"Save");
+                    EnableWindow(m_btnCopy, TRUE);
+                }
+                else if (m_output)
+                {
+                    SetOutputText(*m_output);
                     EnableWindow(m_btnCopy, TRUE);
                 }
                 else
                 {
-                    if (heapMsg)
-                        SetOutputText(heapMsg);
+                    SetOutputText(result.message);
                     EnableWindow(m_btnCopy, FALSE);
                 }
             }
             else
             {
                 UpdateStatusText(L"Error");
-                if (heapMsg)
-                    SetOutputText(heapMsg);
+                SetOutputText(result.message);
                 EnableWindow(m_btnCopy, FALSE);
             }
 
-            if (heapMsg)
-                HeapFree(GetProcessHeap(), 0, heapMsg);
+            InvalidateToolbarAndStatus();
+        }
+
+        void UiWindow::ShowOutput(std::shared_ptr<const Text::Rope> text)
+        {
+            DiscardSpill();
+            m_output = std::move(text);
+            m_progress = 100;
+            m_lastOk = true;
 
+            SetOutputText(*m_output);
+            EnableWindow(m_btnCopy, TRUE);
             InvalidateToolbarAndStatus();
         }
 
+        void UiWindow::DiscardSpill()
+        {
+            if (m_spillPath.empty())
+                return;
+
+            DeleteFileW(m_spillPath.c_str());
+            m_spillPath.clear();
+            if (m_btnCopy)
+                SetWindowTextW(m_btnCopy, L"Copy");
+        }
+
         LRESULT UiWindow::HandleMessage(UINT msg, WPARAM wParam, LPARAM lParam)
         {
             switch (msg)
@@ -1367,6 +1716,9 @@ namespace EmbedPack
                 case ID_CMB_STYLE:
                     if (HIWORD(wParam) == CBN_SELCHANGE) OnArrayStyleChanged();
                     return 0;
+                case ID_CMB_LAYOUT:
+                    if (HIWORD(wParam) == CBN_SELCHANGE) OnArrayLayoutChanged();
+                    return 0;
                 default: break;
                 }
                 return 0;
@@ -1409,7 +1761,7 @@ namespace EmbedPack
                 return 0;
 
             case AppMessages::WM_APP_DONE:
-                OnDone(wParam == 1, reinterpret_cast<wchar_t*>(lParam));
+                OnDone(static_cast<uint64_t>(lParam));
                 return 0;
 
             default:
@@ -1486,6 +1838,9 @@ namespace EmbedPack
             TranslateMessage(&msg);
             DispatchMessageW(&msg);
         }
+
+        // Stop workers before exit so no job keeps writing after the process starts tearing down.
+        Converter::ShutdownWorkers(Threading::ShutdownMode::Cancel);
         return (int)msg.wParam;
     }
 }
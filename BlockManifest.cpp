@@ -0,0 +1,166 @@
+// BlockManifest.cpp
+#include "BlockManifest.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace EmbedPack::Incremental
+{
+    namespace
+    {
+        static constexpr char MAGIC[8] = { 'E', 'P', 'M', 'A', 'N', 'I', 'F', '1' };
+
+        // magic, blockSize, inputSize, formatHash, outputSize, outputWriteTime, blockCount
+        static constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 4u + 5u * 8u;
+
+        template <typename T>
+        static void Put(std::string& out, T v)
+        {
+            out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+
+        template <typename T>
+        static T Get(const uint8_t*& p)
+        {
+            T v;
+            std::memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            return v;
+        }
+
+        static bool QueryOutput(const std::wstring& outPath, uint64_t& size, uint64_t& writeTime)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA fad{};
+            if (!GetFileAttributesExW(outPath.c_str(), GetFileExInfoStandard, &fad))
+                return false;
+
+            size = (static_cast<uint64_t>(fad.nFileSizeHigh) << 32u) | fad.nFileSizeLow;
+            writeTime = (static_cast<uint64_t>(fad.ftLastWriteTime.dwHighDateTime) << 32u) |
+                        fad.ftLastWriteTime.dwLowDateTime;
+            return true;
+        }
+    }
+
+    std::wstring ManifestPath(const std::wstring& outPath)
+    {
+        return outPath + L".epm";
+    }
+
+    uint64_t HashFormat(const Converter::Format& fmt)
+    {
+        std::string key;
+        Put(key, static_cast<uint8_t>(fmt.elementType));
+        Put(key, static_cast<uint8_t>(fmt.arrayStyle));
+        Put(key, static_cast<uint8_t>(fmt.byteOrder));
+        Put(key, static_cast<uint8_t>(fmt.tailPadding));
+        Put(key, static_cast<uint8_t>(fmt.checksum));
+        Put(key, static_cast<uint8_t>(fmt.zeroElision));
+        // Only when set, so manifests written before the option existed keep matching.
+        if (fmt.textLiteral != Converter::TextLiteral::Never)
+            Put(key, static_cast<uint8_t>(fmt.textLiteral));
+        Put(key, fmt.alignment);
+        key.append(fmt.sectionName);
+        return Hashing::Xxh64(key.data(), key.size());
+    }
+
+    void HashBlocks(const uint8_t* data, size_t size, BlockManifest& m, const BlockVisitor& visit)
+    {
+        m.inputSize = size;
+
+        const size_t count = (size + m.blockSize - 1u) / m.blockSize;
+        m.blockHashes.resize(count);
+        for (size_t i = 0u; i < count; ++i)
+        {
+            const size_t offset = i * m.blockSize;
+            const size_t length = std::min<size_t>(m.blockSize, size - offset);
+            m.blockHashes[i] = Hashing::Xxh64(data + offset, length);
+            if (visit)
+                visit(data + offset, length);
+        }
+    }
+
+    bool CanPatch(const BlockManifest& prev, const BlockManifest& next, const std::wstring& outPath)
+    {
+        if (prev.blockSize != next.blockSize || prev.inputSize != next.inputSize || prev.formatHash != next.formatHash)
+            return false;
+
+        uint64_t size = 0u, writeTime = 0u;
+        return QueryOutput(outPath, size, writeTime) && size == prev.outputSize && writeTime == prev.outputWriteTime;
+    }
+
+    bool RecordOutput(const std::wstring& outPath, BlockManifest& m)
+    {
+        return QueryOutput(outPath, m.outputSize, m.outputWriteTime);
+    }
+
+    bool LoadManifest(const std::wstring& path, BlockManifest& m)
+    {
+        if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+            return false;
+
+        FileIo::MappedInput input;
+        std::wstring err;
+        if (!FileIo::MapInputFile(path, input, err) || input.size < HEADER_SIZE + 8u)
+            return false;
+
+        const uint8_t* p = input.data();
+        const uint64_t checksum = Hashing::Xxh64(p, input.size - 8u);
+        uint64_t stored = 0u;
+        std::memcpy(&stored, p + input.size - 8u, sizeof(stored));
+        if (checksum != stored || std::memcmp(p, MAGIC, sizeof(MAGIC)) != 0)
+            return false;
+        p += sizeof(MAGIC);
+
+        m.blockSize = Get<uint32_t>(p);
+        m.inputSize = Get<uint64_t>(p);
+        m.formatHash = Get<uint64_t>(p);
+        m.outputSize = Get<uint64_t>(p);
+        m.outputWriteTime = Get<uint64_t>(p);
+        const uint64_t count = Get<uint64_t>(p);
+
+        if (m.blockSize == 0u || count != (input.size - HEADER_SIZE - 8u) / 8u)
+            return false;
+
+        m.blockHashes.resize(static_cast<size_t>(count));
+        std::memcpy(m.blockHashes.data(), p, static_cast<size_t>(count) * 8u);
+        return true;
+    }
+
+    bool SaveManifest(const std::wstring& path, const BlockManifest& m, std::wstring& err)
+    {
+        std::string data;
+        data.reserve(HEADER_SIZE + (m.blockHashes.size() + 1u) * 8u);
+        data.append(MAGIC, sizeof(MAGIC));
+        Put(data, m.blockSize);
+        Put(data, m.inputSize);
+        Put(data, m.formatHash);
+        Put(data, m.outputSize);
+        Put(data, m.outputWriteTime);
+        Put(data, static_cast<uint64_t>(m.blockHashes.size()));
+        data.append(reinterpret_cast<const char*>(m.blockHashes.data()), m.blockHashes.size() * 8u);
+        Put(data, Hashing::Xxh64(data.data(), data.size()));
+
+        // Written aside and renamed so a reader never sees a half-written manifest.
+        const std::wstring tmp = path + L".tmp";
+        {
+            FileIo::Handle h(CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+            if (!h.valid())
+            {
+                err = L"Failed to create manifest file.";
+                return false;
+            }
+            if (!FileIo::WriteAll(h, data.data(), static_cast<DWORD>(data.size()), err))
+                return false;
+        }
+
+        if (!MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileW(tmp.c_str());
+            err = L"Failed to replace manifest file.";
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,47 @@
+// BlockManifest.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Incremental
+{
+    // Input bytes per hashed block. A multiple of 16 so every block starts on an output line for
+    // every element width.
+    constexpr uint32_t BLOCK_SIZE = 64u * 1024u;
+
+    // Sidecar written next to a large-mode output; describes the input and the exact output file
+    // it produced so the next run can rewrite only the lines of changed blocks.
+    struct BlockManifest
+    {
+        uint32_t blockSize = BLOCK_SIZE;
+        uint64_t inputSize = 0u;
+        uint64_t formatHash = 0u;
+        uint64_t outputSize = 0u;
+        uint64_t outputWriteTime = 0u;
+        std::vector<uint64_t> blockHashes;
+    };
+
+    std::wstring ManifestPath(const std::wstring& outPath);
+    uint64_t HashFormat(const Converter::Format& fmt);
+
+    // visit, when set, sees every block right after it is hashed, so other per-byte work can
+    // share the pass while the block is still in cache.
+    using BlockVisitor = std::function<void(const uint8_t* data, size_t size)>;
+    void HashBlocks(const uint8_t* data, size_t size, BlockManifest& m, const BlockVisitor& visit = nullptr);
+
+    // True when prev describes an output that can be patched into next: same block size, input
+    // size and format, and the output file is still exactly what prev recorded.
+    bool CanPatch(const BlockManifest& prev, const BlockManifest& next, const std::wstring& outPath);
+
+    // Fills outputSize/outputWriteTime from the file on disk.
+    bool RecordOutput(const std::wstring& outPath, BlockManifest& m);
+
+    bool LoadManifest(const std::wstring& path, BlockManifest& m);
+    bool SaveManifest(const std::wstring& path, const BlockManifest& m, std::wstring& err);
+}
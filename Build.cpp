@@ -0,0 +1,338 @@
+// Build.cpp
+#include "Build.h"
+#include "BlockManifest.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+#include "JobStats.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace EmbedPack::Build
+{
+    namespace
+    {
+        constexpr char STAMP_HEADER[] = "# EmbedPack build stamp; one '<signature> <output>' line per entry.\r\n";
+
+        // Poll interval while waiting for room in a worker pool shared with other callers.
+        constexpr DWORD QUEUE_RETRY_MS = 5u;
+
+        using StampMap = std::unordered_map<std::string, std::string>;
+
+        struct Pending
+        {
+            Converter::Job job;
+            Converter::ConversionHandle handle;
+        };
+
+        static std::string Utf8(const std::wstring& s)
+        {
+            if (s.empty())
+                return {};
+
+            const int wlen = static_cast<int>(s.size());
+            const int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, nullptr, 0, nullptr, nullptr);
+            if (len <= 0)
+                return {};
+
+            std::string out(static_cast<size_t>(len), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, &out[0], len, nullptr, nullptr);
+            return out;
+        }
+
+        static std::wstring FullPath(const std::wstring& path)
+        {
+            wchar_t buf[MAX_PATH]{};
+            const DWORD n = GetFullPathNameW(path.c_str(), MAX_PATH, buf, nullptr);
+            if (n == 0u || n >= MAX_PATH)
+                return path;
+            return std::wstring(buf, n);
+        }
+
+        static std::wstring PathKey(const std::wstring& path)
+        {
+            std::wstring key = FullPath(path);
+            std::transform(key.begin(), key.end(), key.begin(), [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(static_cast<wint_t>(ch))); });
+            return key;
+        }
+
+        static bool GetWriteTime(const std::wstring& path, FILETIME& ft)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA fad{};
+            if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad))
+                return false;
+            ft = fad.ftLastWriteTime;
+            return true;
+        }
+
+        // Everything besides the input bytes that decides the output text. Incremental and
+        // mapped writes produce the same text, so they are not part of it.
+        static std::string Signature(const Entry& e)
+        {
+            std::string key = Utf8(e.inPath);
+            const uint64_t formatHash = Incremental::HashFormat(e.format);
+            key.append(reinterpret_cast<const char*>(&formatHash), sizeof(formatHash));
+            // Only when set, so stamps written before transforms existed still match.
+            if (!e.transforms.empty())
+                key.append("|transform=" + Transform::Describe(e.transforms));
+
+            const uint64_t h = Hashing::Xxh64(key.data(), key.size());
+            return Hashing::ToHex(reinterpret_cast<const uint8_t*>(&h), sizeof(h));
+        }
+
+        // A missing or unreadable stamp leaves the map empty, which makes every entry stale.
+        static void ReadStamp(const std::wstring& path, StampMap& out)
+        {
+            FileIo::MappedInput input;
+            std::wstring err;
+            if (!FileIo::MapInputFile(path, input, err))
+                return;
+
+            const char* text = reinterpret_cast<const char*>(input.data());
+            size_t pos = 0u;
+            while (pos < input.size)
+            {
+                size_t eol = pos;
+                while (eol < input.size && text[eol] != '\n')
+                    ++eol;
+                std::string line(text + pos, eol - pos);
+                pos = eol + 1u;
+
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                const size_t space = line.find(' ');
+                if (space != std::string::npos)
+                    out[line.substr(space + 1u)] = line.substr(0u, space);
+            }
+        }
+
+        // Make and Ninja both take "\ " and "\#" for a literal space and '#', and "$$" for '$'.
+        // Other backslashes, as in Windows paths, stay literal.
+        static void AppendDepPath(std::string& out, const std::wstring& path)
+        {
+            for (const char ch : Utf8(path))
+            {
+                if (ch == ' ' || ch == '#')
+                    out.push_back('\\');
+                else if (ch == '$')
+                    out.push_back('$');
+                out.push_back(ch);
+            }
+        }
+
+        static bool WriteTextFile(const std::wstring& path, const std::string& data, std::wstring& err)
+        {
+            const std::wstring tmp = path + L".tmp";
+            {
+                FileIo::Handle h(CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+                if (!h.valid())
+                {
+                    err = L"Failed to create " + path;
+                    return false;
+                }
+                if (!FileIo::WriteAll(h, data.data(), static_cast<DWORD>(data.size()), err))
+                    return false;
+            }
+
+            if (!MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+            {
+                DeleteFileW(tmp.c_str());
+                err = L"Failed to replace " + path;
+                return false;
+            }
+            return true;
+        }
+
+        // The depfile goes first: a stamp without it would look up to date to Ninja while
+        // listing no inputs.
+        static bool WriteStampAndDepfile(
+            const std::vector<Entry>& entries,
+            const std::vector<std::string>& signatures,
+            const Options& opt,
+            std::wstring& err)
+        {
+            std::string dep;
+            AppendDepPath(dep, opt.stampPath);
+            dep.append(":");
+            if (!opt.manifestPath.empty())
+            {
+                dep.append(" \\\n  ");
+                AppendDepPath(dep, opt.manifestPath);
+            }
+
+            std::unordered_set<std::wstring> listed;
+            for (const Entry& e : entries)
+            {
+                if (!listed.insert(e.inPath).second)
+                    continue;
+                dep.append(" \\\n  ");
+                AppendDepPath(dep, e.inPath);
+            }
+            dep.append("\n");
+
+            std::string stamp = STAMP_HEADER;
+            for (size_t i = 0u; i < entries.size(); ++i)
+            {
+                stamp.append(signatures[i]);
+                stamp.push_back(' ');
+                stamp.append(Utf8(entries[i].outPath));
+                stamp.append("\r\n");
+            }
+
+            return WriteTextFile(opt.depfilePath, dep, err) && WriteTextFile(opt.stampPath, stamp, err);
+        }
+    }
+
+    bool Run(const std::vector<Entry>& entries, const Options& opt, const LogFn& log, Summary& summary, std::wstring& err)
+    {
+        summary = Summary{};
+
+        // Two entries writing one header would race on the worker pool.
+        std::unordered_set<std::wstring> outputs;
+        for (const Entry& e : entries)
+        {
+            if (!outputs.insert(PathKey(e.outPath)).second)
+            {
+                err = L"Output listed twice in the manifest: " + e.outPath;
+                return false;
+            }
+        }
+
+        StampMap previous;
+        if (!opt.force)
+            ReadStamp(opt.stampPath, previous);
+
+        std::vector<std::string> signatures(entries.size());
+        std::vector<size_t> stale;
+        for (size_t i = 0u; i < entries.size(); ++i)
+        {
+            const Entry& e = entries[i];
+            signatures[i] = Signature(e);
+
+            FILETIME inTime{}, outTime{};
+            if (!GetWriteTime(e.inPath, inTime))
+            {
+                err = L"Input not found: " + e.inPath;
+                return false;
+            }
+
+            const auto recorded = previous.find(Utf8(e.outPath));
+            const bool upToDate = !opt.force &&
+                recorded != previous.end() && recorded->second == signatures[i] &&
+                GetWriteTime(e.outPath, outTime) && CompareFileTime(&outTime, &inTime) >= 0;
+
+            if (upToDate)
+                ++summary.upToDate;
+            else
+                stale.push_back(i);
+        }
+
+        // Jobs are reaped oldest first; StartConversionAsync refusing a job means the pool queue
+        // is full, so the next submission waits for the oldest one to finish.
+        std::deque<Pending> running;
+        const auto reapOldest = [&]() {
+            Pending& p = running.front();
+            p.handle.Wait();
+            const Converter::ConversionResult r = p.handle.Take();
+
+            std::wstring statsErr;
+            if (opt.writeStats && !Stats::WriteJson(Stats::SidecarPath(p.job.outPath), p.job, r, statsErr))
+                log(L"warning: " + statsErr);
+
+            const size_t outputs = p.job.sinks.size() + 1u;
+            if (r.ok)
+            {
+                summary.converted += outputs;
+                const std::wstring ms = L" (" + std::to_wstring(static_cast<uint64_t>(r.stats.elapsedMs)) + L" ms)";
+                log(L"converted " + p.job.outPath + ms);
+                for (const Converter::Sink& sink : p.job.sinks)
+                    log(L"converted " + sink.outPath + ms);
+            }
+            else
+            {
+                summary.failed += outputs;
+                log(L"failed " + p.job.inPath + L": " + r.message);
+            }
+            running.pop_front();
+        };
+
+        // Stale entries of one input and one transform list share a job that reads it once for all
+        // their outputs. Incremental and mapped entries keep jobs of their own, since fan-out
+        // writes in full.
+        std::vector<Converter::Job> jobs;
+        std::unordered_map<std::wstring, size_t> fanOut;
+        for (const size_t i : stale)
+        {
+            const Entry& e = entries[i];
+            if (!e.incremental && !e.mappedOutput)
+            {
+                const std::string transforms = Transform::Describe(e.transforms);
+                const auto slot = fanOut.emplace(PathKey(e.inPath) + L"|" + std::wstring(transforms.begin(), transforms.end()), jobs.size());
+                if (!slot.second)
+                {
+                    Converter::Sink sink;
+                    sink.format = e.format;
+                    sink.outPath = e.outPath;
+                    jobs[slot.first->second].sinks.push_back(std::move(sink));
+                    continue;
+                }
+            }
+
+            Converter::Job job;
+            job.inPath = e.inPath;
+            job.outPath = e.outPath;
+            job.largeMode = true;
+            job.incremental = e.incremental;
+            job.mappedOutput = e.mappedOutput;
+            job.format = e.format;
+            job.transforms = e.transforms;
+            if (opt.openInput)
+                job.input = opt.openInput(job.inPath);
+            jobs.push_back(std::move(job));
+        }
+
+        for (Converter::Job& job : jobs)
+        {
+            Pending p;
+            p.job = std::move(job);
+
+            p.handle = Converter::StartConversionAsync(p.job);
+            while (!p.handle.Valid() && (!running.empty() || opt.waitForQueue))
+            {
+                if (running.empty())
+                    Sleep(QUEUE_RETRY_MS);
+                else
+                    reapOldest();
+                p.handle = Converter::StartConversionAsync(p.job);
+            }
+
+            if (!p.handle.Valid())
+            {
+                summary.failed += p.job.sinks.size() + 1u;
+                log(L"failed " + p.job.inPath + L": the conversion job could not be queued.");
+                continue;
+            }
+            running.push_back(std::move(p));
+        }
+
+        while (!running.empty())
+            reapOldest();
+
+        if (summary.failed != 0u)
+        {
+            err = std::to_wstring(summary.failed) + L" of " + std::to_wstring(stale.size()) + L" conversion(s) failed.";
+            return false;
+        }
+
+        // Rewritten even when nothing was stale: the build tool re-ran this because the stamp is
+        // older than the manifest or an input, and would keep doing so otherwise.
+        return WriteStampAndDepfile(entries, signatures, opt, err);
+    }
+}
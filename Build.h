@@ -0,0 +1,59 @@
+// Build.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Build
+{
+    // One manifest line: an input, the header generated from it and how.
+    struct Entry
+    {
+        std::wstring inPath;
+        std::wstring outPath;
+        Converter::Format format{};
+        Transform::Spec transforms;
+        bool incremental = false;
+        bool mappedOutput = false;
+    };
+
+    struct Options
+    {
+        // Listed in the depfile so editing the manifest re-runs the build.
+        std::wstring manifestPath;
+        // Records the settings every output was generated with; the target of the depfile.
+        std::wstring stampPath;
+        std::wstring depfilePath;
+        // Convert every entry regardless of timestamps and the stamp.
+        bool force = false;
+        // Write a JSON stats sidecar next to every converted output.
+        bool writeStats = false;
+        // Optional: an already mapped view of an input (the server's cache), used as Job::input.
+        std::function<std::shared_ptr<const FileIo::MappedInput>(const std::wstring& path)> openInput;
+        // The worker pool is shared with other callers: when it is full and none of this build's
+        // jobs are running, wait for room instead of failing the entry.
+        bool waitForQueue = false;
+    };
+
+    struct Summary
+    {
+        size_t converted = 0u;
+        size_t upToDate = 0u;
+        size_t failed = 0u;
+    };
+
+    using LogFn = std::function<void(const std::wstring&)>;
+
+    // An entry is stale when its output is missing or older than its input, or when the stamp
+    // does not record the entry's current input and format for that output. Only stale entries
+    // are converted, in parallel on the worker pool; stale entries that share an input (and are
+    // neither incremental nor mapped) become one fan-out job that reads it once. The check itself
+    // touches file attributes only, so a build with nothing to do returns at once. The stamp and a Make/Ninja depfile
+    // ("<stamp>: <manifest> <inputs>...") are rewritten when every conversion succeeded.
+    bool Run(const std::vector<Entry>& entries, const Options& opt, const LogFn& log, Summary& summary, std::wstring& err);
+}
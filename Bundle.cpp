@@ -0,0 +1,409 @@
+// Bundle.cpp
+#include "Bundle.h"
+#include "FileMapping.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace EmbedPack::Bundle
+{
+    namespace
+    {
+        // Gives up on a bucket after this many displacements; never reached with sane hashes.
+        constexpr uint32_t MAX_DISPLACEMENT = 1u << 24;
+
+        // Must match EmbedPackBundleHash in the generated header bit for bit.
+        static uint32_t Hash(const std::string& s, uint32_t seed)
+        {
+            uint32_t h = 0x811C9DC5u ^ seed;
+            for (const char c : s)
+            {
+                h ^= static_cast<unsigned char>(c);
+                h *= 0x01000193u;
+            }
+            h ^= h >> 16u;
+            h *= 0x7FEB352Du;
+            h ^= h >> 15u;
+            return h;
+        }
+
+        // Hash-and-displace: names are bucketed by Hash(name, 0); the largest buckets pick the
+        // first seed that sends all their names to free slots, single-name buckets take a free
+        // slot directly (stored as -slot - 1). slotOf[i] is the table row of names[i].
+        static bool BuildPerfectHash(
+            const std::vector<Entry>& entries,
+            std::vector<int32_t>& seeds,
+            std::vector<size_t>& slotOf,
+            std::wstring& err)
+        {
+            const size_t n = entries.size();
+            seeds.assign(n, 0);
+            slotOf.assign(n, 0u);
+
+            std::vector<std::vector<size_t>> buckets(n);
+            for (size_t i = 0u; i < n; ++i)
+                buckets[Hash(entries[i].name, 0u) % n].push_back(i);
+
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), size_t{ 0 });
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return buckets[a].size() > buckets[b].size();
+            });
+
+            std::vector<bool> used(n, false);
+            std::vector<size_t> trial;
+            size_t next = 0u;
+
+            for (const size_t b : order)
+            {
+                const std::vector<size_t>& bucket = buckets[b];
+                if (bucket.size() <= 1u)
+                {
+                    if (bucket.empty())
+                        break;
+
+                    while (used[next])
+                        ++next;
+                    used[next] = true;
+                    slotOf[bucket[0]] = next;
+                    seeds[b] = -static_cast<int32_t>(next) - 1;
+                    continue;
+                }
+
+                uint32_t d = 1u;
+                for (; d < MAX_DISPLACEMENT; ++d)
+                {
+                    trial.clear();
+                    bool ok = true;
+                    for (const size_t i : bucket)
+                    {
+                        const size_t slot = Hash(entries[i].name, d) % n;
+                        if (used[slot] || std::find(trial.begin(), trial.end(), slot) != trial.end())
+                        {
+                            ok = false;
+                            break;
+                        }
+                        trial.push_back(slot);
+                    }
+                    if (ok)
+                        break;
+                }
+
+                if (d == MAX_DISPLACEMENT)
+                {
+                    err = L"Failed to build a perfect hash for the bundle names.";
+                    return false;
+                }
+
+                for (size_t k = 0u; k < bucket.size(); ++k)
+                {
+                    used[trial[k]] = true;
+                    slotOf[bucket[k]] = trial[k];
+                }
+                seeds[b] = static_cast<int32_t>(d);
+            }
+            return true;
+        }
+
+        static std::string Utf8(const std::wstring& s)
+        {
+            if (s.empty())
+                return {};
+
+            const int wlen = static_cast<int>(s.size());
+            const int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, nullptr, 0, nullptr, nullptr);
+            if (len <= 0)
+                return {};
+
+            std::string out(static_cast<size_t>(len), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, &out[0], len, nullptr, nullptr);
+            return out;
+        }
+
+        static bool CollectDirectory(const std::wstring& dir, const std::string& prefix, std::vector<Entry>& entries, std::wstring& err)
+        {
+            WIN32_FIND_DATAW fd{};
+            HANDLE find = FindFirstFileExW(
+                (dir + L"\\*").c_str(),
+                FindExInfoBasic,
+                &fd,
+                FindExSearchNameMatch,
+                nullptr,
+                FIND_FIRST_EX_LARGE_FETCH);
+            if (find == INVALID_HANDLE_VALUE)
+            {
+                err = L"Failed to list directory: " + dir;
+                return false;
+            }
+
+            bool ok = true;
+            do
+            {
+                const std::wstring name = fd.cFileName;
+                if (name == L"." || name == L"..")
+                    continue;
+
+                const std::wstring path = dir + L"\\" + name;
+                if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    ok = CollectDirectory(path, prefix + Utf8(name) + "/", entries, err);
+                else
+                    entries.push_back({ prefix + Utf8(name), path });
+            } while (ok && FindNextFileW(find, &fd));
+
+            FindClose(find);
+            return ok;
+        }
+
+        // Octal escapes always end after three digits, unlike \x, so no following character can
+        // extend them.
+        static void AppendStringLiteral(const std::string& s, std::string& out)
+        {
+            out.push_back('"');
+            for (const char c : s)
+            {
+                const auto u = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\')
+                {
+                    out.push_back('\\');
+                    out.push_back(c);
+                }
+                else if (u < 0x20u || u >= 0x7Fu)
+                {
+                    out.push_back('\\');
+                    out.push_back(static_cast<char>('0' + (u >> 6u)));
+                    out.push_back(static_cast<char>('0' + ((u >> 3u) & 7u)));
+                    out.push_back(static_cast<char>('0' + (u & 7u)));
+                }
+                else
+                {
+                    out.push_back(c);
+                }
+            }
+            out.push_back('"');
+        }
+
+        static const char* TypeName(Converter::ElementType t)
+        {
+            switch (t)
+            {
+            case Converter::ElementType::Uint8:   return "uint8_t";
+            case Converter::ElementType::StdByte: return "std::byte";
+            default:                              return "unsigned char";
+            }
+        }
+
+        // Shared by every bundle header in a translation unit.
+        static void AppendBundleTypes(std::string& out)
+        {
+            out.append(
+                "#ifndef EMBEDPACK_BUNDLE_DEFINED\r\n"
+                "#define EMBEDPACK_BUNDLE_DEFINED\r\n"
+                "struct EmbedPackBundleEntry\r\n"
+                "{\r\n"
+                "    std::string_view name;\r\n"
+                "    size_t offset;\r\n"
+                "    size_t size;\r\n"
+                "};\r\n"
+                "\r\n"
+                "constexpr uint32_t EmbedPackBundleHash(std::string_view s, uint32_t seed) noexcept\r\n"
+                "{\r\n"
+                "    uint32_t h = 0x811C9DC5u ^ seed;\r\n"
+                "    for (const char c : s)\r\n"
+                "    {\r\n"
+                "        h ^= static_cast<unsigned char>(c);\r\n"
+                "        h *= 0x01000193u;\r\n"
+                "    }\r\n"
+                "    h ^= h >> 16;\r\n"
+                "    h *= 0x7FEB352Du;\r\n"
+                "    h ^= h >> 15;\r\n"
+                "    return h;\r\n"
+                "}\r\n"
+                "#endif\r\n"
+                "\r\n");
+        }
+
+        static void AppendLookup(const std::string& type, bool constexprData, bool stdArray, std::string& out)
+        {
+            out.append(
+                "// One hash picks the bucket's displacement, a second the row; one compare confirms.\r\n"
+                "static constexpr const EmbedPackBundleEntry* bundleFind(std::string_view name) noexcept\r\n"
+                "{\r\n"
+                "    const int32_t d = bundleSeeds[EmbedPackBundleHash(name, 0u) % bundleCount];\r\n"
+                "    const size_t row = (d < 0) ? static_cast<size_t>(-(d + 1))\r\n"
+                "                               : EmbedPackBundleHash(name, static_cast<uint32_t>(d)) % bundleCount;\r\n"
+                "    return (bundleEntries[row].name == name) ? &bundleEntries[row] : nullptr;\r\n"
+                "}\r\n"
+                "\r\n");
+
+            out.append(constexprData ? "static constexpr const " : "static inline const ");
+            out.append(type);
+            out.append("* bundleBytes(const EmbedPackBundleEntry& e) noexcept\r\n{\r\n    return ");
+            out.append(stdArray ? "bundleData.data()" : "bundleData");
+            out.append(" + e.offset;\r\n}\r\n");
+        }
+    }
+
+    bool CollectEntries(const std::vector<std::wstring>& inputs, std::vector<Entry>& entries, std::wstring& err)
+    {
+        entries.clear();
+        for (const std::wstring& in : inputs)
+        {
+            const DWORD attrs = GetFileAttributesW(in.c_str());
+            if (attrs == INVALID_FILE_ATTRIBUTES)
+            {
+                err = L"Input not found: " + in;
+                return false;
+            }
+
+            if (attrs & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                std::wstring dir = in;
+                while (dir.size() > 1u && (dir.back() == L'\\' || dir.back() == L'/'))
+                    dir.pop_back();
+                if (!CollectDirectory(dir, std::string(), entries, err))
+                    return false;
+            }
+            else
+            {
+                const size_t slash = in.find_last_of(L"\\/");
+                entries.push_back({ Utf8(slash == std::wstring::npos ? in : in.substr(slash + 1u)), in });
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+        for (size_t i = 1u; i < entries.size(); ++i)
+        {
+            if (entries[i].name == entries[i - 1u].name)
+            {
+                err = L"Duplicate bundle name: " + entries[i].path;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool WriteBundle(const std::vector<Entry>& entries, const std::wstring& outPath, const Options& opt, std::wstring& err)
+    {
+        const Converter::Format& fmt = opt.format;
+        if (fmt.elementType != Converter::ElementType::UnsignedChar && fmt.elementType != Converter::ElementType::Uint8 &&
+            fmt.elementType != Converter::ElementType::StdByte)
+        {
+            err = L"Bundles need a byte element type (uchar, uint8 or byte).";
+            return false;
+        }
+
+        const uint32_t align = opt.entryAlign;
+        if (align == 0u || (align & (align - 1u)) != 0u || align > Converter::PAGE_SIZE)
+        {
+            err = L"Invalid entry alignment (expected a power of two up to 4096).";
+            return false;
+        }
+
+        if (entries.empty())
+        {
+            err = L"A bundle needs at least one input file.";
+            return false;
+        }
+
+        // Concatenate with zero gaps so every entry starts aligned.
+        std::vector<size_t> offsets(entries.size());
+        std::vector<size_t> sizes(entries.size());
+        std::vector<uint8_t> blob;
+        for (size_t i = 0u; i < entries.size(); ++i)
+        {
+            FileIo::MappedInput input;
+            if (!FileIo::MapInputFile(entries[i].path, input, err))
+                return false;
+
+            offsets[i] = (blob.size() + align - 1u) & ~static_cast<size_t>(align - 1u);
+            sizes[i] = input.size;
+            blob.resize(offsets[i] + input.size, 0u);
+            if (input.size != 0u)
+                std::memcpy(blob.data() + offsets[i], input.data(), input.size);
+        }
+
+        if (blob.empty())
+        {
+            err = L"Every bundle input is empty.";
+            return false;
+        }
+
+        std::vector<int32_t> seeds;
+        std::vector<size_t> slotOf;
+        if (!BuildPerfectHash(entries, seeds, slotOf, err))
+            return false;
+
+        // The array itself is aligned at least as strictly as its entries.
+        Converter::Format dataFmt = fmt;
+        dataFmt.alignment = std::max(fmt.alignment, align);
+        dataFmt.tailPadding = Converter::TailPadding::None;
+
+        const bool stdArray = fmt.arrayStyle == Converter::ArrayStyle::ConstexprStdArray ||
+                              fmt.arrayStyle == Converter::ArrayStyle::StaticConstexprStdArray;
+        const bool constexprData = stdArray || fmt.arrayStyle == Converter::ArrayStyle::ConstexprArray;
+
+        std::string out;
+        out.append("#include <cstddef>\r\n#include <cstdint>\r\n#include <string_view>\r\n");
+        if (stdArray)
+            out.append("#include <array>\r\n");
+        out.append("\r\n");
+        out.append(Converter::FormatPreamble(fmt));
+        AppendBundleTypes(out);
+
+        if (!Converter::FormatArray("bundleData", blob.data(), blob.size(), dataFmt, out, err))
+            return false;
+
+        out.append("constexpr size_t bundleDataSize = ");
+        out.append(std::to_string(blob.size()));
+        out.append(";\r\nconstexpr size_t bundleCount = ");
+        out.append(std::to_string(entries.size()));
+        out.append(";\r\n\r\n");
+
+        std::vector<size_t> rowEntry(entries.size());
+        for (size_t i = 0u; i < entries.size(); ++i)
+            rowEntry[slotOf[i]] = i;
+
+        out.append("// Rows are in perfect-hash order; offsets and sizes are in bytes.\r\n");
+        out.append("constexpr EmbedPackBundleEntry bundleEntries[] = {");
+        for (const size_t i : rowEntry)
+        {
+            out.append("\r\n    { ");
+            AppendStringLiteral(entries[i].name, out);
+            out.append(", ");
+            out.append(std::to_string(offsets[i]));
+            out.append(", ");
+            out.append(std::to_string(sizes[i]));
+            out.append(" },");
+        }
+        out.append("\r\n};\r\n\r\nconstexpr int32_t bundleSeeds[] = {");
+        for (size_t i = 0u; i < seeds.size(); ++i)
+        {
+            out.append((i % 16u) == 0u ? "\r\n    " : " ");
+            out.append(std::to_string(seeds[i]));
+            out.push_back(',');
+        }
+        out.append("\r\n};\r\n\r\n");
+
+        AppendLookup(TypeName(fmt.elementType), constexprData, stdArray, out);
+
+        FileIo::Handle h(CreateFileW(outPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!h.valid())
+        {
+            err = L"Failed to create output file.";
+            return false;
+        }
+
+        const char* p = out.data();
+        size_t remaining = out.size();
+        while (remaining > 0u)
+        {
+            const DWORD piece = static_cast<DWORD>(std::min<size_t>(remaining, 1u << 30));
+            if (!FileIo::WriteAll(h, p, piece, err))
+                return false;
+            p += piece;
+            remaining -= piece;
+        }
+        return true;
+    }
+}
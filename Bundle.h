@@ -0,0 +1,34 @@
+// Bundle.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Bundle
+{
+    struct Entry
+    {
+        std::string name; // UTF-8 lookup key, '/' separated
+        std::wstring path;
+    };
+
+    struct Options
+    {
+        // Only the byte element types are accepted; style, alignment and section apply to the
+        // single data array.
+        Converter::Format format{};
+        // Every entry starts at a multiple of this within the data array (a power of two).
+        uint32_t entryAlign = 16u;
+    };
+
+    // Files are keyed by their file name; directories are walked recursively and their files are
+    // keyed by the path relative to the directory. Sorted by name, duplicates rejected.
+    bool CollectEntries(const std::vector<std::wstring>& inputs, std::vector<Entry>& entries, std::wstring& err);
+
+    // One header: the concatenated data array, an offset/size table ordered by a minimal perfect
+    // hash computed here, and a constexpr bundleFind(std::string_view) lookup.
+    bool WriteBundle(const std::vector<Entry>& entries, const std::wstring& outPath, const Options& opt, std::wstring& err);
+}
@@ -0,0 +1,1140 @@
+// CommandLine.cpp
+#include "CommandLine.h"
+#include "Build.h"
+#include "Bundle.h"
+#include "CoreServices.h"
+#include "Decoder.h"
+#include "Delta.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+#include "JobStats.h"
+#include "Server.h"
+#include "Tracing.h"
+#include "Tuning.h"
+#include "Watcher.h"
+
+#include <shellapi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EmbedPack::CommandLine
+{
+    namespace
+    {
+        // GUI-subsystem process: output only shows up when started from a console, and still
+        // has to reach redirected pipes as UTF-8.
+        class Console final
+        {
+        public:
+            Console() { AttachConsole(ATTACH_PARENT_PROCESS); }
+            // Output of a command the server runs for a client, sent back over its connection.
+            Console(const Server::TextFn& out, const Server::TextFn& err) : m_out(out), m_err(err) {}
+
+            void Out(const std::wstring& text) const
+            {
+                if (m_out)
+                    m_out(text);
+                else
+                    Write(STD_OUTPUT_HANDLE, text);
+            }
+
+            void Err(const std::wstring& text) const
+            {
+                if (m_err)
+                    m_err(text);
+                else
+                    Write(STD_ERROR_HANDLE, text);
+            }
+
+        private:
+            static void Write(DWORD which, const std::wstring& text)
+            {
+                const HANDLE h = GetStdHandle(which);
+                if (h == nullptr || h == INVALID_HANDLE_VALUE || text.empty())
+                    return;
+
+                DWORD mode = 0;
+                DWORD written = 0;
+                if (GetConsoleMode(h, &mode))
+                {
+                    WriteConsoleW(h, text.c_str(), static_cast<DWORD>(text.size()), &written, nullptr);
+                    return;
+                }
+
+                const int wlen = static_cast<int>(text.size());
+                const int len = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), wlen, nullptr, 0, nullptr, nullptr);
+                if (len <= 0)
+                    return;
+
+                std::string utf8(static_cast<size_t>(len), '\0');
+                WideCharToMultiByte(CP_UTF8, 0, text.c_str(), wlen, &utf8[0], len, nullptr, nullptr);
+                WriteFile(h, utf8.data(), static_cast<DWORD>(utf8.size()), &written, nullptr);
+            }
+
+            Server::TextFn m_out;
+            Server::TextFn m_err;
+        };
+
+        // Set when a command runs in the server for a client: relative paths resolve against the
+        // client's directory, inputs come through the server's cache, and the worker pool, which
+        // other clients share, stays up afterwards.
+        struct Remote
+        {
+            std::wstring baseDir;
+            Server::Cache* cache = nullptr;
+        };
+
+        // Poll interval while waiting for room in the worker pool the server's clients share.
+        constexpr DWORD QUEUE_RETRY_MS = 5u;
+
+        struct Args
+        {
+            std::vector<std::wstring> positional;
+            std::vector<std::pair<std::wstring, std::wstring>> options;
+
+            bool Has(const std::wstring& name) const
+            {
+                return std::any_of(options.begin(), options.end(), [&](const auto& o) { return o.first == name; });
+            }
+
+            const std::wstring* Get(const std::wstring& name) const
+            {
+                for (const auto& o : options)
+                    if (o.first == name)
+                        return &o.second;
+                return nullptr;
+            }
+        };
+
+        // Options take a value ("--name value" or "--name=value") unless listed in flags.
+        static bool ParseArgs(
+            const std::vector<std::wstring>& argv,
+            size_t first,
+            std::initializer_list<const wchar_t*> flags,
+            Args& out,
+            std::wstring& err)
+        {
+            for (size_t i = first; i < argv.size(); ++i)
+            {
+                const std::wstring& a = argv[i];
+                if (a.size() < 3u || a.compare(0, 2, L"--") != 0)
+                {
+                    out.positional.push_back(a);
+                    continue;
+                }
+
+                const size_t eq = a.find(L'=');
+                if (eq != std::wstring::npos)
+                {
+                    out.options.emplace_back(a.substr(2, eq - 2u), a.substr(eq + 1u));
+                    continue;
+                }
+
+                const std::wstring name = a.substr(2);
+                const bool isFlag = std::any_of(flags.begin(), flags.end(),
+                    [&](const wchar_t* f) { return name == f; });
+
+                if (isFlag)
+                {
+                    out.options.emplace_back(name, L"");
+                    continue;
+                }
+
+                if (i + 1u >= argv.size())
+                {
+                    err = L"Missing value for --" + name + L".";
+                    return false;
+                }
+                out.options.emplace_back(name, argv[++i]);
+            }
+            return true;
+        }
+
+        static bool ParseByteOrder(const Args& args, Converter::ByteOrder& order, std::wstring& err)
+        {
+            order = Converter::ByteOrder::LittleEndian;
+
+            const std::wstring* v = args.Get(L"byte-order");
+            if (v == nullptr || *v == L"little")
+                return true;
+            if (*v == L"big")
+            {
+                order = Converter::ByteOrder::BigEndian;
+                return true;
+            }
+
+            err = L"Unknown byte order '" + *v + L"' (expected little or big).";
+            return false;
+        }
+
+        template <typename E>
+        struct NamedValue
+        {
+            const wchar_t* name;
+            E value;
+        };
+
+        static constexpr NamedValue<Converter::ElementType> kTypes[] = {
+            { L"uchar",  Converter::ElementType::UnsignedChar },
+            { L"uint8",  Converter::ElementType::Uint8 },
+            { L"byte",   Converter::ElementType::StdByte },
+            { L"ushort", Converter::ElementType::UnsignedShort },
+            { L"uint16", Converter::ElementType::Uint16 },
+            { L"uint32", Converter::ElementType::Uint32 },
+            { L"uint64", Converter::ElementType::Uint64 },
+        };
+
+        static constexpr NamedValue<Converter::ArrayStyle> kStyles[] = {
+            { L"const",                  Converter::ArrayStyle::ConstArray },
+            { L"static-const",           Converter::ArrayStyle::StaticConstArray },
+            { L"constexpr",              Converter::ArrayStyle::ConstexprArray },
+            { L"constexpr-array",        Converter::ArrayStyle::ConstexprStdArray },
+            { L"static-constexpr-array", Converter::ArrayStyle::StaticConstexprStdArray },
+        };
+
+        static constexpr NamedValue<Converter::TailPadding> kPaddings[] = {
+            { L"none",       Converter::TailPadding::None },
+            { L"cache-line", Converter::TailPadding::CacheLine },
+            { L"page",       Converter::TailPadding::Page },
+        };
+
+        static constexpr NamedValue<Converter::Checksum> kChecksums[] = {
+            { L"none",   Converter::Checksum::None },
+            { L"crc32c", Converter::Checksum::Crc32c },
+            { L"xxh64",  Converter::Checksum::Xxh64 },
+            { L"both",   Converter::Checksum::Both },
+        };
+
+        static constexpr NamedValue<Converter::ZeroElision> kZeroElisions[] = {
+            { L"keep",   Converter::ZeroElision::None },
+            { L"trim",   Converter::ZeroElision::Trailing },
+            { L"sparse", Converter::ZeroElision::Sparse },
+        };
+
+        static constexpr NamedValue<Converter::TextLiteral> kTextLiterals[] = {
+            { L"never", Converter::TextLiteral::Never },
+            { L"auto",  Converter::TextLiteral::Auto },
+        };
+
+        template <typename E, size_t N>
+        static bool LookupOption(
+            const Args& args,
+            const wchar_t* option,
+            const NamedValue<E> (&table)[N],
+            E& value,
+            std::wstring& err)
+        {
+            const std::wstring* v = args.Get(option);
+            if (v == nullptr)
+                return true;
+
+            for (const auto& entry : table)
+            {
+                if (*v == entry.name)
+                {
+                    value = entry.value;
+                    return true;
+                }
+            }
+
+            err = L"Unknown value '" + *v + L"' for --" + option + L".";
+            return false;
+        }
+
+        static bool ParseUnsignedOption(const Args& args, const wchar_t* option, uint32_t& value, std::wstring& err)
+        {
+            const std::wstring* v = args.Get(option);
+            if (v == nullptr)
+                return true;
+
+            wchar_t* end = nullptr;
+            const unsigned long n = std::wcstoul(v->c_str(), &end, 10);
+            if (v->empty() || end == nullptr || *end != L'\0' || n > 0xFFFFFFFFul)
+            {
+                err = L"Invalid number '" + *v + L"' for --" + option + L".";
+                return false;
+            }
+
+            value = static_cast<uint32_t>(n);
+            return true;
+        }
+
+        static bool ParseFormat(const Args& args, Converter::Format& fmt, std::wstring& err)
+        {
+            if (!LookupOption(args, L"type", kTypes, fmt.elementType, err) ||
+                !LookupOption(args, L"style", kStyles, fmt.arrayStyle, err) ||
+                !LookupOption(args, L"pad", kPaddings, fmt.tailPadding, err) ||
+                !LookupOption(args, L"checksum", kChecksums, fmt.checksum, err) ||
+                !LookupOption(args, L"zeros", kZeroElisions, fmt.zeroElision, err) ||
+                !LookupOption(args, L"text", kTextLiterals, fmt.textLiteral, err) ||
+                !ParseByteOrder(args, fmt.byteOrder, err) ||
+                !ParseUnsignedOption(args, L"align", fmt.alignment, err))
+                return false;
+
+            // Only the narrowing is checked here; a wide character must not pass on its low byte.
+            // Length and character set are left to the converter, which the GUI goes through too.
+            if (const std::wstring* section = args.Get(L"section"))
+            {
+                fmt.sectionName.clear();
+                for (const wchar_t ch : *section)
+                {
+                    if (ch > 0x7F)
+                    {
+                        err = L"Invalid section name.";
+                        return false;
+                    }
+                    fmt.sectionName.push_back(static_cast<char>(ch));
+                }
+            }
+
+            return true;
+        }
+
+        // Every --transform adds its comma-separated stages after those of the previous one.
+        static bool ParseTransforms(const Args& args, Transform::Spec& spec, std::wstring& err)
+        {
+            for (const auto& o : args.options)
+            {
+                if (o.first == L"transform" && !Transform::ParseSpec(o.second, spec, err))
+                    return false;
+            }
+            return true;
+        }
+
+        static std::wstring DefaultOutputPath(const std::wstring& inPath, const std::wstring& outDir)
+        {
+            const size_t slash = inPath.find_last_of(L"\\/");
+            const size_t start = (slash == std::wstring::npos) ? 0u : (slash + 1u);
+
+            size_t dot = inPath.find_last_of(L'.');
+            if (dot == std::wstring::npos || dot < start)
+                dot = inPath.size();
+
+            std::wstring dir = outDir.empty() ? inPath.substr(0, start) : outDir;
+            if (!dir.empty() && dir.back() != L'\\' && dir.back() != L'/')
+                dir.push_back(L'\\');
+
+            return dir + inPath.substr(start, dot - start) + L"_bytes.h";
+        }
+
+        static bool WriteBinaryFile(const std::wstring& path, const std::vector<uint8_t>& bytes, std::wstring& err)
+        {
+            FileIo::Handle h(CreateFileW(
+                path.c_str(),
+                GENERIC_WRITE,
+                0,
+                nullptr,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+
+            if (!h.valid())
+            {
+                err = L"Failed to create output file.";
+                return false;
+            }
+
+            const uint8_t* p = bytes.data();
+            size_t remaining = bytes.size();
+            while (remaining > 0u)
+            {
+                const DWORD piece = static_cast<DWORD>(std::min<size_t>(remaining, 1u << 30));
+                if (!FileIo::WriteAll(h, p, piece, err))
+                    return false;
+                p += piece;
+                remaining -= piece;
+            }
+            return true;
+        }
+
+        // Manifest paths are relative to the manifest's own directory, not the working directory.
+        static std::wstring ResolvePath(const std::wstring& baseDir, const std::wstring& path)
+        {
+            const bool absolute = (path.size() >= 2u && path[1] == L':') ||
+                (!path.empty() && (path[0] == L'\\' || path[0] == L'/'));
+            return absolute ? path : baseDir + path;
+        }
+
+        static std::wstring Resolve(const Remote* remote, const std::wstring& path)
+        {
+            return (remote != nullptr) ? ResolvePath(remote->baseDir, path) : path;
+        }
+
+        // Key of a convert request for the server's up-to-date check: the same arguments from the
+        // same directory write the same outputs from the same input bytes.
+        static std::string RequestKey(const Remote& remote, const std::vector<std::wstring>& argv)
+        {
+            std::wstring key = remote.baseDir;
+            for (size_t i = 2u; i < argv.size(); ++i)
+            {
+                key.push_back(L'\0');
+                key += argv[i];
+            }
+            return std::string(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(wchar_t));
+        }
+
+        static std::wstring CurrentDirectory()
+        {
+            wchar_t buf[MAX_PATH];
+            const DWORD n = GetCurrentDirectoryW(MAX_PATH, buf);
+            if (n == 0u || n >= MAX_PATH)
+                return {};
+
+            std::wstring dir(buf, n);
+            if (dir.back() != L'\\' && dir.back() != L'/')
+                dir.push_back(L'\\');
+            return dir;
+        }
+
+        // UTF-8 text, one "<input> <output.h> [--incremental] [--mapped] [--transform <list>] [format options]" entry
+        // per line; blank lines and lines starting with '#' are skipped. Tokens follow command
+        // line quoting, so paths with spaces are written in double quotes.
+        static bool ReadManifest(const std::wstring& path, std::vector<Build::Entry>& entries, std::wstring& err)
+        {
+            FileIo::MappedInput input;
+            if (!FileIo::MapInputFile(path, input, err))
+            {
+                err = L"Cannot read the manifest " + path + L": " + err;
+                return false;
+            }
+
+            const size_t slash = path.find_last_of(L"\\/");
+            const std::wstring baseDir = (slash == std::wstring::npos) ? std::wstring() : path.substr(0u, slash + 1u);
+
+            const char* text = reinterpret_cast<const char*>(input.data());
+            size_t pos = (input.size >= 3u && std::memcmp(text, "\xEF\xBB\xBF", 3u) == 0) ? 3u : 0u;
+            for (size_t lineNo = 1u; pos < input.size; ++lineNo)
+            {
+                size_t eol = pos;
+                while (eol < input.size && text[eol] != '\n')
+                    ++eol;
+                const size_t begin = pos;
+                pos = eol + 1u;
+
+                size_t first = begin;
+                while (first < eol && (text[first] == ' ' || text[first] == '\t' || text[first] == '\r'))
+                    ++first;
+                if (first == eol || text[first] == '#')
+                    continue;
+                while (text[eol - 1u] == ' ' || text[eol - 1u] == '\t' || text[eol - 1u] == '\r')
+                    --eol;
+
+                const int len = static_cast<int>(eol - first);
+                std::wstring line(static_cast<size_t>(MultiByteToWideChar(CP_UTF8, 0, text + first, len, nullptr, 0)), L'\0');
+                if (!line.empty())
+                    MultiByteToWideChar(CP_UTF8, 0, text + first, len, &line[0], static_cast<int>(line.size()));
+
+                // CommandLineToArgvW parses the first token as a program name, with simpler rules.
+                int argc = 0;
+                LPWSTR* raw = CommandLineToArgvW((L"EmbedPack " + line).c_str(), &argc);
+                if (raw == nullptr)
+                {
+                    err = L"Out of memory.";
+                    return false;
+                }
+                const std::vector<std::wstring> tokens(raw, raw + argc);
+                LocalFree(raw);
+
+                const std::wstring where = path + L"(" + std::to_wstring(lineNo) + L"): ";
+                Args args;
+                if (!ParseArgs(tokens, 1u, { L"incremental", L"mapped" }, args, err))
+                {
+                    err = where + err;
+                    return false;
+                }
+                if (args.positional.size() != 2u)
+                {
+                    err = where + L"expected an input path and an output path.";
+                    return false;
+                }
+
+                Build::Entry e;
+                e.inPath = ResolvePath(baseDir, args.positional[0]);
+                e.outPath = ResolvePath(baseDir, args.positional[1]);
+                e.incremental = args.Has(L"incremental");
+                e.mappedOutput = args.Has(L"mapped");
+                if (!ParseFormat(args, e.format, err) || !ParseTransforms(args, e.transforms, err))
+                {
+                    err = where + err;
+                    return false;
+                }
+                entries.push_back(std::move(e));
+            }
+            return true;
+        }
+
+        static const wchar_t USAGE[] =
+            L"Usage:\r\n"
+            L"  EmbedPack                                   start the GUI\r\n"
+            L"  EmbedPack convert <input> <output.h> [--incremental] [--mapped] [--transform <list>] [--stats] [--trace <file.json>] [format options]\r\n"
+            L"                    [--also <output.h> [format options]]...\r\n"
+            L"  EmbedPack watch <input>... [--out-dir <dir>] [--debounce <ms>] [--incremental] [--mapped] [--transform <list>] [--stats] [--trace <file.json>] [format options]\r\n"
+            L"  EmbedPack build <manifest> [--stamp <file>] [--depfile <file.d>] [--force] [--stats] [--trace <file.json>]\r\n"
+            L"  EmbedPack serve [--socket <path>] [--connections <n>] [--cache <n>] [--keep-mapped <ms>]\r\n"
+            L"  EmbedPack status|stop [--server <socket>]\r\n"
+            L"  EmbedPack bundle <output.h> <input>... [--entry-align <n>] [format options]\r\n"
+            L"  EmbedPack delta <base> <variant> <output.h> [--block <n>] [format options]\r\n"
+            L"  EmbedPack calibrate [--scratch <dir>] [--dry-run]\r\n"
+            L"  EmbedPack decode <header> <out.bin> [--byte-order little|big]\r\n"
+            L"  EmbedPack verify <header> (--file <path> | --sha256 <hex>) [--byte-order little|big]\r\n"
+            L"  EmbedPack help\r\n"
+            L"\r\n"
+            L"Format options:\r\n"
+            L"  --type uchar|uint8|byte|ushort|uint16|uint32|uint64\r\n"
+            L"  --style const|static-const|constexpr|constexpr-array|static-constexpr-array\r\n"
+            L"  --byte-order little|big   --align <n>   --section <name>   --pad none|cache-line|page\r\n"
+            L"  --checksum none|crc32c|xxh64|both   --zeros keep|trim|sparse   --text never|auto\r\n"
+            L"\r\n"
+            L"--text auto writes UTF-8 text inputs up to 64 KiB as a raw string literal (byte types, plain arrays).\r\n"
+            L"--also adds an output with its own format options, written from the same read of the input.\r\n"
+            L"--transform lf|crlf|strip-trailing|strip-comments|minify-json|minify-glsl|nul[,...] rewrites the input\r\n"
+            L"  before formatting, streaming it through the stages in order; repeat it or list several.\r\n"
+            L"--mapped sizes the output up front and formats into a mapping on several threads.\r\n"
+            L"--stats writes <output>.stats.json with phase timings, throughput and memory use.\r\n"
+            L"--trace writes a Chrome trace-event timeline (chrome://tracing, Perfetto) on exit.\r\n"
+            L"delta writes the ops that rebuild <variant> from <base> and a deltaApply() routine; embed the\r\n"
+            L"  base with convert. --block sets the shortest match found by hashing (default 32).\r\n"
+            L"calibrate benchmarks this machine and saves the tuning profile later runs load.\r\n"
+            L"build converts the manifest entries whose outputs are out of date, in parallel, and writes\r\n"
+            L"  a stamp (default <manifest>.stamp) and a Make/Ninja depfile (default <stamp>.d).\r\n"
+            L"serve keeps a converter running on a local socket (default %EMBEDPACK_SERVER%, else under\r\n"
+            L"  %LOCALAPPDATA%\\EmbedPack). convert and build run in it when --server <socket> is given or\r\n"
+            L"  EMBEDPACK_SERVER is set, and in this process when no server answers.\r\n"
+            L"bundle packs files (directories recursively) into one array with a bundleFind(name) lookup.\r\n"
+            L"\r\n"
+            L"Exit codes: 0 success, 1 failure or mismatch, 2 usage error.\r\n";
+
+        static int UsageError(const Console& con, const std::wstring& message)
+        {
+            con.Err(L"error: " + message + L"\r\n\r\n");
+            con.Err(USAGE);
+            return EXIT_USAGE;
+        }
+
+        // Enables recording when --trace was given; the timeline is written by FinishTrace.
+        static void StartTrace(const Args& args)
+        {
+            if (args.Get(L"trace"))
+                Trace::Enable(true);
+        }
+
+        // Called after the workers have shut down so every span is closed.
+        static void FinishTrace(const Console& con, const Args& args)
+        {
+            const std::wstring* path = args.Get(L"trace");
+            std::wstring err;
+            if (path && !Trace::WriteJson(*path, err))
+                con.Err(L"warning: " + err + L"\r\n");
+        }
+
+        static HANDLE g_stopEvent = nullptr;
+
+        static BOOL WINAPI OnConsoleCtrl(DWORD)
+        {
+            if (g_stopEvent == nullptr)
+                return FALSE;
+
+            SetEvent(g_stopEvent);
+            return TRUE;
+        }
+
+        static int RunConvert(const Console& con, const std::vector<std::wstring>& argv, const Remote* remote = nullptr)
+        {
+            // Each "--also <output.h> [format options]" adds an output written from the same pass
+            // over the input; the options after it, up to the next --also, apply to it alone.
+            std::vector<std::vector<std::wstring>> groups(1u);
+            for (size_t i = 2u; i < argv.size(); ++i)
+            {
+                if (argv[i] == L"--also")
+                    groups.emplace_back();
+                else
+                    groups.back().push_back(argv[i]);
+            }
+
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(groups[0], 0u, { L"incremental", L"mapped", L"stats" }, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() != 2u)
+                return UsageError(con, L"convert expects an input path and an output path.");
+
+            Converter::Job job;
+            job.inPath = Resolve(remote, args.positional[0]);
+            job.outPath = Resolve(remote, args.positional[1]);
+            job.largeMode = true;
+            job.incremental = args.Has(L"incremental");
+            job.mappedOutput = args.Has(L"mapped");
+            if (!ParseFormat(args, job.format, err) || !ParseTransforms(args, job.transforms, err))
+                return UsageError(con, err);
+
+            for (size_t g = 1u; g < groups.size(); ++g)
+            {
+                Args sinkArgs;
+                if (!ParseArgs(groups[g], 0u, {}, sinkArgs, err))
+                    return UsageError(con, err);
+                if (sinkArgs.positional.size() != 1u)
+                    return UsageError(con, L"--also expects one output path.");
+                if (sinkArgs.Has(L"transform"))
+                    return UsageError(con, L"--transform applies to every output; give it before the first --also.");
+
+                Converter::Sink sink;
+                sink.outPath = Resolve(remote, sinkArgs.positional[0]);
+                if (!ParseFormat(sinkArgs, sink.format, err))
+                    return UsageError(con, err);
+                job.sinks.push_back(std::move(sink));
+            }
+            if (!job.sinks.empty() && (job.incremental || job.mappedOutput))
+                return UsageError(con, L"--incremental and --mapped apply to single-output conversions only.");
+
+            // In the server, a request repeated with unchanged input bytes and untouched outputs
+            // is answered from the cache. A --stats run always converts, to write fresh numbers.
+            std::string request;
+            Server::Cache::Input input;
+            if (remote != nullptr)
+            {
+                request = RequestKey(*remote, argv);
+                const bool reuse = !args.Has(L"stats");
+
+                Server::FileVersion version;
+                uint64_t hash = 0u;
+                if (reuse && Server::QueryVersion(job.inPath, version) && remote->cache->FindHash(job.inPath, version, hash) &&
+                    remote->cache->UpToDate(request, hash))
+                {
+                    con.Out(L"OK: up to date: " + job.outPath + L"\r\n");
+                    return EXIT_OK;
+                }
+
+                // A file that cannot be mapped is left to the job, which reports it as usual.
+                if (remote->cache->Acquire(job.inPath, true, input, err))
+                {
+                    if (reuse && remote->cache->UpToDate(request, input.hash))
+                    {
+                        con.Out(L"OK: up to date: " + job.outPath + L"\r\n");
+                        return EXIT_OK;
+                    }
+                    job.input = input.view;
+                }
+            }
+            else
+            {
+                StartTrace(args);
+            }
+
+            Converter::ConversionHandle h = Converter::StartConversionAsync(job);
+            while (!h.Valid() && remote != nullptr)
+            {
+                Sleep(QUEUE_RETRY_MS);
+                h = Converter::StartConversionAsync(job);
+            }
+            if (!h.Valid())
+            {
+                con.Err(L"ERROR: Failed to queue the conversion job.\r\n");
+                return EXIT_FAILED;
+            }
+
+            h.Wait();
+            const Converter::ConversionResult r = h.Take();
+            if (remote == nullptr)
+            {
+                Converter::ShutdownWorkers(Threading::ShutdownMode::Drain);
+                FinishTrace(con, args);
+            }
+
+            if (args.Has(L"stats") && !Stats::WriteJson(Stats::SidecarPath(job.outPath), job, r, err))
+                con.Err(L"warning: " + err + L"\r\n");
+
+            if (!r.ok)
+            {
+                con.Err(r.message + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            if (remote != nullptr && job.input)
+            {
+                std::vector<std::wstring> outputs{ job.outPath };
+                for (const Converter::Sink& sink : job.sinks)
+                    outputs.push_back(sink.outPath);
+                remote->cache->Record(request, input.hash, outputs);
+            }
+
+            con.Out(r.message + L"\r\n");
+            return EXIT_OK;
+        }
+
+        static int RunWatch(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, { L"incremental", L"mapped", L"stats" }, args, err))
+                return UsageError(con, err);
+            if (args.positional.empty())
+                return UsageError(con, L"watch expects at least one input path.");
+
+            Watch::WatchOptions opt;
+            opt.incremental = args.Has(L"incremental");
+            opt.mappedOutput = args.Has(L"mapped");
+            opt.writeStats = args.Has(L"stats");
+            if (!ParseFormat(args, opt.format, err) || !ParseTransforms(args, opt.transforms, err) ||
+                !ParseUnsignedOption(args, L"debounce", opt.debounceMs, err))
+                return UsageError(con, err);
+
+            const std::wstring* outDir = args.Get(L"out-dir");
+
+            std::vector<Watch::WatchItem> items;
+            for (const std::wstring& in : args.positional)
+                items.push_back({ in, DefaultOutputPath(in, outDir ? *outDir : std::wstring()) });
+
+            FileIo::Handle stop(CreateEventW(nullptr, TRUE, FALSE, nullptr));
+            if (!stop.valid())
+            {
+                con.Err(L"ERROR: Failed to create the stop event.\r\n");
+                return EXIT_FAILED;
+            }
+
+            g_stopEvent = stop;
+            SetConsoleCtrlHandler(&OnConsoleCtrl, TRUE);
+            StartTrace(args);
+
+            con.Out(L"Watching " + std::to_wstring(items.size()) + L" file(s); press Ctrl+C to stop.\r\n");
+
+            const bool ok = Watch::RunWatch(items, opt, stop, [&](const std::wstring& line) { con.Out(line + L"\r\n"); }, err);
+
+            SetConsoleCtrlHandler(&OnConsoleCtrl, FALSE);
+            g_stopEvent = nullptr;
+            Converter::ShutdownWorkers(Threading::ShutdownMode::Cancel);
+            FinishTrace(con, args);
+
+            if (!ok)
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+            return EXIT_OK;
+        }
+
+        static int RunBuild(const Console& con, const std::vector<std::wstring>& argv, const Remote* remote = nullptr)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, { L"force", L"stats" }, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() != 1u)
+                return UsageError(con, L"build expects exactly one manifest path.");
+
+            Build::Options opt;
+            opt.manifestPath = Resolve(remote, args.positional[0]);
+            const std::wstring* stamp = args.Get(L"stamp");
+            opt.stampPath = stamp ? Resolve(remote, *stamp) : opt.manifestPath + L".stamp";
+            const std::wstring* depfile = args.Get(L"depfile");
+            opt.depfilePath = depfile ? Resolve(remote, *depfile) : opt.stampPath + L".d";
+            opt.force = args.Has(L"force");
+            opt.writeStats = args.Has(L"stats");
+            if (remote != nullptr)
+            {
+                opt.waitForQueue = true;
+                opt.openInput = [cache = remote->cache](const std::wstring& path) {
+                    Server::Cache::Input input;
+                    std::wstring ignored;
+                    cache->Acquire(path, false, input, ignored);
+                    return input.view;
+                };
+            }
+
+            std::vector<Build::Entry> entries;
+            if (!ReadManifest(opt.manifestPath, entries, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            if (remote == nullptr)
+                StartTrace(args);
+
+            Build::Summary summary;
+            const bool ok = Build::Run(entries, opt, [&](const std::wstring& line) { con.Out(line + L"\r\n"); }, summary, err);
+            if (remote == nullptr)
+            {
+                Converter::ShutdownWorkers(Threading::ShutdownMode::Drain);
+                FinishTrace(con, args);
+            }
+
+            if (!ok)
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            con.Out(std::to_wstring(summary.converted) + L" converted, " + std::to_wstring(summary.upToDate) + L" up to date.\r\n");
+            return EXIT_OK;
+        }
+
+        // A command from a client of the server, run on its connection thread.
+        static int RunServed(const Console& con, const Server::Request& request, Server::Cache& cache, const Server::Metrics& metrics, HANDLE stop)
+        {
+            const Remote remote{ request.workingDir, &cache };
+            const std::wstring cmd = (request.argv.size() > 1u) ? request.argv[1] : std::wstring();
+
+            if (cmd == L"convert")
+                return RunConvert(con, request.argv, &remote);
+            if (cmd == L"build")
+                return RunBuild(con, request.argv, &remote);
+            if (cmd == L"status")
+            {
+                const std::string json = Server::StatusJson(metrics, cache.Counters());
+                con.Out(std::wstring(json.begin(), json.end()));
+                return EXIT_OK;
+            }
+            if (cmd == L"stop")
+            {
+                SetEvent(stop);
+                con.Out(L"Stopping the server.\r\n");
+                return EXIT_OK;
+            }
+            return UsageError(con, L"'" + cmd + L"' does not run in the server.");
+        }
+
+        static int RunServe(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (!args.positional.empty())
+                return UsageError(con, L"serve takes no positional arguments.");
+
+            Server::Options opt;
+            const std::wstring* socketPath = args.Get(L"socket");
+            opt.socketPath = socketPath ? *socketPath : Server::DefaultSocketPath();
+            if (opt.socketPath.empty())
+                return UsageError(con, L"LOCALAPPDATA is not set; pass --socket.");
+
+            uint32_t connections = static_cast<uint32_t>(opt.maxConnections);
+            Server::Cache::Limits limits;
+            uint32_t mapped = static_cast<uint32_t>(limits.maxMapped);
+            if (!ParseUnsignedOption(args, L"connections", connections, err) ||
+                !ParseUnsignedOption(args, L"cache", mapped, err) ||
+                !ParseUnsignedOption(args, L"keep-mapped", limits.keepMappedMs, err))
+                return UsageError(con, err);
+            if (connections == 0u)
+                return UsageError(con, L"--connections must be at least 1.");
+            opt.maxConnections = connections;
+            limits.maxMapped = mapped;
+
+            // The default path's directory is shared with the tuning profile and may not exist yet.
+            const size_t slash = opt.socketPath.find_last_of(L"\\/");
+            if (slash != std::wstring::npos)
+                CreateDirectoryW(opt.socketPath.substr(0u, slash).c_str(), nullptr);
+
+            Server::Cache cache(limits);
+            Server::Metrics metrics;
+            opt.cache = &cache;
+
+            FileIo::Handle stop(CreateEventW(nullptr, TRUE, FALSE, nullptr));
+            if (!stop.valid())
+            {
+                con.Err(L"ERROR: Failed to create the stop event.\r\n");
+                return EXIT_FAILED;
+            }
+
+            g_stopEvent = stop;
+            SetConsoleCtrlHandler(&OnConsoleCtrl, TRUE);
+
+            con.Out(L"Serving on " + opt.socketPath + L"; press Ctrl+C or run 'EmbedPack stop' to stop.\r\n");
+
+            const Server::Handler handler = [&](const Server::Request& request, const Server::TextFn& out, const Server::TextFn& errOut) {
+                return RunServed(Console(out, errOut), request, cache, metrics, stop);
+            };
+            const bool ok = Server::Serve(opt, stop, handler, metrics, [&](const std::wstring& line) { con.Out(line + L"\r\n"); }, err);
+
+            SetConsoleCtrlHandler(&OnConsoleCtrl, FALSE);
+            g_stopEvent = nullptr;
+            Converter::ShutdownWorkers(Threading::ShutdownMode::Drain);
+
+            if (!ok)
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+            return EXIT_OK;
+        }
+
+        // status and stop only make sense against a running server.
+        static int RunServerCommand(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (!args.positional.empty())
+                return UsageError(con, argv[1] + L" takes no positional arguments.");
+
+            const std::wstring* socketPath = args.Get(L"server");
+            const std::wstring path = socketPath ? *socketPath : Server::DefaultSocketPath();
+
+            int exitCode = EXIT_FAILED;
+            const Server::Request request{ CurrentDirectory(), argv };
+            if (!path.empty() && Server::Forward(path, request, [&](const std::wstring& t) { con.Out(t); }, [&](const std::wstring& t) { con.Err(t); }, exitCode))
+                return exitCode;
+
+            con.Err(L"ERROR: No server is listening on " + path + L".\r\n");
+            return EXIT_FAILED;
+        }
+
+        // convert and build go to a server when --server <socket> is given or EMBEDPACK_SERVER is
+        // set, and run in this process when none answers. --trace runs stay here, since a trace
+        // records one process.
+        static bool TryForward(const Console& con, const std::vector<std::wstring>& argv, int& exitCode)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, { L"incremental", L"mapped", L"stats", L"force" }, args, err) || args.Has(L"trace"))
+                return false;
+
+            std::wstring path;
+            if (const std::wstring* socketPath = args.Get(L"server"))
+            {
+                path = *socketPath;
+            }
+            else
+            {
+                wchar_t buf[MAX_PATH];
+                const DWORD n = GetEnvironmentVariableW(L"EMBEDPACK_SERVER", buf, MAX_PATH);
+                if (n > 0u && n < MAX_PATH)
+                    path.assign(buf, n);
+            }
+            if (path.empty())
+                return false;
+
+            const Server::Request request{ CurrentDirectory(), argv };
+            return Server::Forward(path, request, [&](const std::wstring& t) { con.Out(t); }, [&](const std::wstring& t) { con.Err(t); }, exitCode);
+        }
+
+        static int RunBundle(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() < 2u)
+                return UsageError(con, L"bundle expects an output path and at least one input path.");
+
+            Bundle::Options opt;
+            if (!ParseFormat(args, opt.format, err) || !ParseUnsignedOption(args, L"entry-align", opt.entryAlign, err))
+                return UsageError(con, err);
+
+            const std::vector<std::wstring> inputs(args.positional.begin() + 1, args.positional.end());
+            std::vector<Bundle::Entry> entries;
+            if (!Bundle::CollectEntries(inputs, entries, err) || !Bundle::WriteBundle(entries, args.positional[0], opt, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            con.Out(L"Bundled " + std::to_wstring(entries.size()) + L" file(s) into " + args.positional[0] + L"\r\n");
+            return EXIT_OK;
+        }
+
+        static int RunDelta(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() != 3u)
+                return UsageError(con, L"delta expects a base path, a variant path and an output path.");
+
+            Delta::Options opt;
+            if (!ParseFormat(args, opt.format, err) || !ParseUnsignedOption(args, L"block", opt.blockSize, err))
+                return UsageError(con, err);
+
+            Delta::Summary summary;
+            if (!Delta::WriteDelta(args.positional[0], args.positional[1], args.positional[2], opt, summary, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            con.Out(L"Delta of " + std::to_wstring(summary.deltaBytes) + L" bytes for a " + std::to_wstring(summary.variantBytes) +
+                    L"-byte variant (" + std::to_wstring(summary.copies) + L" copies, " + std::to_wstring(summary.inserts) + L" inserts of " +
+                    std::to_wstring(summary.insertedBytes) + L" bytes) into " + args.positional[2] + L"\r\n");
+            return EXIT_OK;
+        }
+
+        static int RunCalibrate(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, { L"dry-run" }, args, err))
+                return UsageError(con, err);
+            if (!args.positional.empty())
+                return UsageError(con, L"calibrate takes no positional arguments.");
+
+            const std::wstring* scratch = args.Get(L"scratch");
+            Tuning::Profile profile;
+            if (!Tuning::Calibrate(scratch ? *scratch : std::wstring(), profile, [&](const std::wstring& line) { con.Out(line + L"\r\n"); }, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            if (args.Has(L"dry-run"))
+                return EXIT_OK;
+
+            const std::wstring path = Tuning::DefaultProfilePath();
+            if (path.empty())
+            {
+                con.Err(L"ERROR: LOCALAPPDATA is not set; set EMBEDPACK_PROFILE to choose the profile path.\r\n");
+                return EXIT_FAILED;
+            }
+            if (!Tuning::SaveProfile(path, profile, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            con.Out(L"Saved " + path + L"\r\n");
+            return EXIT_OK;
+        }
+
+        static int RunDecode(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() != 2u)
+                return UsageError(con, L"decode expects a header path and an output path.");
+
+            Decoder::Options opt;
+            if (!ParseByteOrder(args, opt.byteOrder, err))
+                return UsageError(con, err);
+
+            std::vector<uint8_t> bytes;
+            Decoder::DecodeInfo info;
+            if (!Decoder::DecodeFile(args.positional[0], opt, bytes, info, err) ||
+                !WriteBinaryFile(args.positional[1], bytes, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            con.Out(L"Decoded " + std::to_wstring(bytes.size()) + L" bytes to " + args.positional[1] + L"\r\n");
+            return EXIT_OK;
+        }
+
+        static int RunVerify(const Console& con, const std::vector<std::wstring>& argv)
+        {
+            Args args;
+            std::wstring err;
+            if (!ParseArgs(argv, 2u, {}, args, err))
+                return UsageError(con, err);
+            if (args.positional.size() != 1u)
+                return UsageError(con, L"verify expects exactly one header path.");
+            if (args.Has(L"file") == args.Has(L"sha256"))
+                return UsageError(con, L"verify needs either --file or --sha256.");
+
+            Decoder::Options opt;
+            if (!ParseByteOrder(args, opt.byteOrder, err))
+                return UsageError(con, err);
+
+            std::vector<uint8_t> bytes;
+            Decoder::DecodeInfo info;
+            if (!Decoder::DecodeFile(args.positional[0], opt, bytes, info, err))
+            {
+                con.Err(L"ERROR: " + err + L"\r\n");
+                return EXIT_FAILED;
+            }
+
+            if (const std::wstring* ref = args.Get(L"file"))
+            {
+                if (!Decoder::CompareWithFile(bytes, *ref, err))
+                {
+                    con.Err(L"MISMATCH: " + err + L"\r\n");
+                    return EXIT_FAILED;
+                }
+            }
+            else
+            {
+                Hashing::Sha256Digest digest{};
+                if (!Hashing::Sha256(bytes.data(), bytes.size(), digest))
+                {
+                    con.Err(L"ERROR: SHA-256 computation failed.\r\n");
+                    return EXIT_FAILED;
+                }
+
+                const std::string actual = Hashing::ToHex(digest.data(), digest.size());
+                std::wstring expected = *args.Get(L"sha256");
+                for (wchar_t& ch : expected)
+                {
+                    if (ch >= L'A' && ch <= L'F')
+                        ch = static_cast<wchar_t>(ch - L'A' + L'a');
+                }
+
+                if (expected != std::wstring(actual.begin(), actual.end()))
+                {
+                    con.Err(L"MISMATCH: decoded SHA-256 is " + std::wstring(actual.begin(), actual.end()) + L"\r\n");
+                    return EXIT_FAILED;
+                }
+            }
+
+            con.Out(L"OK: " + std::to_wstring(bytes.size()) + L" bytes match.\r\n");
+            return EXIT_OK;
+        }
+    }
+
+    bool TryRun(int& exitCode)
+    {
+        int argc = 0;
+        LPWSTR* raw = CommandLineToArgvW(GetCommandLineW(), &argc);
+        if (raw == nullptr)
+            return false;
+
+        std::vector<std::wstring> argv(raw, raw + argc);
+        LocalFree(raw);
+
+        if (argv.size() < 2u)
+            return false;
+
+        const Console con;
+        const std::wstring& cmd = argv[1];
+
+        if ((cmd == L"convert" || cmd == L"build") && TryForward(con, argv, exitCode))
+            return true;
+
+        if (cmd == L"convert")
+            exitCode = RunConvert(con, argv);
+        else if (cmd == L"watch")
+            exitCode = RunWatch(con, argv);
+        else if (cmd == L"build")
+            exitCode = RunBuild(con, argv);
+        else if (cmd == L"serve")
+            exitCode = RunServe(con, argv);
+        else if (cmd == L"status" || cmd == L"stop")
+            exitCode = RunServerCommand(con, argv);
+        else if (cmd == L"bundle")
+            exitCode = RunBundle(con, argv);
+        else if (cmd == L"delta")
+            exitCode = RunDelta(con, argv);
+        else if (cmd == L"calibrate")
+            exitCode = RunCalibrate(con, argv);
+        else if (cmd == L"decode")
+            exitCode = RunDecode(con, argv);
+        else if (cmd == L"verify")
+            exitCode = RunVerify(con, argv);
+        else if (cmd == L"help" || cmd == L"--help" || cmd == L"/?")
+        {
+            con.Out(USAGE);
+            exitCode = EXIT_OK;
+        }
+        else
+            exitCode = UsageError(con, L"unknown command '" + cmd + L"'.");
+
+        return true;
+    }
+}
@@ -0,0 +1,13 @@
+// CommandLine.h
+#pragma once
+
+namespace EmbedPack::CommandLine
+{
+    constexpr int EXIT_OK      = 0;
+    constexpr int EXIT_FAILED  = 1;
+    constexpr int EXIT_USAGE   = 2;
+
+    // Runs a console command when the process was started with arguments. Returns false when
+    // there is nothing to do and the GUI should start instead.
+    bool TryRun(int& exitCode);
+}
@@ -1,13 +1,32 @@
 // CoreServices.cpp
 #include "CoreServices.h"
+#include "BlockManifest.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+#include "JobStats.h"
+#include "MemoryBudget.h"
+#include "TextScan.h"
+#include "Tracing.h"
+#include "Transform.h"
+#include "Tuning.h"
+#include "ZeroScan.h"
 
 #include <commdlg.h>
 
+#include <cstdlib>
 #include <cstring>
 #include <cwchar>
 #include <algorithm>
-#include <limits>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -36,32 +55,55 @@ namespace
 
 namespace EmbedPack::Clipboard
 {
-    void SetClipboardUnicode(HWND owner, const std::wstring& text)
+    namespace
     {
-        if (!OpenClipboard(owner))
-            return;
+        // Hands the system a CF_UNICODETEXT block of chars characters; fill writes them, the
+        // terminator is added here.
+        template <typename Fill>
+        void SetClipboardChars(HWND owner, size_t chars, const Fill& fill)
+        {
+            if (!OpenClipboard(owner))
+                return;
 
-        EmptyClipboard();
+            EmptyClipboard();
 
-        const size_t bytes = (text.size() + 1u) * sizeof(wchar_t);
-        HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, bytes);
-        if (hMem != nullptr)
-        {
-            void* pMem = GlobalLock(hMem);
-            if (pMem != nullptr)
+            const size_t bytes = (chars + 1u) * sizeof(wchar_t);
+            HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, bytes);
+            if (hMem != nullptr)
             {
-                std::memcpy(pMem, text.c_str(), bytes);
-                GlobalUnlock(hMem);
+                wchar_t* pMem = static_cast<wchar_t*>(GlobalLock(hMem));
+                if (pMem != nullptr)
+                {
+                    fill(pMem);
+                    pMem[chars] = L'\0';
+                    GlobalUnlock(hMem);
+
+                    SetClipboardData(CF_UNICODETEXT, hMem);
+                    hMem = nullptr; // ownership передано системе
+                }
 
-                SetClipboardData(CF_UNICODETEXT, hMem);
-                hMem = nullptr; // ownership передано системе
+                if (hMem != nullptr)
+                    GlobalFree(hMem);
             }
 
-            if (hMem != nullptr)
-                GlobalFree(hMem);
+            CloseClipboard();
         }
+    }
+
+    void SetClipboardUnicode(HWND owner, const std::wstring& text)
+    {
+        SetClipboardChars(owner, text.size(), [&](wchar_t* dst) {
+            std::memcpy(dst, text.data(), text.size() * sizeof(wchar_t));
+        });
+    }
 
-        CloseClipboard();
+    // Copied chunk by chunk straight into the clipboard block; the text is never made contiguous
+    // on this side.
+    void SetClipboardUnicode(HWND owner, const Text::Rope& text)
+    {
+        SetClipboardChars(owner, text.Size(), [&](wchar_t* dst) {
+            text.CopyTo(0u, dst, text.Size());
+        });
     }
 }
 
@@ -126,72 +168,6 @@ namespace EmbedPack::Converter
 {
     namespace
     {
-        struct Handle final
-        {
-            HANDLE h = nullptr;
-
-            Handle() = default;
-            explicit Handle(HANDLE hh) : h(hh) {}
-
-            ~Handle()
-            {
-                if (h != nullptr && h != INVALID_HANDLE_VALUE)
-                    CloseHandle(h);
-            }
-
-            Handle(const Handle&) = delete;
-            Handle& operator=(const Handle&) = delete;
-
-            Handle(Handle&& o) noexcept : h(o.h) { o.h = nullptr; }
-            Handle& operator=(Handle&& o) noexcept
-            {
-                if (this != &o)
-                {
-                    if (h != nullptr && h != INVALID_HANDLE_VALUE)
-                        CloseHandle(h);
-                    h = o.h;
-                    o.h = nullptr;
-                }
-                return *this;
-            }
-
-            bool valid() const noexcept { return (h != nullptr && h != INVALID_HANDLE_VALUE); }
-            operator HANDLE() const noexcept { return h; }
-        };
-
-        struct MappedView final
-        {
-            const void* p = nullptr;
-
-            MappedView() = default;
-            explicit MappedView(const void* pp) : p(pp) {}
-
-            ~MappedView()
-            {
-                if (p != nullptr)
-                    UnmapViewOfFile(p);
-            }
-
-            MappedView(const MappedView&) = delete;
-            MappedView& operator=(const MappedView&) = delete;
-
-            MappedView(MappedView&& o) noexcept : p(o.p) { o.p = nullptr; }
-            MappedView& operator=(MappedView&& o) noexcept
-            {
-                if (this != &o)
-                {
-                    if (p != nullptr)
-                        UnmapViewOfFile(p);
-                    p = o.p;
-                    o.p = nullptr;
-                }
-                return *this;
-            }
-
-            const void* get() const noexcept { return p; }
-            bool valid() const noexcept { return p != nullptr; }
-        };
-
         static constexpr char HEXA[16] = {
             '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
         };
@@ -229,6 +205,7 @@ namespace EmbedPack::Converter
             const char* prefixStdArray = "const ";
             const char* sizeQualifier  = "const ";
             bool usesStdArray = false;
+            bool isConstexpr = false;
         };
 
         static StyleSpec GetStyleSpec(Converter::ArrayStyle s)
@@ -237,75 +214,130 @@ namespace EmbedPack::Converter
             switch (s)
             {
             case ArrayStyle::ConstArray:
-                return { s, "const ", "const ", "const ", false };
+                return { s, "const ", "const ", "const ", false, false };
             case ArrayStyle::StaticConstArray:
-                return { s, "static const ", "static const ", "static const ", false };
+                return { s, "static const ", "static const ", "static const ", false, false };
             case ArrayStyle::ConstexprArray:
-                return { s, "constexpr ", "constexpr ", "constexpr ", false };
+                return { s, "constexpr ", "constexpr ", "constexpr ", false, true };
             case ArrayStyle::ConstexprStdArray:
-                return { s, "", "constexpr ", "constexpr ", true };
+                return { s, "", "constexpr ", "constexpr ", true, true };
             case ArrayStyle::StaticConstexprStdArray:
-                return { s, "", "static constexpr ", "static constexpr ", true };
+                return { s, "", "static constexpr ", "static constexpr ", true, true };
             default:
-                return { ArrayStyle::ConstArray, "const ", "const ", "const ", false };
+                return { ArrayStyle::ConstArray, "const ", "const ", "const ", false, false };
             }
         }
 
-        static size_t ValuesPerLine(size_t elemSize)
+        static bool ValidateLayout(const Converter::Format& fmt, std::wstring& err)
         {
-            const size_t v = (elemSize == 0u) ? 1u : (16u / elemSize);
-            return (v == 0u) ? 1u : v;
-        }
+            const uint32_t a = fmt.alignment;
+            if (a != 0u && (((a & (a - 1u)) != 0u) || a > Converter::PAGE_SIZE))
+            {
+                err = L"Invalid alignment (expected a power of two up to 4096).";
+                return false;
+            }
 
-        static bool WriteAll(HANDLE h, const void* data, DWORD size, std::wstring& err)
-        {
-            const uint8_t* p = static_cast<const uint8_t*>(data);
-            DWORD remaining = size;
-            while (remaining > 0u)
+            // PE images keep at most 8 characters of a section name.
+            if (fmt.sectionName.size() > 8u)
             {
-                DWORD written = 0u;
-                if (!WriteFile(h, p, remaining, &written, nullptr))
-                {
-                    err = L"Failed to write output file.";
-                    return false;
-                }
-                if (written == 0u)
+                err = L"Section name is too long (8 characters max).";
+                return false;
+            }
+
+            for (const char ch : fmt.sectionName)
+            {
+                const bool ok =
+                    (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                    (ch >= '0' && ch <= '9') || ch == '.' || ch == '_' || ch == '$';
+                if (!ok)
                 {
-                    err = L"Failed to write output file (0 bytes written).";
+                    err = L"Invalid section name.";
                     return false;
                 }
-                p += written;
-                remaining -= written;
             }
+
             return true;
         }
 
-        static void AppendHexValue(std::string& dst, uint64_t value, size_t hexDigits)
+        static size_t TailPaddingUnit(Converter::TailPadding pad, size_t elemSize)
         {
-            dst.push_back('0');
-            dst.push_back('x');
-            for (size_t i = 0u; i < hexDigits; ++i)
+            switch (pad)
             {
-                const size_t shift = (hexDigits - 1u - i) * 4u;
-                const uint8_t nibble = static_cast<uint8_t>((value >> shift) & 0x0Fu);
-                dst.push_back(HEXA[nibble]);
+            case Converter::TailPadding::CacheLine: return Converter::CACHE_LINE_SIZE;
+            case Converter::TailPadding::Page:      return Converter::PAGE_SIZE;
+            default:                                return elemSize;
             }
         }
 
-        static void AppendIncludes(const FormatSpec& f, const StyleSpec& s, std::string& out)
+        static size_t ComputeElementCount(size_t byteCount, size_t elemSize, Converter::TailPadding pad)
+        {
+            if (elemSize == 0u)
+                return 0u;
+
+            const size_t unit = TailPaddingUnit(pad, elemSize);
+            const size_t paddedBytes = ((byteCount + unit - 1u) / unit) * unit;
+            return paddedBytes / elemSize;
+        }
+
+        // CRC32C and/or XXH64 of the original input bytes, fed slice by slice by the formatting
+        // pass (or the block-hash pass in incremental mode) instead of reading the input again.
+        class ChecksumPass final
+        {
+        public:
+            explicit ChecksumPass(Converter::Checksum kind) noexcept
+                : m_crc(kind == Converter::Checksum::Crc32c || kind == Converter::Checksum::Both),
+                  m_xxh(kind == Converter::Checksum::Xxh64 || kind == Converter::Checksum::Both)
+            {
+            }
+
+            bool Active() const noexcept { return m_crc || m_xxh; }
+            bool HasCrc32c() const noexcept { return m_crc; }
+            bool HasXxh64() const noexcept { return m_xxh; }
+            size_t Bytes() const noexcept { return m_bytes; }
+
+            void Update(const uint8_t* data, size_t size)
+            {
+                if (m_crc)
+                    m_crc32c = Hashing::Crc32c(data, size, m_crc32c);
+                if (m_xxh)
+                    m_xxh64.Update(data, size);
+                m_bytes += size;
+            }
+
+            uint32_t Crc32c() const noexcept { return m_crc32c; }
+            uint64_t Xxh64() const noexcept { return m_xxh64.Digest(); }
+
+        private:
+            bool m_crc;
+            bool m_xxh;
+            size_t m_bytes = 0u;
+            uint32_t m_crc32c = 0u;
+            Hashing::Xxh64Stream m_xxh64{};
+        };
+
+        static void AppendIncludes(const FormatSpec& f, const StyleSpec& s, const Converter::Format& fmt, std::string& out)
         {
+            const bool sparse = (fmt.zeroElision == Converter::ZeroElision::Sparse);
+            const bool needsCstdint = f.needsCstdint || fmt.checksum != Converter::Checksum::None;
+            const bool needsArray = s.usesStdArray || (sparse && s.isConstexpr);
+
             bool any = false;
-            if (f.needsCstdint)
+            if (needsCstdint)
             {
                 out.append("#include <cstdint>\r\n");
                 any = true;
             }
-            if (f.needsCstddef || s.usesStdArray || f.needsCstdint)
+            if (f.needsCstddef || needsArray || needsCstdint || sparse)
             {
                 out.append("#include <cstddef>\r\n");
                 any = true;
             }
-            if (s.usesStdArray)
+            if (sparse)
+            {
+                out.append("#include <cstring>\r\n");
+                any = true;
+            }
+            if (needsArray)
             {
                 out.append("#include <array>\r\n");
                 any = true;
@@ -315,8 +347,53 @@ namespace EmbedPack::Converter
                 out.append("\r\n");
         }
 
-        static void AppendHeader(const FormatSpec& f, const StyleSpec& s, size_t elementCount, std::string& out)
+        static void AppendSectionPreamble(const Converter::Format& fmt, std::string& out)
+        {
+            if (fmt.sectionName.empty())
+                return;
+
+            out.append(
+                "#ifndef EMBEDPACK_SECTION\r\n"
+                "#if defined(_MSC_VER)\r\n"
+                "#define EMBEDPACK_SECTION(name) __declspec(allocate(name))\r\n"
+                "#else\r\n"
+                "#define EMBEDPACK_SECTION(name) __attribute__((section(name)))\r\n"
+                "#endif\r\n"
+                "#endif\r\n");
+
+            out.append("#if defined(_MSC_VER)\r\n#pragma section(\"");
+            out.append(fmt.sectionName);
+            out.append("\", read)\r\n#endif\r\n\r\n");
+        }
+
+        static void AppendLayoutAttributes(const FormatSpec& f, const Converter::Format& fmt, std::string& out)
         {
+            if (fmt.alignment != 0u)
+            {
+                const size_t align = std::max<size_t>(fmt.alignment, f.elemSize);
+                out.append("alignas(");
+                out.append(std::to_string(align));
+                out.append(") ");
+            }
+
+            if (!fmt.sectionName.empty())
+            {
+                out.append("EMBEDPACK_SECTION(\"");
+                out.append(fmt.sectionName);
+                out.append("\") ");
+            }
+        }
+
+        static void AppendHeader(
+            const FormatSpec& f,
+            const StyleSpec& s,
+            const Converter::Format& fmt,
+            size_t elementCount,
+            std::string& out,
+            const char* name = "fileBytes")
+        {
+            AppendLayoutAttributes(f, fmt, out);
+
             if (s.usesStdArray)
             {
                 out.append(s.prefixStdArray);
@@ -324,29 +401,48 @@ namespace EmbedPack::Converter
                 out.append(f.typeName);
                 out.append(", ");
                 out.append(std::to_string(elementCount));
-                out.append("> fileBytes = {");
+                out.append("> ");
+                out.append(name);
+                out.append(" = {");
             }
             else
             {
                 out.append(s.prefixNonArray);
                 out.append(f.typeName);
-                out.append(" fileBytes[] = {");
+
+                // A trimmed initializer is shorter than the array; the explicit bound keeps the size.
+                out.push_back(' ');
+                out.append(name);
+                if (fmt.zeroElision == Converter::ZeroElision::Trailing)
+                {
+                    out.append("[");
+                    out.append(std::to_string(elementCount));
+                    out.append("] = {");
+                }
+                else
+                {
+                    out.append("[] = {");
+                }
             }
         }
 
-        static void AppendFooter(
+        // Fixed width, so an in-place patch can rewrite the footer without moving anything.
+        static void AppendHexLiteral(uint64_t value, size_t digits, std::string& out)
+        {
+            out.append("0x");
+            for (size_t i = digits; i-- > 0u;)
+                out.push_back(HEXA[(value >> (i * 4u)) & 0x0Fu]);
+        }
+
+        // fileBytesOriginalSize and the checksums, shared by the dense and sparse footers.
+        static void AppendCompanions(
             const FormatSpec& f,
             const StyleSpec& s,
             size_t elementCount,
             size_t byteCount,
+            const ChecksumPass& sums,
             std::string& out)
         {
-            out.append("\r\n};\r\n");
-
-            out.append(s.sizeQualifier);
-            out.append("size_t fileBytesSize = ");
-            out.append("sizeof(fileBytes);\r\n");
-
             const size_t paddedBytes = elementCount * f.elemSize;
             if (paddedBytes != byteCount)
             {
@@ -355,335 +451,1966 @@ namespace EmbedPack::Converter
                 out.append(std::to_string(byteCount));
                 out.append(";\r\n");
             }
-        }
-
-        static void AppendValueToken(const FormatSpec& f, uint64_t value, size_t hexDigits, std::string& out)
-        {
-            if (f.usesStdByte)
-                out.append("std::byte{");
 
-            AppendHexValue(out, value, hexDigits);
-
-            if (f.usesStdByte)
-                out.push_back('}');
+            // Both cover the original bytes only, never the tail padding.
+            if (sums.HasCrc32c())
+            {
+                out.append(s.sizeQualifier);
+                out.append("uint32_t fileBytesCrc32c = ");
+                AppendHexLiteral(sums.Crc32c(), 8u, out);
+                out.append("u;\r\n");
+            }
+            if (sums.HasXxh64())
+            {
+                out.append(s.sizeQualifier);
+                out.append("uint64_t fileBytesXxh64 = ");
+                AppendHexLiteral(sums.Xxh64(), 16u, out);
+                out.append("ull;\r\n");
+            }
         }
 
-        static void BuildArrayAscii(
-            const uint8_t* data,
+        static void AppendFooter(
+            const FormatSpec& f,
+            const StyleSpec& s,
+            size_t elementCount,
             size_t byteCount,
-            const Converter::Format& fmt,
+            const ChecksumPass& sums,
             std::string& out)
         {
-            const FormatSpec f = GetFormatSpec(fmt.elementType);
-            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
-
-            const size_t elemSize = f.elemSize;
-            const size_t elementCount = (elemSize == 0u)
-                ? 0u
-                : ((byteCount + elemSize - 1u) / elemSize);
-
-            const size_t hexDigits = std::max<size_t>(2u, elemSize * 2u);
-            const size_t valuesPerLine = ValuesPerLine(elemSize);
-
-            out.clear();
-            out.reserve(byteCount * 5u + 256u);
-
-            AppendIncludes(f, s, out);
-            AppendHeader(f, s, elementCount, out);
+            out.append("\r\n};\r\n");
 
-            for (size_t i = 0u; i < elementCount; ++i)
-            {
-                if ((i % valuesPerLine) == 0u)
-                    out.append("\r\n    ");
+            out.append(s.sizeQualifier);
+            out.append("size_t fileBytesSize = ");
+            out.append("sizeof(fileBytes);\r\n");
 
-                uint64_t value = 0u;
-                const size_t base = i * elemSize;
-                for (size_t b = 0u; b < elemSize; ++b)
-                {
-                    const size_t idx = base + b;
-                    const uint8_t byte = (idx < byteCount) ? data[idx] : 0u;
-                    value |= static_cast<uint64_t>(byte) << (8u * b);
-                }
+            AppendCompanions(f, s, elementCount, byteCount, sums, out);
+        }
 
-                AppendValueToken(f, value, hexDigits, out);
+        // Zero runs shorter than this stay inside a segment: a new segment costs a declaration and
+        // a table row, roughly what a kilobyte of zeros costs at the widest element type.
+        static constexpr size_t SPARSE_MIN_GAP_BYTES = 1024u;
 
-                if (i + 1u != elementCount)
-                    out.append(", ");
-            }
+        // What a sparse header adds to the dense one at most: the segment type, the table frame and
+        // the fill routines. Each segment's own overhead is below the zero run that starts it.
+        static constexpr size_t SPARSE_FIXED_TEXT_BYTES = 4096u;
 
-            AppendFooter(f, s, elementCount, byteCount, out);
+        static void AppendSparsePreamble(const FormatSpec& f, std::string& out)
+        {
+            out.append(
+                "#ifndef EMBEDPACK_SEGMENT_DEFINED\r\n"
+                "#define EMBEDPACK_SEGMENT_DEFINED\r\n"
+                "template <typename T>\r\n"
+                "struct EmbedPackSegment\r\n"
+                "{\r\n"
+                "    size_t offset; // in elements\r\n"
+                "    const T* data;\r\n"
+                "    size_t count;\r\n"
+                "};\r\n"
+                "#endif\r\n\r\n");
+
+            out.append("using fileBytesElement = ");
+            out.append(f.typeName);
+            out.append(";\r\n\r\n");
         }
 
-        static bool ConvertSmallToMemory(
-            const std::wstring& path,
+        static void AppendSegmentHeader(
+            const FormatSpec& f,
+            const StyleSpec& s,
             const Converter::Format& fmt,
-            std::wstring& out,
-            std::wstring& err)
+            size_t index,
+            std::string& out)
         {
-            err.clear();
-            out.clear();
+            // The section still applies; alignment is the job of the buffer the image is filled into.
+            Converter::Format segmentFmt = fmt;
+            segmentFmt.alignment = 0u;
+            AppendLayoutAttributes(f, segmentFmt, out);
 
-            Handle hFile(CreateFileW(
-                path.c_str(),
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                nullptr,
-                OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                nullptr));
+            out.append(s.sizeQualifier);
+            out.append(f.typeName);
+            out.append(" fileBytesSeg");
+            out.append(std::to_string(index));
+            out.append("[] = {");
+        }
 
-            if (!hFile.valid())
+        static void AppendSparseFooter(
+            const FormatSpec& f,
+            const StyleSpec& s,
+            size_t elementCount,
+            size_t byteCount,
+            const std::vector<ZeroScan::Segment>& segments,
+            const ChecksumPass& sums,
+            std::string& out)
+        {
+            if (!segments.empty())
             {
-                err = L"Failed to open the file.";
-                return false;
+                out.append(s.sizeQualifier);
+                out.append("EmbedPackSegment<fileBytesElement> fileBytesSegments[] = {");
+                for (size_t i = 0u; i < segments.size(); ++i)
+                {
+                    const size_t count = (segments[i].end - segments[i].begin + f.elemSize - 1u) / f.elemSize;
+                    out.append("\r\n    { ");
+                    out.append(std::to_string(segments[i].begin / f.elemSize));
+                    out.append(", fileBytesSeg");
+                    out.append(std::to_string(i));
+                    out.append(", ");
+                    out.append(std::to_string(count));
+                    out.append(" },");
+                }
+                out.append("\r\n};\r\n");
             }
 
-            LARGE_INTEGER liSize{};
-            if (!GetFileSizeEx(hFile, &liSize))
-            {
-                err = L"Failed to query file size.";
-                return false;
-            }
+            out.append(s.sizeQualifier);
+            out.append("size_t fileBytesSegmentCount = ");
+            out.append(std::to_string(segments.size()));
+            out.append(";\r\n");
 
-            if (liSize.QuadPart < 0)
+            out.append(s.sizeQualifier);
+            out.append("size_t fileBytesSize = ");
+            out.append(std::to_string(elementCount * f.elemSize));
+            out.append(";\r\n");
+
+            AppendCompanions(f, s, elementCount, byteCount, sums, out);
+
+            out.append(
+                "\r\n"
+                "// Writes the fileBytesSize-byte image to dst; everything outside the segments is zero.\r\n"
+                "static inline void fileBytesFill(fileBytesElement* dst)\r\n"
+                "{\r\n"
+                "    std::memset(dst, 0, fileBytesSize);\r\n");
+            if (!segments.empty())
             {
-                err = L"Invalid file size.";
-                return false;
+                out.append(
+                    "    for (const auto& s : fileBytesSegments)\r\n"
+                    "        std::memcpy(dst + s.offset, s.data, s.count * sizeof(fileBytesElement));\r\n");
             }
-
-            const uint64_t fileSize64 = static_cast<uint64_t>(liSize.QuadPart);
-            if (fileSize64 > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+            out.append("}\r\n");
+
+            if (!s.isConstexpr)
+                return;
+
+            const std::string arrayType = "std::array<fileBytesElement, " + std::to_string(elementCount) + ">";
+            out.append(
+                "\r\n"
+                "// Constant-evaluated image; large images can exceed the compiler's constexpr step limit.\r\n"
+                "static constexpr ");
+            out.append(arrayType);
+            out.append(" fileBytesExpand()\r\n{\r\n    ");
+            out.append(arrayType);
+            out.append(" a{};\r\n");
+            if (!segments.empty())
             {
-                err = L"File is too large for this process.";
-                return false;
+                out.append(
+                    "    for (const auto& s : fileBytesSegments)\r\n"
+                    "        for (size_t i = 0; i < s.count; ++i)\r\n"
+                    "            a[s.offset + i] = s.data[i];\r\n");
             }
+            out.append("    return a;\r\n}\r\n");
+        }
 
-            const size_t fileSize = static_cast<size_t>(fileSize64);
+        struct HexPairTable
+        {
+            char pairs[512];
 
-            Handle hMap(CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0u, 0u, nullptr));
-            if (!hMap.valid())
+            constexpr HexPairTable() : pairs{}
             {
-                err = L"Failed to create file mapping.";
-                return false;
+                for (size_t i = 0u; i < 256u; ++i)
+                {
+                    pairs[i * 2u]      = HEXA[i >> 4u];
+                    pairs[i * 2u + 1u] = HEXA[i & 0x0Fu];
+                }
             }
+        };
 
-            MappedView view(MapViewOfFile(hMap, FILE_MAP_READ, 0u, 0u, 0u));
-            if (!view.valid() && fileSize != 0u)
-            {
-                err = L"Failed to map file view.";
-                return false;
-            }
+        static constexpr HexPairTable HEX_PAIRS{};
 
-            const auto* data = static_cast<const uint8_t*>(view.get());
+        static constexpr char LINE_PREFIX[] = "\r\n    ";
+        static constexpr size_t LINE_PREFIX_LEN = sizeof(LINE_PREFIX) - 1u;
+        static constexpr size_t SEPARATOR_LEN = 2u;
 
-            std::string ascii;
-            BuildArrayAscii(data, fileSize, fmt, ascii);
-            out.assign(ascii.begin(), ascii.end());
-            return true;
-        }
+        static inline uint8_t ByteSwap(uint8_t v) noexcept { return v; }
 
-        static bool ConvertLargeToFile(
-            const std::wstring& inPath,
-            const std::wstring& outPath,
-            HWND notifyHwnd,
-            const Converter::Format& fmt,
-            std::wstring& err)
+        static inline uint16_t ByteSwap(uint16_t v) noexcept
         {
-            err.clear();
+#if defined(_MSC_VER)
+            return _byteswap_ushort(v);
+#else
+            return __builtin_bswap16(v);
+#endif
+        }
 
-            Handle hIn(CreateFileW(
-                inPath.c_str(),
-                GENERIC_READ,
-                FILE_SHARE_READ,
-                nullptr,
-                OPEN_EXISTING,
-                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                nullptr));
+        static inline uint32_t ByteSwap(uint32_t v) noexcept
+        {
+#if defined(_MSC_VER)
+            return _byteswap_ulong(v);
+#else
+            return __builtin_bswap32(v);
+#endif
+        }
 
-            if (!hIn.valid())
-            {
-                err = L"Failed to open the input file.";
-                return false;
-            }
+        static inline uint64_t ByteSwap(uint64_t v) noexcept
+        {
+#if defined(_MSC_VER)
+            return _byteswap_uint64(v);
+#else
+            return __builtin_bswap64(v);
+#endif
+        }
 
-            LARGE_INTEGER liSize{};
-            if (!GetFileSizeEx(hIn, &liSize))
-            {
-                err = L"Failed to query input file size.";
-                return false;
-            }
+        // One instantiation per (element width, byte order, std::byte wrapping). Windows targets are
+        // little-endian, so an unaligned memcpy load already yields the little-endian grouping.
+        template <typename T, bool BigEndian, bool StdByte>
+        struct ElementKernel final
+        {
+            static constexpr size_t ELEM_SIZE = sizeof(T);
+            static constexpr size_t VALUES_PER_LINE = 16u / sizeof(T);
+            static constexpr size_t TOKEN_LEN = (StdByte ? 11u : 0u) + 2u + sizeof(T) * 2u;
 
-            if (liSize.QuadPart < 0)
+            static inline T Load(const uint8_t* p) noexcept
             {
-                err = L"Invalid input file size.";
-                return false;
+                T v;
+                std::memcpy(&v, p, sizeof(T));
+                if constexpr (BigEndian)
+                    v = ByteSwap(v);
+                return v;
             }
 
-            const uint64_t fileSize64 = static_cast<uint64_t>(liSize.QuadPart);
-            if (fileSize64 > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+            static inline char* PutToken(char* dst, T v) noexcept
             {
-                err = L"File is too large for this process.";
-                return false;
-            }
-
-            const size_t fileSize = static_cast<size_t>(fileSize64);
+                if constexpr (StdByte)
+                {
+                    std::memcpy(dst, "std::byte{", 10u);
+                    dst += 10u;
+                }
 
-            Handle hMap(CreateFileMappingW(hIn, nullptr, PAGE_READONLY, 0u, 0u, nullptr));
-            if (!hMap.valid())
-            {
-                err = L"Failed to create file mapping.";
-                return false;
-            }
+                dst[0] = '0';
+                dst[1] = 'x';
+                dst += 2u;
 
-            MappedView view(MapViewOfFile(hMap, FILE_MAP_READ, 0u, 0u, 0u));
-            if (!view.valid() && fileSize != 0u)
-            {
-                err = L"Failed to map file view.";
-                return false;
-            }
+                for (size_t k = 0u; k < sizeof(T); ++k)
+                {
+                    const size_t shift = (sizeof(T) - 1u - k) * 8u;
+                    const auto b = static_cast<uint8_t>(static_cast<uint64_t>(v) >> shift);
+                    std::memcpy(dst, &HEX_PAIRS.pairs[b * 2u], 2u);
+                    dst += 2u;
+                }
 
-            Handle hOut(CreateFileW(
-                outPath.c_str(),
-                GENERIC_WRITE,
-                0,
-                nullptr,
-                CREATE_ALWAYS,
-                FILE_ATTRIBUTE_NORMAL,
-                nullptr));
+                if constexpr (StdByte)
+                    *dst++ = '}';
 
-            if (!hOut.valid())
-            {
-                err = L"Failed to create output file.";
-                return false;
+                return dst;
             }
 
-            const FormatSpec f = GetFormatSpec(fmt.elementType);
-            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
-
-            const size_t elemSize = f.elemSize;
-            const size_t elementCount = (elemSize == 0u)
-                ? 0u
-                : ((fileSize + elemSize - 1u) / elemSize);
-            const size_t hexDigits = std::max<size_t>(2u, elemSize * 2u);
-            const size_t valuesPerLine = ValuesPerLine(elemSize);
-
-            const uint8_t* data = static_cast<const uint8_t*>(view.get());
-
-            std::string buf;
-            buf.reserve(8u * 1024u * 1024u);
-
-            AppendIncludes(f, s, buf);
-            AppendHeader(f, s, elementCount, buf);
-            if (!WriteAll(hOut, buf.data(), static_cast<DWORD>(buf.size()), err))
-                return false;
-
-            buf.clear();
-
-            const DWORD tickStepMs = 120u;
-            DWORD lastTick = GetTickCount();
-
-            for (size_t i = 0u; i < elementCount; ++i)
+            static inline char* PutLine(const uint8_t* src, char* dst) noexcept
             {
-                if ((i % valuesPerLine) == 0u)
-                    buf.append("\r\n    ");
+                std::memcpy(dst, LINE_PREFIX, LINE_PREFIX_LEN);
+                dst += LINE_PREFIX_LEN;
 
-                uint64_t value = 0u;
-                const size_t base = i * elemSize;
-                for (size_t b = 0u; b < elemSize; ++b)
+                for (size_t k = 0u; k < VALUES_PER_LINE; ++k)
                 {
-                    const size_t idx = base + b;
-                    const uint8_t byte = (idx < fileSize) ? data[idx] : 0u;
-                    value |= static_cast<uint64_t>(byte) << (8u * b);
+                    dst = PutToken(dst, Load(src + k * sizeof(T)));
+                    dst[0] = ',';
+                    dst[1] = ' ';
+                    dst += SEPARATOR_LEN;
                 }
+                return dst;
+            }
 
-                AppendValueToken(f, value, hexDigits, buf);
-
-                if (i + 1u != elementCount)
-                    buf.append(", ");
+            // Formats elements [first, end) of the body. Only whole elements that are followed by a
+            // separator go through the hot loop; the partial tail element and zero padding are
+            // handled once afterwards.
+            static char* FormatRange(
+                const uint8_t* data,
+                size_t byteCount,
+                size_t elementCount,
+                size_t first,
+                size_t end,
+                char* dst) noexcept
+            {
+                const size_t fullElements = byteCount / sizeof(T);
+                const size_t hotEnd = std::min(end, std::min(fullElements, elementCount - 1u));
 
-                if (buf.size() >= (8u * 1024u * 1024u))
+                size_t i = first;
+                for (; i < hotEnd && (i % VALUES_PER_LINE) != 0u; ++i)
                 {
-                    if (!WriteAll(hOut, buf.data(), static_cast<DWORD>(buf.size()), err))
-                        return false;
-                    buf.clear();
+                    dst = PutToken(dst, Load(data + i * sizeof(T)));
+                    dst[0] = ',';
+                    dst[1] = ' ';
+                    dst += SEPARATOR_LEN;
                 }
 
-                const DWORD now = GetTickCount();
-                if ((now - lastTick) >= tickStepMs)
+                for (; i + VALUES_PER_LINE <= hotEnd; i += VALUES_PER_LINE)
+                    dst = PutLine(data + i * sizeof(T), dst);
+
+                for (; i < end; ++i)
                 {
-                    lastTick = now;
-                    const size_t processed = std::min<size_t>(fileSize, (i + 1u) * elemSize);
-                    const int pct = (fileSize == 0u) ? 100 : static_cast<int>((processed * 100u) / fileSize);
-                    PostMessageW(notifyHwnd, AppMessages::WM_APP_PROGRESS, static_cast<WPARAM>(pct), 0);
+                    if ((i % VALUES_PER_LINE) == 0u)
+                    {
+                        std::memcpy(dst, LINE_PREFIX, LINE_PREFIX_LEN);
+                        dst += LINE_PREFIX_LEN;
+                    }
+
+                    uint8_t tail[sizeof(T)]{};
+                    const size_t base = i * sizeof(T);
+                    if (base < byteCount)
+                        std::memcpy(tail, data + base, std::min(sizeof(T), byteCount - base));
+
+                    dst = PutToken(dst, Load(tail));
+
+                    if (i + 1u != elementCount)
+                    {
+                        dst[0] = ',';
+                        dst[1] = ' ';
+                        dst += SEPARATOR_LEN;
+                    }
                 }
-            }
 
-            if (!buf.empty())
-            {
-                if (!WriteAll(hOut, buf.data(), static_cast<DWORD>(buf.size()), err))
-                    return false;
-                buf.clear();
+                return dst;
             }
+        };
 
-            AppendFooter(f, s, elementCount, fileSize, buf);
-            if (!WriteAll(hOut, buf.data(), static_cast<DWORD>(buf.size()), err))
-                return false;
-
-            PostMessageW(notifyHwnd, AppMessages::WM_APP_PROGRESS, 100, 0);
-            return true;
-        }
+        using FormatRangeFn = char* (*)(const uint8_t*, size_t, size_t, size_t, size_t, char*);
 
-        struct WorkerCtx
+        struct Kernel
         {
-            Job job{};
-            std::wstring* outSmall = nullptr;
+            FormatRangeFn formatRange = nullptr;
+            size_t valuesPerLine = 16u;
+            size_t tokenLen = 4u;
         };
 
-        static DWORD WINAPI WorkerThread(LPVOID param)
+        template <typename T, bool BigEndian, bool StdByte>
+        static constexpr Kernel MakeKernel()
         {
-            WorkerCtx* ctx = static_cast<WorkerCtx*>(param);
+            using K = ElementKernel<T, BigEndian, StdByte>;
+            return { &K::FormatRange, K::VALUES_PER_LINE, K::TOKEN_LEN };
+        }
+
+        static Kernel SelectKernel(const FormatSpec& f, Converter::ByteOrder order)
+        {
+            const bool be = (order == Converter::ByteOrder::BigEndian);
+            switch (f.elemSize)
+            {
+            case 2u: return be ? MakeKernel<uint16_t, true, false>() : MakeKernel<uint16_t, false, false>();
+            case 4u: return be ? MakeKernel<uint32_t, true, false>() : MakeKernel<uint32_t, false, false>();
+            case 8u: return be ? MakeKernel<uint64_t, true, false>() : MakeKernel<uint64_t, false, false>();
+            default: return f.usesStdByte ? MakeKernel<uint8_t, false, true>() : MakeKernel<uint8_t, false, false>();
+            }
+        }
+
+        // Text offset of element i within the body: every earlier line contributes its prefix and
+        // every earlier element its token plus separator.
+        static size_t SlotOffset(const Kernel& k, size_t i)
+        {
+            const size_t linesBefore = (i + k.valuesPerLine - 1u) / k.valuesPerLine;
+            return linesBefore * LINE_PREFIX_LEN + i * (k.tokenLen + SEPARATOR_LEN);
+        }
+
+        static size_t RangeTextSize(const Kernel& k, size_t elementCount, size_t first, size_t end)
+        {
+            if (first >= end)
+                return 0u;
+
+            size_t size = SlotOffset(k, end) - SlotOffset(k, first);
+            if (end == elementCount)
+                size -= SEPARATOR_LEN;
+            return size;
+        }
+
+        static constexpr size_t FUSE_SLICE_BYTES = 32u * 1024u;
+
+        // Pending large-mode text that triggers a write; from the host's tuning profile.
+        static size_t FlushBytes()
+        {
+            return Tuning::Active().flushBytes;
+        }
+
+        // Formats elements [first, end) and, when sums is set, feeds each FUSE_SLICE_BYTES slice of
+        // input to the checksums right after formatting it, while it is still in cache.
+        static char* FormatAndSum(
+            const Kernel& k,
+            const uint8_t* data,
+            size_t byteCount,
+            size_t elementCount,
+            size_t elemSize,
+            size_t first,
+            size_t end,
+            ChecksumPass* sums,
+            char* dst)
+        {
+            if (sums == nullptr)
+                return k.formatRange(data, byteCount, elementCount, first, end, dst);
+
+            const size_t sliceElems = FUSE_SLICE_BYTES / elemSize;
+            for (size_t i = first; i < end; i += sliceElems)
+            {
+                const size_t sliceEnd = std::min(end, i + sliceElems);
+                dst = k.formatRange(data, byteCount, elementCount, i, sliceEnd, dst);
+
+                const size_t lo = std::min(byteCount, i * elemSize);
+                const size_t hi = std::min(byteCount, sliceEnd * elemSize);
+                sums->Update(data + lo, hi - lo);
+            }
+            return dst;
+        }
+
+        // What the dense initializer spells out. Without trimming that is every element including
+        // tail padding; trimming stops after the element holding the last non-zero byte.
+        struct DenseBody
+        {
+            size_t bytes = 0u;
+            size_t elements = 0u;
+        };
+
+        static DenseBody GetDenseBody(
+            const FormatSpec& f,
+            const Converter::Format& fmt,
+            const uint8_t* data,
+            size_t byteCount,
+            size_t elementCount)
+        {
+            if (fmt.zeroElision != Converter::ZeroElision::Trailing)
+                return { byteCount, elementCount };
+
+            const size_t elements = (ZeroScan::TrimmedSize(data, byteCount) + f.elemSize - 1u) / f.elemSize;
+            return { std::min(byteCount, elements * f.elemSize), elements };
+        }
+
+        // Formats a slice at a time into a small scratch buffer and widens each slice into the
+        // rope, so the output never exists as one contiguous string. Stops early on cancel; the
+        // caller checks the token.
+        static void BuildArrayRope(
+            const uint8_t* data,
+            size_t byteCount,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            Text::Rope& out)
+        {
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+            const Kernel k = SelectKernel(f, fmt.byteOrder);
+
+            const size_t elementCount = ComputeElementCount(byteCount, f.elemSize, fmt.tailPadding);
+            const DenseBody body = GetDenseBody(f, fmt, data, byteCount, elementCount);
+
+            const size_t lineText = LINE_PREFIX_LEN + k.valuesPerLine * (k.tokenLen + SEPARATOR_LEN);
+            const size_t sliceElems = std::max<size_t>(1u, Text::Rope::CHUNK_CHARS / lineText) * k.valuesPerLine;
+
+            out.Clear();
+
+            std::string buf;
+            AppendIncludes(f, s, fmt, buf);
+            AppendSectionPreamble(fmt, buf);
+            AppendHeader(f, s, fmt, elementCount, buf);
+            out.AppendAscii(buf);
+
+            // The footer carries the checksums, so it is appended once the body pass is done.
+            ChecksumPass sums(fmt.checksum);
+            ChecksumPass* const fused = sums.Active() ? &sums : nullptr;
+
+            for (size_t first = 0u; first < body.elements; first += sliceElems)
+            {
+                if (cancel.IsSet())
+                    return;
+
+                const size_t end = std::min(body.elements, first + sliceElems);
+                buf.resize(RangeTextSize(k, body.elements, first, end));
+                FormatAndSum(k, data, body.bytes, body.elements, f.elemSize, first, end, fused, &buf[0]);
+                out.AppendAscii(buf);
+            }
+            if (fused)
+                fused->Update(data + body.bytes, byteCount - body.bytes);
+
+            buf.clear();
+            AppendFooter(f, s, elementCount, byteCount, sums, buf);
+            out.AppendAscii(buf);
+        }
+
+        // MSVC rejects a single literal piece over 16380 bytes (C2026).
+        static constexpr size_t TEXT_PIECE_BYTES = 16000u;
+        // Non-ASCII bytes escaped per ordinary literal, one literal per line.
+        static constexpr size_t TEXT_ESCAPE_BYTES = 32u;
+        // Worst case, a non-ASCII byte alone between two CRs: a line of its own.
+        static constexpr size_t TEXT_MAX_CHARS_PER_BYTE = 12u;
+
+        static bool IsTextOutput(const Converter::Format& fmt, const uint8_t* data, size_t byteCount, ConversionStats& stats)
+        {
+            // std::byte arrays and wider elements cannot be initialized from a string literal, and
+            // a std::array output must stay a std::array whatever its content.
+            if (fmt.textLiteral != Converter::TextLiteral::Auto || byteCount > Converter::TEXT_LITERAL_MAX_BYTES ||
+                (fmt.elementType != Converter::ElementType::UnsignedChar && fmt.elementType != Converter::ElementType::Uint8) ||
+                GetStyleSpec(fmt.arrayStyle).usesStdArray)
+                return false;
+
+            Stats::ScopedPhase phase(stats.formatMs);
+            Trace::Scope trace("text scan", byteCount);
+            return TextScan::IsText(data, byteCount);
+        }
+
+        // The shortest "ep", "ep1", "ep2"... whose closing sequence does not occur in the text.
+        static std::string PickRawDelimiter(const uint8_t* data, size_t byteCount)
+        {
+            const std::string_view text(reinterpret_cast<const char*>(data), byteCount);
+            for (uint32_t n = 0u;; ++n)
+            {
+                const std::string delim = (n == 0u) ? std::string("ep") : "ep" + std::to_string(n);
+                if (text.find(")" + delim + "\"") == std::string_view::npos)
+                    return delim;
+            }
+        }
+
+        // Raw pieces carry printable ASCII, tabs and LFs unchanged. CRs and non-ASCII bytes go
+        // into ordinary literals as escapes: compilers fold CR LF in source to LF, and read
+        // non-ASCII source through the code page unless built with /utf-8. The array keeps its
+        // terminating NUL, so fileBytesSize is stated rather than taken from sizeof; with tail
+        // padding it is the padded size, as in dense output, and fileBytesOriginalSize the text's.
+        static void BuildTextAscii(
+            const uint8_t* data,
+            size_t byteCount,
+            const Converter::Format& fmt,
+            ChecksumPass& sums,
+            std::string& out)
+        {
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+
+            out.clear();
+            out.append(f.needsCstdint || sums.Active() ? "#include <cstdint>\r\n#include <cstddef>\r\n\r\n" : "#include <cstddef>\r\n\r\n");
+            AppendSectionPreamble(fmt, out);
+            AppendLayoutAttributes(f, fmt, out);
+
+            // Padding rounds up the text plus its NUL.
+            const bool padded = fmt.tailPadding != Converter::TailPadding::None;
+            const size_t unit = TailPaddingUnit(fmt.tailPadding, 1u);
+            const size_t elementCount = padded ? ((byteCount + unit) / unit) * unit : byteCount;
+
+            out.append(s.prefixNonArray);
+            out.append(f.typeName);
+            out.append(" fileBytes[");
+            if (padded)
+                out.append(std::to_string(elementCount));
+            out.append("] =");
+
+            const std::string delim = PickRawDelimiter(data, byteCount);
+            bool afterRaw = false;
+            size_t i = 0u;
+            while (i < byteCount)
+            {
+                const uint8_t b = data[i];
+                if (b == '\r')
+                {
+                    // Line endings stay on the line of the raw piece they end.
+                    const bool crlf = (i + 1u < byteCount && data[i + 1u] == '\n');
+                    out.append(afterRaw ? " " : "\r\n    ");
+                    out.append(crlf ? "\"\\r\\n\"" : "\"\\r\"");
+                    i += crlf ? 2u : 1u;
+                    afterRaw = false;
+                }
+                else if (b >= 0x80u)
+                {
+                    const size_t end = std::min(byteCount, i + TEXT_ESCAPE_BYTES);
+                    out.append("\r\n    \"");
+                    for (; i < end && data[i] >= 0x80u; ++i)
+                    {
+                        out.append("\\x");
+                        out.push_back(HEXA[data[i] >> 4u]);
+                        out.push_back(HEXA[data[i] & 0x0Fu]);
+                    }
+                    out.push_back('"');
+                    afterRaw = false;
+                }
+                else
+                {
+                    size_t end = i;
+                    const size_t limit = std::min(byteCount, i + TEXT_PIECE_BYTES);
+                    while (end < limit && data[end] != '\r' && data[end] < 0x80u)
+                        ++end;
+
+                    out.append("\r\n    R\"");
+                    out.append(delim);
+                    out.push_back('(');
+                    out.append(reinterpret_cast<const char*>(data + i), end - i);
+                    out.push_back(')');
+                    out.append(delim);
+                    out.push_back('"');
+                    i = end;
+                    afterRaw = true;
+                }
+            }
+            out.append(";\r\n");
+
+            if (sums.Active())
+                sums.Update(data, byteCount);
+
+            out.append(s.sizeQualifier);
+            out.append("size_t fileBytesSize = ");
+            out.append(padded ? "sizeof(fileBytes)" : std::to_string(byteCount));
+            out.append(";\r\n");
+
+            AppendCompanions(f, s, elementCount, byteCount, sums, out);
+        }
+
+        using FlushFn = std::function<bool(std::string& buf, size_t processed)>;
+
+        // Sparse layout: one array per non-zero segment, the segment table and the fill routine.
+        // Appends to buf; in large mode flush drains buf to the file whenever it passes
+        // FlushBytes(), in small mode it is empty and buf receives the whole text.
+        static bool EmitSparse(
+            const uint8_t* data,
+            size_t byteCount,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            ChecksumPass& sums,
+            ConversionStats& stats,
+            std::string& buf,
+            const FlushFn& flush,
+            std::wstring& err)
+        {
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+            const Kernel k = SelectKernel(f, fmt.byteOrder);
+            const size_t elementCount = ComputeElementCount(byteCount, f.elemSize, fmt.tailPadding);
+
+            std::vector<ZeroScan::Segment> segments;
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+                Trace::Scope trace("zero scan", byteCount);
+                segments = ZeroScan::FindSegments(data, byteCount, SPARSE_MIN_GAP_BYTES);
+            }
+
+            AppendIncludes(f, s, fmt, buf);
+            AppendSectionPreamble(fmt, buf);
+            AppendSparsePreamble(f, buf);
+
+            const size_t lineText = LINE_PREFIX_LEN + k.valuesPerLine * (k.tokenLen + SEPARATOR_LEN);
+            const size_t chunkElems = std::max<size_t>(1u, FlushBytes() / lineText) * k.valuesPerLine;
+            ChecksumPass* const fused = sums.Active() ? &sums : nullptr;
+
+            // Checksums run in input order, so each zero gap is fed before the segment after it.
+            size_t summed = 0u;
+            for (size_t i = 0u; i < segments.size(); ++i)
+            {
+                const uint8_t* segData = data + segments[i].begin;
+                const size_t segBytes = segments[i].end - segments[i].begin;
+                const size_t segElems = (segBytes + f.elemSize - 1u) / f.elemSize;
+
+                if (fused)
+                    fused->Update(data + summed, segments[i].begin - summed);
+                summed = segments[i].end;
+
+                AppendSegmentHeader(f, s, fmt, i, buf);
+
+                for (size_t first = 0u; first < segElems; first += chunkElems)
+                {
+                    if (cancel.IsSet())
+                    {
+                        err = L"Conversion cancelled.";
+                        return false;
+                    }
+
+                    const size_t end = std::min(segElems, first + chunkElems);
+                    const size_t textSize = RangeTextSize(k, segElems, first, end);
+                    const size_t at = buf.size();
+                    buf.resize(at + textSize);
+                    {
+                        Stats::ScopedPhase phase(stats.formatMs);
+                        Trace::Scope trace("format", textSize);
+                        FormatAndSum(k, segData, segBytes, segElems, f.elemSize, first, end, fused, &buf[at]);
+                    }
+
+                    if (flush && buf.size() >= FlushBytes() && !flush(buf, segments[i].begin + end * f.elemSize))
+                        return false;
+                }
+
+                buf.append("\r\n};\r\n");
+            }
+
+            if (fused)
+                fused->Update(data + summed, byteCount - summed);
+
+            AppendSparseFooter(f, s, elementCount, byteCount, segments, sums, buf);
+            return true;
+        }
+
+        struct ProgressTarget
+        {
+            HWND hwnd = nullptr;
+            std::atomic<int>* pct = nullptr;
+
+            void Report(int value) const
+            {
+                if (pct)
+                    pct->store(value, std::memory_order_relaxed);
+                if (hwnd)
+                    PostMessageW(hwnd, AppMessages::WM_APP_PROGRESS, static_cast<WPARAM>(value), 0);
+            }
+        };
+
+        // The bytes a job embeds: a view of the input file, or with Job::transforms, what the
+        // pipeline made of it. The writers only ever see data and size.
+        struct JobInput
+        {
+            FileIo::MappedInput own;
+            std::vector<uint8_t> transformed;
+            const uint8_t* data = nullptr;
+            size_t size = 0u;
+            bool mapped = true;
+
+            // Read-ahead is for file views; transformed bytes are already in memory.
+            size_t ReadAheadWindow(size_t window) const noexcept { return mapped ? window : 0u; }
+        };
+
+        // C++ has no zero-length arrays, so there is no header to write for zero bytes.
+        static bool RejectEmpty(const JobInput& in, std::wstring& err)
+        {
+            if (in.size != 0u)
+                return true;
+
+            err = L"The input is empty; there is nothing to embed.";
+            return false;
+        }
+
+        static bool OpenJobInput(
+            const Converter::Job& job,
+            const Threading::CancelToken& cancel,
+            ConversionStats& stats,
+            JobInput& in,
+            std::wstring& err)
+        {
+            const FileIo::MappedInput* view = job.input.get();
+            if (view == nullptr)
+            {
+                Stats::ScopedPhase phase(stats.openMs);
+                Trace::Scope trace("map input");
+                if (!FileIo::MapInputFile(job.inPath, in.own, err))
+                    return false;
+                view = &in.own;
+            }
+
+            in.data = view->data();
+            in.size = view->size;
+            if (job.transforms.empty())
+                return RejectEmpty(in, err);
+
+            {
+                Stats::ScopedPhase phase(stats.transformMs);
+                Trace::Scope trace("transform", view->size);
+                Transform::Pipeline pipeline(job.transforms);
+                if (!pipeline.Run(view->data(), view->size, cancel, in.transformed))
+                {
+                    err = L"Conversion cancelled.";
+                    return false;
+                }
+            }
+
+            stats.sourceBytes = view->size;
+            in.data = in.transformed.data();
+            in.size = in.transformed.size();
+            in.mapped = false;
+            in.own = FileIo::MappedInput{};
+            return RejectEmpty(in, err);
+        }
+
+        static bool ConvertSmallToMemory(
+            const JobInput& input,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            ConversionStats& stats,
+            Text::Rope& out,
+            std::wstring& err)
+        {
+            err.clear();
+            out.Clear();
+
+            const size_t fileSize = input.size;
+            const uint8_t* data = input.data;
+
+            // Small inputs are read in one pass, so the whole view is requested up front.
+            const Tuning::Profile& tuning = Tuning::Active();
+            const FileIo::ReadAhead ahead(data, fileSize, input.ReadAheadWindow(tuning.readAheadBytes ? fileSize : 0u), false, stats.readAheadBytes);
+
+            std::string ascii;
+            if (IsTextOutput(fmt, data, fileSize, stats))
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+                Trace::Scope trace("format", fileSize);
+                ChecksumPass sums(fmt.checksum);
+                BuildTextAscii(data, fileSize, fmt, sums, ascii);
+            }
+            else if (fmt.zeroElision == Converter::ZeroElision::Sparse)
+            {
+                ChecksumPass sums(fmt.checksum);
+                if (!EmitSparse(data, fileSize, fmt, cancel, sums, stats, ascii, nullptr, err))
+                    return false;
+            }
+            else
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+                Trace::Scope trace("format", fileSize);
+                BuildArrayRope(data, fileSize, fmt, cancel, out);
+            }
+
+            if (cancel.IsSet())
+            {
+                out.Clear();
+                err = L"Conversion cancelled.";
+                return false;
+            }
+
+            // Text and sparse outputs are built whole and widened in one go.
+            if (!ascii.empty())
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+                Trace::Scope trace("widen", ascii.size());
+                out.AppendAscii(ascii);
+            }
+
+            stats.inputBytes = fileSize;
+            stats.outputBytes = out.Size();
+            return true;
+        }
+
+        static void ReportProgress(const ProgressTarget& progress, DWORD& lastTick, size_t processed, size_t total)
+        {
+            const DWORD now = GetTickCount();
+            if ((now - lastTick) < Tuning::Active().progressTickMs)
+                return;
+
+            lastTick = now;
+            progress.Report((total == 0u) ? 100 : static_cast<int>((std::min(processed, total) * 100u) / total));
+        }
+
+        static bool TimedWrite(HANDLE h, const void* data, size_t size, ConversionStats& stats, std::wstring& err)
+        {
+            Stats::ScopedPhase phase(stats.writeMs);
+            Trace::Scope trace("write", size);
+            return FileIo::WriteAll(h, data, static_cast<DWORD>(size), err);
+        }
+
+        static bool OpenOutput(const std::wstring& outPath, DWORD disposition, ConversionStats& stats, FileIo::Handle& hOut)
+        {
+            Stats::ScopedPhase phase(stats.openMs);
+            Trace::Scope trace("open output");
+            hOut = FileIo::Handle(CreateFileW(
+                outPath.c_str(),
+                GENERIC_WRITE,
+                0,
+                nullptr,
+                disposition,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+            return hOut.valid();
+        }
+
+        static void CloseOutput(FileIo::Handle& hOut, ConversionStats& stats)
+        {
+            Stats::ScopedPhase phase(stats.closeMs);
+            Trace::Scope trace("close output");
+            hOut = FileIo::Handle{};
+        }
+
+        // sums may already hold the whole input (incremental mode hashes it first); otherwise it is
+        // fed during formatting.
+        static bool WriteLargeOutput(
+            const std::wstring& outPath,
+            const uint8_t* data,
+            size_t fileSize,
+            FileIo::ReadAhead& ahead,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            ChecksumPass& sums,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            FileIo::Handle hOut;
+            if (!OpenOutput(outPath, CREATE_ALWAYS, stats, hOut))
+            {
+                err = L"Failed to create output file.";
+                return false;
+            }
+
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+
+            const Kernel k = SelectKernel(f, fmt.byteOrder);
+            const size_t elementCount = ComputeElementCount(fileSize, f.elemSize, fmt.tailPadding);
+            const DenseBody body = GetDenseBody(f, fmt, data, fileSize, elementCount);
+
+            const size_t lineText = LINE_PREFIX_LEN + k.valuesPerLine * (k.tokenLen + SEPARATOR_LEN);
+            const size_t chunkElems = std::max<size_t>(1u, FlushBytes() / lineText) * k.valuesPerLine;
+
+            std::string buf;
+            buf.reserve(FlushBytes());
+
+            AppendIncludes(f, s, fmt, buf);
+            AppendSectionPreamble(fmt, buf);
+            AppendHeader(f, s, fmt, elementCount, buf);
+            if (!TimedWrite(hOut, buf.data(), buf.size(), stats, err))
+                return false;
+
+            stats.inputBytes = fileSize;
+            stats.outputBytes = buf.size();
+
+            buf.resize(RangeTextSize(k, body.elements, 0u, std::min(chunkElems, body.elements)));
+
+            ChecksumPass* const fused = (sums.Active() && sums.Bytes() != fileSize) ? &sums : nullptr;
+            DWORD lastTick = GetTickCount();
+
+            for (size_t first = 0u; first < body.elements; first += chunkElems)
+            {
+                if (cancel.IsSet())
+                {
+                    err = L"Conversion cancelled.";
+                    return false;
+                }
+
+                const size_t end = std::min(body.elements, first + chunkElems);
+                const size_t textSize = RangeTextSize(k, body.elements, first, end);
+                ahead.Advance(first * f.elemSize);
+
+                {
+                    Stats::ScopedPhase phase(stats.formatMs);
+                    Trace::Scope trace("format", textSize);
+                    FormatAndSum(k, data, body.bytes, body.elements, f.elemSize, first, end, fused, &buf[0]);
+                }
+                Trace::SamplePageFaults();
+
+                if (!TimedWrite(hOut, buf.data(), textSize, stats, err))
+                    return false;
+
+                stats.outputBytes += textSize;
+                ReportProgress(progress, lastTick, end * f.elemSize, fileSize);
+            }
+
+            if (fused)
+                fused->Update(data + body.bytes, fileSize - body.bytes);
+
+            buf.clear();
+            AppendFooter(f, s, elementCount, fileSize, sums, buf);
+            if (!TimedWrite(hOut, buf.data(), buf.size(), stats, err))
+                return false;
+
+            stats.outputBytes += buf.size();
+            CloseOutput(hOut, stats);
+            progress.Report(100);
+            return true;
+        }
+
+        // Input bytes per chunk a formatter thread takes at a time in mapped output mode.
+        static constexpr size_t MAPPED_CHUNK_BYTES = 4u * 1024u * 1024u;
+
+        // Formatter threads per mapped-output job: the host's threads shared among the jobs that
+        // can run at once.
+        static size_t MappedFormatThreads()
+        {
+            const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+            return std::max<size_t>(1u, hw / Tuning::WorkerThreads(Tuning::Active()));
+        }
+
+        // The output size is known exactly up front (the footer's checksum literals have a fixed
+        // width), so the file is created at its final size and mapped writable. The worker and
+        // its helper threads take line-aligned chunks and format them straight into the view, so
+        // no text goes through a buffer or a WriteFile call. The flush only starts write-back.
+        static bool WriteMappedOutput(
+            const std::wstring& outPath,
+            const uint8_t* data,
+            size_t fileSize,
+            FileIo::ReadAhead& ahead,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            ChecksumPass& sums,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+
+            const Kernel k = SelectKernel(f, fmt.byteOrder);
+            const size_t elementCount = ComputeElementCount(fileSize, f.elemSize, fmt.tailPadding);
+            const DenseBody body = GetDenseBody(f, fmt, data, fileSize, elementCount);
+
+            std::string head;
+            AppendIncludes(f, s, fmt, head);
+            AppendSectionPreamble(fmt, head);
+            AppendHeader(f, s, fmt, elementCount, head);
+
+            std::string foot;
+            AppendFooter(f, s, elementCount, fileSize, sums, foot);
+
+            const size_t bodySize = RangeTextSize(k, body.elements, 0u, body.elements);
+            const uint64_t total = static_cast<uint64_t>(head.size()) + bodySize + foot.size();
+
+            FileIo::MappedOutput out;
+            {
+                Stats::ScopedPhase phase(stats.openMs);
+                Trace::Scope trace("open output");
+                if (!FileIo::MapOutputFile(outPath, total, out, err))
+                    return false;
+            }
+
+            stats.inputBytes = fileSize;
+
+            char* const text = reinterpret_cast<char*>(out.data());
+            std::memcpy(text, head.data(), head.size());
+            char* const bodyText = text + head.size();
+
+            const size_t chunkElems = std::max<size_t>(1u, MAPPED_CHUNK_BYTES / (f.elemSize * k.valuesPerLine)) * k.valuesPerLine;
+            const size_t chunkCount = (body.elements + chunkElems - 1u) / chunkElems;
+
+            std::atomic<size_t> nextChunk{ 0 };
+            std::atomic<size_t> doneBytes{ 0 };
+
+            // Returns false when there is nothing left; the worker calls it one chunk at a time.
+            const auto formatNext = [&]() {
+                const size_t c = nextChunk.fetch_add(1u, std::memory_order_relaxed);
+                if (c >= chunkCount || cancel.IsSet())
+                    return false;
+
+                const size_t first = c * chunkElems;
+                const size_t end = std::min(body.elements, first + chunkElems);
+                Trace::Scope trace("format", RangeTextSize(k, body.elements, first, end));
+                k.formatRange(data, body.bytes, body.elements, first, end, bodyText + SlotOffset(k, first));
+                doneBytes.fetch_add((end - first) * f.elemSize, std::memory_order_relaxed);
+                return true;
+            };
+
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+
+                std::vector<std::thread> helpers;
+                const size_t threads = std::min(MappedFormatThreads(), chunkCount);
+                for (size_t i = 1u; i < threads; ++i)
+                {
+                    helpers.emplace_back([&formatNext, i] {
+                        if (Trace::Enabled())
+                            Trace::SetThreadName("format helper " + std::to_string(i));
+                        while (formatNext())
+                        {
+                        }
+                    });
+                }
+
+                // The checksums need the input in order, so the worker feeds them while the
+                // helpers format, then joins the formatting. Its position drives the read-ahead.
+                if (sums.Active() && sums.Bytes() != fileSize)
+                {
+                    Trace::Scope trace("checksum", fileSize);
+                    for (size_t at = 0u; at < fileSize && !cancel.IsSet(); at += MAPPED_CHUNK_BYTES)
+                    {
+                        ahead.Advance(at);
+                        sums.Update(data + at, std::min(MAPPED_CHUNK_BYTES, fileSize - at));
+                    }
+                }
+
+                DWORD lastTick = GetTickCount();
+                for (;;)
+                {
+                    ahead.Advance(std::min(nextChunk.load(std::memory_order_relaxed) * chunkElems, body.elements) * f.elemSize);
+                    if (!formatNext())
+                        break;
+                    ReportProgress(progress, lastTick, doneBytes.load(std::memory_order_relaxed), fileSize);
+                }
+
+                for (std::thread& t : helpers)
+                    t.join();
+            }
+            Trace::SamplePageFaults();
+
+            if (cancel.IsSet())
+            {
+                err = L"Conversion cancelled.";
+                return false;
+            }
+
+            foot.clear();
+            AppendFooter(f, s, elementCount, fileSize, sums, foot);
+            std::memcpy(bodyText + bodySize, foot.data(), foot.size());
+
+            {
+                Stats::ScopedPhase phase(stats.writeMs);
+                Trace::Scope trace("flush view", out.size);
+                if (!FlushViewOfFile(out.view.get(), 0u))
+                {
+                    err = L"Failed to flush the output mapping.";
+                    return false;
+                }
+            }
+
+            stats.outputBytes = out.size;
+            {
+                Stats::ScopedPhase phase(stats.closeMs);
+                Trace::Scope trace("close output");
+                out = FileIo::MappedOutput{};
+            }
+            progress.Report(100);
+            return true;
+        }
+
+        static bool WriteSparseOutput(
+            const std::wstring& outPath,
+            const uint8_t* data,
+            size_t fileSize,
+            FileIo::ReadAhead& ahead,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            ChecksumPass& sums,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            FileIo::Handle hOut;
+            if (!OpenOutput(outPath, CREATE_ALWAYS, stats, hOut))
+            {
+                err = L"Failed to create output file.";
+                return false;
+            }
+
+            stats.inputBytes = fileSize;
+
+            std::string buf;
+            buf.reserve(FlushBytes() * 2u);
+
+            DWORD lastTick = GetTickCount();
+            const FlushFn flush = [&](std::string& pending, size_t processed) {
+                Trace::SamplePageFaults();
+                if (!TimedWrite(hOut, pending.data(), pending.size(), stats, err))
+                    return false;
+
+                stats.outputBytes += pending.size();
+                pending.clear();
+                ahead.Advance(processed);
+                ReportProgress(progress, lastTick, processed, fileSize);
+                return true;
+            };
+
+            if (!EmitSparse(data, fileSize, fmt, cancel, sums, stats, buf, flush, err) || !flush(buf, fileSize))
+                return false;
+
+            CloseOutput(hOut, stats);
+            progress.Report(100);
+            return true;
+        }
+
+        // Text outputs are at most a few hundred KiB, so they are built in memory and written once.
+        static bool WriteTextOutput(
+            const std::wstring& outPath,
+            const uint8_t* data,
+            size_t fileSize,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            ChecksumPass& sums,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            std::string text;
+            {
+                Stats::ScopedPhase phase(stats.formatMs);
+                Trace::Scope trace("format", fileSize);
+                BuildTextAscii(data, fileSize, fmt, sums, text);
+            }
+
+            FileIo::Handle hOut;
+            if (!OpenOutput(outPath, CREATE_ALWAYS, stats, hOut))
+            {
+                err = L"Failed to create output file.";
+                return false;
+            }
+
+            if (!TimedWrite(hOut, text.data(), text.size(), stats, err))
+                return false;
+
+            CloseOutput(hOut, stats);
+            stats.inputBytes = fileSize;
+            stats.outputBytes = text.size();
+            progress.Report(100);
+            return true;
+        }
+
+        // Rewrites the body lines of every changed block in place. Block boundaries are multiples
+        // of 16 input bytes, so each block maps to whole output lines at offsets given by
+        // SlotOffset; the header cannot change because size and format are the same. The footer
+        // only changes through the checksums, which have a fixed width.
+        static bool PatchLargeOutput(
+            const std::wstring& outPath,
+            const uint8_t* data,
+            size_t fileSize,
+            const Incremental::BlockManifest& prev,
+            const Incremental::BlockManifest& next,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            const Threading::CancelToken& cancel,
+            const ChecksumPass& sums,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            FileIo::Handle hOut;
+            if (!OpenOutput(outPath, OPEN_EXISTING, stats, hOut))
+            {
+                err = L"Failed to open output file for patching.";
+                return false;
+            }
+
+            const FormatSpec f = GetFormatSpec(fmt.elementType);
+            const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+
+            const Kernel k = SelectKernel(f, fmt.byteOrder);
+            const size_t elementCount = ComputeElementCount(fileSize, f.elemSize, fmt.tailPadding);
+
+            std::string head;
+            AppendIncludes(f, s, fmt, head);
+            AppendSectionPreamble(fmt, head);
+            AppendHeader(f, s, fmt, elementCount, head);
+
+            const size_t blockSize = next.blockSize;
+            const size_t blockCount = next.blockHashes.size();
+            const size_t blocksPerWrite = std::max<size_t>(1u, FlushBytes() / (blockSize * 6u));
+
+            stats.inputBytes = fileSize;
+            stats.blocksTotal = blockCount;
+
+            std::string buf;
+            DWORD lastTick = GetTickCount();
+
+            for (size_t b = 0u; b < blockCount;)
+            {
+                if (next.blockHashes[b] == prev.blockHashes[b])
+                {
+                    ++b;
+                    continue;
+                }
+
+                if (cancel.IsSet())
+                {
+                    err = L"Conversion cancelled.";
+                    return false;
+                }
+
+                // Coalesce a run of adjacent changed blocks into one write.
+                size_t runEnd = b + 1u;
+                while (runEnd < blockCount && runEnd - b < blocksPerWrite &&
+                       next.blockHashes[runEnd] != prev.blockHashes[runEnd])
+                    ++runEnd;
+
+                const size_t first = (b * blockSize) / f.elemSize;
+                const size_t end = (runEnd == blockCount) ? elementCount : (runEnd * blockSize) / f.elemSize;
+                const size_t textSize = RangeTextSize(k, elementCount, first, end);
+
+                buf.resize(textSize);
+                {
+                    Stats::ScopedPhase phase(stats.formatMs);
+                    Trace::Scope trace("format", textSize);
+                    k.formatRange(data, fileSize, elementCount, first, end, &buf[0]);
+                }
+                Trace::SamplePageFaults();
+
+                LARGE_INTEGER offset{};
+                offset.QuadPart = static_cast<LONGLONG>(head.size() + SlotOffset(k, first));
+                if (!SetFilePointerEx(hOut, offset, nullptr, FILE_BEGIN))
+                {
+                    err = L"Failed to seek in output file.";
+                    return false;
+                }
+
+                if (!TimedWrite(hOut, buf.data(), textSize, stats, err))
+                    return false;
+
+                stats.outputBytes += textSize;
+                stats.blocksRewritten += runEnd - b;
+                b = runEnd;
+
+                ReportProgress(progress, lastTick, b * blockSize, fileSize);
+            }
+
+            if (sums.Active() && stats.blocksRewritten != 0u)
+            {
+                buf.clear();
+                AppendFooter(f, s, elementCount, fileSize, sums, buf);
+
+                LARGE_INTEGER offset{};
+                offset.QuadPart = static_cast<LONGLONG>(head.size() + RangeTextSize(k, elementCount, 0u, elementCount));
+                if (!SetFilePointerEx(hOut, offset, nullptr, FILE_BEGIN))
+                {
+                    err = L"Failed to seek in output file.";
+                    return false;
+                }
+
+                if (!TimedWrite(hOut, buf.data(), buf.size(), stats, err))
+                    return false;
+
+                stats.outputBytes += buf.size();
+            }
+
+            CloseOutput(hOut, stats);
+            progress.Report(100);
+            return true;
+        }
+
+        static bool ConvertLargeToFile(
+            const JobInput& input,
+            const std::wstring& outPath,
+            const ProgressTarget& progress,
+            const Converter::Format& fmt,
+            bool incremental,
+            bool mappedOutput,
+            const Threading::CancelToken& cancel,
+            ConversionStats& stats,
+            std::wstring& err)
+        {
+            err.clear();
+
+            ChecksumPass sums(fmt.checksum);
+
+            const Tuning::Profile& tuning = Tuning::Active();
+            FileIo::ReadAhead ahead(input.data, input.size, input.ReadAheadWindow(tuning.readAheadBytes), tuning.prefetchThread, stats.readAheadBytes);
+
+            // Block manifests describe the array layout; a text output is always rewritten and
+            // leaves none behind.
+            if (IsTextOutput(fmt, input.data, input.size, stats))
+            {
+                if (incremental)
+                    DeleteFileW(Incremental::ManifestPath(outPath).c_str());
+                return WriteTextOutput(outPath, input.data, input.size, progress, fmt, sums, stats, err);
+            }
+
+            if (fmt.zeroElision == Converter::ZeroElision::Sparse)
+                return WriteSparseOutput(outPath, input.data, input.size, ahead, progress, fmt, cancel, sums, stats, err);
+
+            const auto writeFull = [&]() {
+                return mappedOutput
+                    ? WriteMappedOutput(outPath, input.data, input.size, ahead, progress, fmt, cancel, sums, stats, err)
+                    : WriteLargeOutput(outPath, input.data, input.size, ahead, progress, fmt, cancel, sums, stats, err);
+            };
+
+            // Trimming moves the end of the body with the content, so those outputs are always
+            // rewritten in full.
+            if (!incremental || fmt.zeroElision != Converter::ZeroElision::None)
+                return writeFull();
+
+            const std::wstring manifestPath = Incremental::ManifestPath(outPath);
+
+            Incremental::BlockManifest next;
+            next.formatHash = Incremental::HashFormat(fmt);
+            {
+                Stats::ScopedPhase phase(stats.hashMs);
+                Trace::Scope trace("hash blocks", input.size);
+                // The block hashes already read every byte, so the checksums ride along and the
+                // read-ahead follows this pass; the rewrite after it finds the pages resident.
+                const uint8_t* base = input.data;
+                const Incremental::BlockVisitor visit = [&](const uint8_t* p, size_t n) {
+                    ahead.Advance(static_cast<size_t>(p - base) + n);
+                    if (sums.Active())
+                        sums.Update(p, n);
+                };
+                Incremental::HashBlocks(input.data, input.size, next, visit);
+            }
+
+            Incremental::BlockManifest prev;
+            const bool patch = Incremental::LoadManifest(manifestPath, prev) && Incremental::CanPatch(prev, next, outPath);
 
+            // Drop the manifest while the output is being modified; an interrupted run then falls
+            // back to a full rewrite next time instead of trusting a half-patched file.
+            DeleteFileW(manifestPath.c_str());
+
+            const bool ok = patch
+                ? PatchLargeOutput(outPath, input.data, input.size, prev, next, progress, fmt, cancel, sums, stats, err)
+                : writeFull();
+            if (!ok)
+                return false;
+
+            if (!patch)
+            {
+                stats.blocksTotal = next.blockHashes.size();
+                stats.blocksRewritten = stats.blocksTotal;
+            }
+
+            // A missing manifest only costs a full rewrite on the next run.
+            std::wstring manifestErr;
+            if (Incremental::RecordOutput(outPath, next))
+                Incremental::SaveManifest(manifestPath, next, manifestErr);
+            return true;
+        }
+
+        // Small mode keeps the text in memory while the memory budget has room for it, and
+        // otherwise writes the same header to a spill file through the mapped writer.
+        static bool ConvertSmallOrSpill(
+            const Converter::Job& job,
+            const ProgressTarget& progress,
+            const Threading::CancelToken& cancel,
+            ConversionResult& r,
+            std::wstring& err)
+        {
+            // An unreadable input is reported by the in-memory path like before.
+            JobInput input;
+            if (!ValidateLayout(job.format, err) || !OpenJobInput(job, cancel, r.stats, input, err))
+                return false;
+
+            Memory::Reservation memory;
+            if (Memory::TryReserve(PredictOutputBytes(job.format, input.size), memory))
+                return ConvertSmallToMemory(input, job.format, cancel, r.stats, r.output, err);
+
+            Trace::Scope trace("spill");
+            if (!Memory::CreateSpillFile(r.spillPath, err))
+                return false;
+            if (ConvertLargeToFile(input, r.spillPath, progress, job.format, false, true, cancel, r.stats, err))
+                return true;
+
+            DeleteFileW(r.spillPath.c_str());
+            r.spillPath.clear();
+            return false;
+        }
+
+        // Input bytes a fan-out sink formats per step; a multiple of 16, so every step ends on a
+        // line boundary whatever the element width.
+        static constexpr size_t FANOUT_STEP_BYTES = 1024u * 1024u;
+        // How far the fastest dense sink may run ahead of the slowest. Within that window the slow
+        // ones find the input still resident where the fastest one faulted it in.
+        static constexpr size_t FANOUT_LAG_STEPS = 4u;
+
+        // One output of a fan-out job. Dense outputs run on threads of their own, so every target
+        // keeps its own counters; they are summed into the job's stats at the end.
+        struct FanOutTarget
+        {
+            FanOutTarget(const Converter::Format& format, const std::wstring& path)
+                : fmt(format), outPath(path), sums(format.checksum)
+            {
+            }
+
+            std::wstring Name() const { return outPath.empty() ? std::wstring(L"in-memory output") : outPath; }
+
+            Converter::Format fmt;
+            std::wstring outPath; // empty: the text stays in memory
+            bool dense = true;
+            ChecksumPass sums;
+            ConversionStats stats{};
+            // The pending step's text; for in-memory text and sparse outputs, the whole of it.
+            std::string text;
+            // Where an in-memory output is widened to as it is formatted.
+            Text::Rope rope;
+            FileIo::Handle hOut;
+            bool created = false;
+            // An in-memory output over the memory budget, redirected to a temp file.
+            bool spilled = false;
+            std::wstring err;
+        };
+
+        // Keeps the dense sinks of a fan-out pass within FANOUT_LAG_STEPS steps of each other.
+        class StepGate final
+        {
+        public:
+            explicit StepGate(size_t sinks) : m_done(sinks, 0u) {}
+
+            // Blocks until the slowest sink is close enough; false once the pass was abandoned.
+            bool Enter(size_t step)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&] {
+                    return m_abandoned || *std::min_element(m_done.begin(), m_done.end()) + FANOUT_LAG_STEPS > step;
+                });
+                return !m_abandoned;
+            }
+
+            void Done(size_t sink)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    ++m_done[sink];
+                }
+                m_cv.notify_all();
+            }
+
+            void Abandon()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_abandoned = true;
+                }
+                m_cv.notify_all();
+            }
+
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_cv;
+            std::vector<size_t> m_done;
+            bool m_abandoned = false;
+        };
+
+        using StepFn = std::function<void(size_t offset)>;
+
+        // Streams one dense output a step at a time: each step's text is written to the file right
+        // away, or for an in-memory output, widened onto its rope. onStep sees the input offset of each
+        // step before it is formatted.
+        static bool RunDenseTarget(
+            FanOutTarget& t,
+            size_t index,
+            const uint8_t* data,
+            size_t fileSize,
+            size_t steps,
+            StepGate& gate,
+            const StepFn& onStep,
+            const Threading::CancelToken& cancel)
+        {
+            const FormatSpec f = GetFormatSpec(t.fmt.elementType);
+            const StyleSpec s = GetStyleSpec(t.fmt.arrayStyle);
+            const Kernel k = SelectKernel(f, t.fmt.byteOrder);
+            const size_t elementCount = ComputeElementCount(fileSize, f.elemSize, t.fmt.tailPadding);
+            const DenseBody body = GetDenseBody(f, t.fmt, data, fileSize, elementCount);
+            const bool toFile = !t.outPath.empty();
+
+            const auto flush = [&]() {
+                if (toFile)
+                {
+                    if (!TimedWrite(t.hOut, t.text.data(), t.text.size(), t.stats, t.err))
+                        return false;
+                }
+                else
+                {
+                    Stats::ScopedPhase phase(t.stats.formatMs);
+                    t.rope.AppendAscii(t.text);
+                }
+                t.stats.outputBytes += t.text.size();
+                t.text.clear();
+                return true;
+            };
+
+            AppendIncludes(f, s, t.fmt, t.text);
+            AppendSectionPreamble(t.fmt, t.text);
+            AppendHeader(f, s, t.fmt, elementCount, t.text);
+
+            if (toFile)
+            {
+                if (!OpenOutput(t.outPath, CREATE_ALWAYS, t.stats, t.hOut))
+                {
+                    t.err = L"Failed to create output file: " + t.outPath;
+                    return false;
+                }
+                t.created = true;
+            }
+            if (!flush())
+                return false;
+
+            ChecksumPass* const fused = t.sums.Active() ? &t.sums : nullptr;
+            for (size_t step = 0u; step < steps; ++step)
+            {
+                if (!gate.Enter(step))
+                    return false;
+                if (cancel.IsSet())
+                {
+                    t.err = L"Conversion cancelled.";
+                    return false;
+                }
+
+                const size_t offset = step * FANOUT_STEP_BYTES;
+                const size_t first = std::min(body.elements, offset / f.elemSize);
+                const size_t end = (step + 1u == steps)
+                    ? body.elements
+                    : std::min(body.elements, (offset + FANOUT_STEP_BYTES) / f.elemSize);
+
+                if (onStep)
+                    onStep(offset);
+
+                if (end > first)
+                {
+                    const size_t textSize = RangeTextSize(k, body.elements, first, end);
+                    const size_t at = t.text.size();
+                    t.text.resize(at + textSize);
+
+                    Stats::ScopedPhase phase(t.stats.formatMs);
+                    Trace::Scope trace("format", textSize);
+                    FormatAndSum(k, data, body.bytes, body.elements, f.elemSize, first, end, fused, &t.text[at]);
+                }
+                Trace::SamplePageFaults();
+
+                if (!flush())
+                    return false;
+                gate.Done(index);
+            }
+
+            if (fused)
+                fused->Update(data + body.bytes, fileSize - body.bytes);
+
+            AppendFooter(f, s, elementCount, fileSize, t.sums, t.text);
+            if (!flush())
+                return false;
+            if (toFile)
+                CloseOutput(t.hOut, t.stats);
+            t.text.shrink_to_fit();
+            return true;
+        }
+
+        // Text and sparse outputs need the whole input before they can emit anything, so they are
+        // built after the dense pass, from the view it left resident.
+        static bool RunWholeTarget(
+            FanOutTarget& t,
+            const uint8_t* data,
+            size_t fileSize,
+            FileIo::ReadAhead& ahead,
+            const Threading::CancelToken& cancel)
+        {
+            const ProgressTarget silent{};
+            const bool sparse = (t.fmt.zeroElision == Converter::ZeroElision::Sparse);
+
+            if (!t.outPath.empty())
+            {
+                t.created = true;
+                return sparse
+                    ? WriteSparseOutput(t.outPath, data, fileSize, ahead, silent, t.fmt, cancel, t.sums, t.stats, t.err)
+                    : WriteTextOutput(t.outPath, data, fileSize, silent, t.fmt, t.sums, t.stats, t.err);
+            }
+
+            if (sparse)
+            {
+                if (!EmitSparse(data, fileSize, t.fmt, cancel, t.sums, t.stats, t.text, nullptr, t.err))
+                    return false;
+            }
+            else
+            {
+                Stats::ScopedPhase phase(t.stats.formatMs);
+                Trace::Scope trace("format", fileSize);
+                BuildTextAscii(data, fileSize, t.fmt, t.sums, t.text);
+            }
+
+            {
+                Stats::ScopedPhase phase(t.stats.formatMs);
+                Trace::Scope trace("widen", t.text.size());
+                t.rope.AppendAscii(t.text);
+            }
+            t.stats.outputBytes = t.text.size();
+            t.text = std::string{};
+            return true;
+        }
+
+        // The job's own output comes first, then its sinks. The input is mapped once; every dense
+        // output runs its own formatter thread (the worker takes the first one and drives the
+        // read-ahead and progress) and the threads stay within a few steps of each other, so each
+        // page is faulted in once however many outputs there are. Phase times are summed over the
+        // outputs and can exceed the elapsed time.
+        static bool ConvertFanOut(
+            const Converter::Job& job,
+            const ProgressTarget& progress,
+            const Threading::CancelToken& cancel,
+            ConversionResult& r,
+            std::wstring& err)
+        {
+            err.clear();
+            ConversionStats& stats = r.stats;
+            r.sinkOutputs.resize(job.sinks.size());
+            r.sinkSpillPaths.assign(job.sinks.size(), std::wstring{});
+
+            std::deque<FanOutTarget> targets;
+            targets.emplace_back(job.format, job.largeMode ? job.outPath : std::wstring{});
+            for (const Converter::Sink& sink : job.sinks)
+                targets.emplace_back(sink.format, sink.outPath);
+
+            for (size_t i = 0u; i < targets.size(); ++i)
+            {
+                const FanOutTarget& t = targets[i];
+                if (!ValidateLayout(t.fmt, err))
+                {
+                    err = t.Name() + L": " + err;
+                    return false;
+                }
+
+                // Two targets writing one file would interleave their text.
+                for (size_t j = 0u; j < i && !t.outPath.empty(); ++j)
+                {
+                    if (CompareStringOrdinal(t.outPath.c_str(), -1, targets[j].outPath.c_str(), -1, TRUE) == CSTR_EQUAL)
+                    {
+                        err = L"Output listed twice: " + t.outPath;
+                        return false;
+                    }
+                }
+            }
+
+            JobInput input;
+            if (!OpenJobInput(job, cancel, stats, input, err))
+                return false;
+
+            const uint8_t* data = input.data;
+            const size_t fileSize = input.size;
+
+            // In-memory outputs the budget cannot hold become file outputs in the temp directory.
+            std::vector<Memory::Reservation> memory;
+            for (FanOutTarget& t : targets)
+            {
+                if (!t.outPath.empty())
+                    continue;
+
+                Memory::Reservation reservation;
+                if (Memory::TryReserve(PredictOutputBytes(t.fmt, fileSize), reservation))
+                {
+                    memory.push_back(std::move(reservation));
+                    continue;
+                }
+                if (!Memory::CreateSpillFile(t.outPath, err))
+                {
+                    for (const FanOutTarget& spilled : targets)
+                        if (spilled.spilled)
+                            DeleteFileW(spilled.outPath.c_str());
+                    return false;
+                }
+                t.spilled = true;
+            }
+
+            const Tuning::Profile& tuning = Tuning::Active();
+            FileIo::ReadAhead ahead(data, fileSize, input.ReadAheadWindow(tuning.readAheadBytes), tuning.prefetchThread, stats.readAheadBytes);
+
+            std::vector<FanOutTarget*> dense;
+            for (FanOutTarget& t : targets)
+            {
+                t.dense = (t.fmt.zeroElision != Converter::ZeroElision::Sparse) && !IsTextOutput(t.fmt, data, fileSize, t.stats);
+                if (t.dense)
+                    dense.push_back(&t);
+            }
+
+            bool ok = true;
+            if (!dense.empty())
+            {
+                const size_t steps = std::max<size_t>(1u, (fileSize + FANOUT_STEP_BYTES - 1u) / FANOUT_STEP_BYTES);
+                StepGate gate(dense.size());
+                std::atomic<bool> failed{ false };
+
+                // The first failure stops the others at their next step.
+                const auto run = [&](size_t i, const StepFn& onStep) {
+                    if (!RunDenseTarget(*dense[i], i, data, fileSize, steps, gate, onStep, cancel))
+                    {
+                        failed.store(true);
+                        gate.Abandon();
+                    }
+                };
+
+                std::vector<std::thread> helpers;
+                for (size_t i = 1u; i < dense.size(); ++i)
+                {
+                    helpers.emplace_back([&run, i] {
+                        if (Trace::Enabled())
+                            Trace::SetThreadName("fan-out sink " + std::to_string(i));
+                        run(i, StepFn{});
+                    });
+                }
+
+                DWORD lastTick = GetTickCount();
+                run(0u, [&](size_t offset) {
+                    ahead.Advance(offset);
+                    ReportProgress(progress, lastTick, offset, fileSize);
+                });
+
+                for (std::thread& t : helpers)
+                    t.join();
+
+                ok = !failed.load();
+            }
+
+            for (size_t i = 0u; ok && i < targets.size(); ++i)
+            {
+                if (!targets[i].dense)
+                    ok = RunWholeTarget(targets[i], data, fileSize, ahead, cancel);
+            }
+
+            stats.inputBytes = fileSize;
+            for (const FanOutTarget& t : targets)
+            {
+                stats.outputBytes += t.stats.outputBytes;
+                stats.openMs += t.stats.openMs;
+                stats.formatMs += t.stats.formatMs;
+                stats.writeMs += t.stats.writeMs;
+                stats.closeMs += t.stats.closeMs;
+            }
+
+            if (!ok)
+            {
+                for (FanOutTarget& t : targets)
+                {
+                    if (err.empty() && !t.err.empty())
+                        err = t.Name() + L": " + t.err;
+
+                    // Like a cancelled single-output job, leave no partial headers behind; spill
+                    // files are temporary either way.
+                    if ((cancel.IsSet() && t.created) || t.spilled)
+                    {
+                        t.hOut = FileIo::Handle{};
+                        DeleteFileW(t.outPath.c_str());
+                    }
+                }
+                if (err.empty())
+                    err = L"Conversion cancelled.";
+                return false;
+            }
+
+            for (size_t i = 0u; i < targets.size(); ++i)
+            {
+                FanOutTarget& t = targets[i];
+                if (t.spilled)
+                    ((i == 0u) ? r.spillPath : r.sinkSpillPaths[i - 1u]) = t.outPath;
+                else if (t.outPath.empty())
+                    ((i == 0u) ? r.output : r.sinkOutputs[i - 1u]) = std::move(t.rope);
+            }
+
+            progress.Report(100);
+            return true;
+        }
+    }
+
+    namespace detail
+    {
+        struct JobState
+        {
+            uint64_t id = 0;
+            std::atomic<bool> cancelled{ false };
+            std::atomic<int> progress{ 0 };
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool ready = false;
+            ConversionResult result{};
+        };
+    }
+
+    namespace
+    {
+        using detail::JobState;
+
+        struct WorkerCtx final : Threading::Task
+        {
+            Job job{};
+            std::shared_ptr<JobState> state;
+            std::chrono::steady_clock::time_point submitted{};
+
+            void Run(const std::atomic<bool>& poolCancelled) override;
+            void Discard() override;
+        };
+
+        // One context per running or queued job; the running count comes from the tuning profile.
+        static Threading::ObjectPool<WorkerCtx>& ContextPool()
+        {
+            static Threading::ObjectPool<WorkerCtx> pool(Tuning::WorkerThreads(Tuning::Active()) + MAX_QUEUED_JOBS);
+            return pool;
+        }
+
+        static Threading::ThreadPool& WorkerPool()
+        {
+            static Threading::ThreadPool pool(Tuning::WorkerThreads(Tuning::Active()), MAX_QUEUED_JOBS);
+            return pool;
+        }
+
+        static std::atomic<uint64_t> g_nextJobId{ 1 };
+
+        static void RecycleContext(WorkerCtx* ctx)
+        {
+            ctx->job = Job{};
+            ctx->state.reset();
+            ContextPool().Release(ctx);
+        }
+
+        // Publishes the result, then notifies the window (if any). The window fetches the result
+        // through its handle, so nothing is allocated for the message itself.
+        static void Complete(const Job& job, JobState& st, ConversionResult&& result)
+        {
+            const bool ok = result.ok;
+            {
+                std::lock_guard<std::mutex> lock(st.mutex);
+                st.result = std::move(result);
+                st.ready = true;
+            }
+            st.cv.notify_all();
+
+            if (job.hwndNotify)
+            {
+                PostMessageW(
+                    job.hwndNotify,
+                    AppMessages::WM_APP_DONE,
+                    static_cast<WPARAM>(ok ? 1 : 0),
+                    static_cast<LPARAM>(st.id));
+            }
+        }
+
+        void WorkerCtx::Run(const std::atomic<bool>& poolCancelled)
+        {
+            JobState& st = *state;
+            const Threading::CancelToken cancel{ &poolCancelled, &st.cancelled };
+            const ProgressTarget progress{ job.hwndNotify, &st.progress };
+
+            const auto t0 = std::chrono::steady_clock::now();
+            const Stats::ThreadSample before = Stats::SampleThread();
+            const uint64_t faultsBefore = Stats::PageFaultCount();
+
+            // The wait is recorded on the worker that picked the job up, ending where its span starts.
+            Trace::Complete("queued", Trace::ToUs(submitted), Trace::ToUs(t0));
+
+            ConversionResult r{};
             std::wstring err;
-            bool ok = false;
 
-            if (ctx->job.largeMode)
+            if (!job.sinks.empty())
+            {
+                Trace::Scope trace("fan-out job");
+                r.ok = ConvertFanOut(job, progress, cancel, r, err);
+            }
+            else if (job.largeMode)
             {
-                ok = ConvertLargeToFile(ctx->job.inPath, ctx->job.outPath, ctx->job.hwndNotify, ctx->job.format, err);
+                Trace::Scope trace("large job");
+                JobInput input;
+                r.ok = ValidateLayout(job.format, err) && OpenJobInput(job, cancel, r.stats, input, err) &&
+                    ConvertLargeToFile(input, job.outPath, progress, job.format, job.incremental, job.mappedOutput, cancel, r.stats, err);
+                if (!r.ok && cancel.IsSet())
+                    DeleteFileW(job.outPath.c_str());
             }
             else
             {
-                std::wstring out;
-                ok = ConvertSmallToMemory(ctx->job.inPath, ctx->job.format, out, err);
-                if (ok && ctx->outSmall)
-                    *(ctx->outSmall) = std::move(out);
+                Trace::Scope trace("small job");
+                r.ok = ConvertSmallOrSpill(job, progress, cancel, r, err);
             }
 
-            std::wstring msg;
-            if (ok)
+            const Stats::ThreadSample after = Stats::SampleThread();
+            r.stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            r.stats.queueMs = std::chrono::duration<double, std::milli>(t0 - submitted).count();
+            r.stats.cpuMs = after.cpuMs - before.cpuMs;
+            r.stats.allocations = after.allocations - before.allocations;
+            r.stats.allocatedBytes = after.allocatedBytes - before.allocatedBytes;
+            r.stats.peakWorkingSetBytes = Stats::PeakWorkingSetBytes();
+            r.stats.pageFaults = Stats::PageFaultCount() - faultsBefore;
+
+            if (r.ok)
             {
-                if (ctx->job.largeMode)
-                    msg = L"OK: saved to file:\r\n" + ctx->job.outPath;
+                if (job.largeMode && r.stats.blocksRewritten < r.stats.blocksTotal)
+                {
+                    r.message = L"OK: updated in place (" + std::to_wstring(r.stats.blocksRewritten) + L" of " +
+                                std::to_wstring(r.stats.blocksTotal) + L" blocks changed):\r\n" + job.outPath;
+                }
+                else if (!job.sinks.empty())
+                {
+                    const auto where = [](const std::wstring& path, const std::wstring& spill, const wchar_t* memory) {
+                        if (!spill.empty())
+                            return L"(over the memory budget) " + spill;
+                        return path.empty() ? std::wstring(memory) : path;
+                    };
+
+                    r.message = L"OK: " + std::to_wstring(job.sinks.size() + 1u) + L" outputs from one pass:";
+                    r.message += L"\r\n" + where(job.largeMode ? job.outPath : std::wstring(), r.spillPath, L"(in UI)");
+                    for (size_t i = 0u; i < job.sinks.size(); ++i)
+                        r.message += L"\r\n" + where(job.sinks[i].outPath, r.sinkSpillPaths[i], L"(in memory)");
+                }
+                else if (job.largeMode)
+                    r.message = L"OK: saved to file:\r\n" + job.outPath;
+                else if (!r.spillPath.empty())
+                    r.message = L"OK: the output is over the memory budget and was saved to a temporary file:\r\n" + r.spillPath;
                 else
-                    msg = L"OK: output generated in UI.";
+                    r.message = L"OK: output generated in UI.";
             }
             else
             {
-                msg = L"ERROR:\r\n" + (err.empty() ? L"Conversion failed." : err);
+                r.message = L"ERROR:\r\n" + (err.empty() ? L"Conversion failed." : err);
             }
 
-            const size_t bytes = (msg.size() + 1u) * sizeof(wchar_t);
-            wchar_t* heapMsg = static_cast<wchar_t*>(HeapAlloc(GetProcessHeap(), 0, bytes));
-            if (heapMsg)
-                std::memcpy(heapMsg, msg.c_str(), bytes);
+            Complete(job, st, std::move(r));
+            RecycleContext(this);
+        }
 
-            PostMessageW(
-                ctx->job.hwndNotify,
-                AppMessages::WM_APP_DONE,
-                static_cast<WPARAM>(ok ? 1 : 0),
-                reinterpret_cast<LPARAM>(heapMsg));
+        void WorkerCtx::Discard()
+        {
+            ConversionResult r{};
+            r.message = L"ERROR:\r\nConversion cancelled.";
 
-            delete ctx;
-            return 0;
+            Complete(job, *state, std::move(r));
+            RecycleContext(this);
         }
     }
 
@@ -691,7 +2418,7 @@ namespace EmbedPack::Converter
     {
         outSize = 0;
 
-        Handle h(CreateFileW(
+        FileIo::Handle h(CreateFileW(
             path.c_str(),
             GENERIC_READ,
             FILE_SHARE_READ,
@@ -714,23 +2441,149 @@ namespace EmbedPack::Converter
         return true;
     }
 
-    bool StartConversionAsync(const Job& job, std::wstring& outSmallOutput)
+    std::string FormatPreamble(const Format& fmt)
     {
-        auto* ctx = new WorkerCtx();
-        ctx->job = job;
-
-        if (!job.largeMode)
-            ctx->outSmall = &outSmallOutput;
-        else
-            ctx->outSmall = nullptr;
+        std::string out;
+        AppendSectionPreamble(fmt, out);
+        return out;
+    }
 
-        Handle hThread(CreateThread(nullptr, 0, WorkerThread, ctx, 0, nullptr));
-        if (!hThread.valid())
+    bool FormatArray(const char* name, const uint8_t* data, size_t byteCount, const Format& fmt, std::string& out, std::wstring& err)
+    {
+        if (!ValidateLayout(fmt, err))
+            return false;
+        if (byteCount == 0u)
         {
-            delete ctx;
+            err = L"An array needs at least one byte.";
             return false;
         }
 
+        const FormatSpec f = GetFormatSpec(fmt.elementType);
+        const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+        const Kernel k = SelectKernel(f, fmt.byteOrder);
+
+        Format dense = fmt;
+        dense.zeroElision = ZeroElision::None;
+
+        const size_t elementCount = ComputeElementCount(byteCount, f.elemSize, fmt.tailPadding);
+        AppendHeader(f, s, dense, elementCount, out, name);
+
+        const size_t at = out.size();
+        out.resize(at + RangeTextSize(k, elementCount, 0u, elementCount));
+        if (elementCount != 0u)
+            k.formatRange(data, byteCount, elementCount, 0u, elementCount, &out[at]);
+
+        out.append("\r\n};\r\n");
         return true;
     }
+
+    uint64_t PredictOutputBytes(const Format& fmt, uint64_t inputBytes)
+    {
+        const FormatSpec f = GetFormatSpec(fmt.elementType);
+        const StyleSpec s = GetStyleSpec(fmt.arrayStyle);
+        const Kernel k = SelectKernel(f, fmt.byteOrder);
+
+        const size_t byteCount = static_cast<size_t>(inputBytes);
+        const size_t elementCount = ComputeElementCount(byteCount, f.elemSize, fmt.tailPadding);
+
+        // The checksum literals have a fixed width, so an empty pass sizes the footer exactly.
+        Format dense = fmt;
+        if (dense.zeroElision == ZeroElision::Sparse)
+            dense.zeroElision = ZeroElision::None;
+
+        std::string text;
+        AppendIncludes(f, s, fmt, text);
+        AppendSectionPreamble(fmt, text);
+        AppendHeader(f, s, dense, elementCount, text);
+        AppendFooter(f, s, elementCount, byteCount, ChecksumPass(fmt.checksum), text);
+
+        uint64_t bytes = text.size() + RangeTextSize(k, elementCount, 0u, elementCount);
+        if (fmt.zeroElision == ZeroElision::Sparse)
+            bytes += SPARSE_FIXED_TEXT_BYTES;
+        if (fmt.textLiteral == TextLiteral::Auto && inputBytes <= TEXT_LITERAL_MAX_BYTES)
+            bytes = std::max<uint64_t>(bytes, text.size() + inputBytes * TEXT_MAX_CHARS_PER_BYTE);
+        return bytes;
+    }
+
+    uint64_t ConversionHandle::Id() const noexcept
+    {
+        return m_state ? m_state->id : 0u;
+    }
+
+    int ConversionHandle::Progress() const noexcept
+    {
+        return m_state ? m_state->progress.load(std::memory_order_relaxed) : 0;
+    }
+
+    bool ConversionHandle::IsReady() const
+    {
+        if (!m_state)
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return m_state->ready;
+    }
+
+    void ConversionHandle::Wait() const
+    {
+        if (!m_state)
+            return;
+
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->cv.wait(lock, [this] { return m_state->ready; });
+    }
+
+    bool ConversionHandle::WaitFor(uint32_t timeoutMs) const
+    {
+        if (!m_state)
+            return false;
+
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        return m_state->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return m_state->ready; });
+    }
+
+    ConversionResult ConversionHandle::Take()
+    {
+        if (!m_state)
+            return {};
+
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        if (!m_state->ready)
+            return {};
+
+        return std::move(m_state->result);
+    }
+
+    void ConversionHandle::Cancel() noexcept
+    {
+        if (m_state)
+            m_state->cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    ConversionHandle StartConversionAsync(const Job& job)
+    {
+        WorkerCtx* ctx = ContextPool().Acquire();
+        if (ctx == nullptr)
+            return {};
+
+        auto state = std::allocate_shared<JobState>(Threading::RecyclingAllocator<JobState>{});
+        state->id = g_nextJobId.fetch_add(1u, std::memory_order_relaxed);
+
+        ctx->job = job;
+        ctx->state = state;
+        ctx->submitted = std::chrono::steady_clock::now();
+
+        if (!WorkerPool().Submit(ctx, job.priority))
+        {
+            RecycleContext(ctx);
+            return {};
+        }
+
+        return ConversionHandle(std::move(state));
+    }
+
+    void ShutdownWorkers(Threading::ShutdownMode mode)
+    {
+        WorkerPool().Shutdown(mode);
+    }
 }
@@ -4,8 +4,14 @@
 #define NOMINMAX
 #include <windows.h>
 
+#include "TextRope.h"
+#include "ThreadPool.h"
+#include "Transform.h"
+
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace EmbedPack::AppMessages
 {
@@ -16,6 +22,7 @@ namespace EmbedPack::AppMessages
 namespace EmbedPack::Clipboard
 {
     void SetClipboardUnicode(HWND owner, const std::wstring& text);
+    void SetClipboardUnicode(HWND owner, const Text::Rope& text);
 }
 
 namespace EmbedPack::FileDialogs
@@ -24,6 +31,11 @@ namespace EmbedPack::FileDialogs
     bool PromptSaveOutputPath(HWND owner, const std::wstring& inputPath, std::wstring& outPath);
 }
 
+namespace EmbedPack::FileIo
+{
+    struct MappedInput;
+}
+
 namespace EmbedPack::Converter
 {
     enum class ElementType : uint8_t
@@ -46,23 +58,210 @@ namespace EmbedPack::Converter
         StaticConstexprStdArray
     };
 
+    enum class ByteOrder : uint8_t
+    {
+        LittleEndian = 0,
+        BigEndian
+    };
+
+    enum class TailPadding : uint8_t
+    {
+        None = 0,
+        CacheLine,
+        Page
+    };
+
+    // Integrity values of the original input, emitted next to fileBytesSize.
+    enum class Checksum : uint8_t
+    {
+        None = 0,
+        Crc32c,
+        Xxh64,
+        Both
+    };
+
+    // How runs of zero bytes are written.
+    enum class ZeroElision : uint8_t
+    {
+        None = 0,
+        // Trailing zeros are dropped; the array keeps its full size through zero-initialization.
+        Trailing,
+        // Non-zero segments only, plus a segment table and a fill routine that expands them.
+        Sparse
+    };
+
+    // Whether text inputs are written as a string literal instead of hex tokens.
+    enum class TextLiteral : uint8_t
+    {
+        Never = 0,
+        // Byte element types only: inputs up to TEXT_LITERAL_MAX_BYTES that TextScan::IsText
+        // accepts become raw string literal pieces; everything else keeps the array layout.
+        Auto
+    };
+
+    // MSVC rejects a concatenated string literal over 65535 bytes, terminator included (C1091).
+    constexpr size_t TEXT_LITERAL_MAX_BYTES = 65534u;
+
+    constexpr uint32_t CACHE_LINE_SIZE = 64u;
+    constexpr uint32_t PAGE_SIZE       = 4096u;
+
     struct Format
     {
         ElementType elementType = ElementType::UnsignedChar;
         ArrayStyle arrayStyle   = ArrayStyle::ConstArray;
+        ByteOrder byteOrder     = ByteOrder::LittleEndian;
+
+        // Layout control: 0 keeps the natural alignment, otherwise a power of two up to PAGE_SIZE.
+        uint32_t alignment = 0u;
+        // Emitted through the portable EMBEDPACK_SECTION macro; empty keeps the default placement.
+        std::string sectionName;
+        TailPadding tailPadding = TailPadding::None;
+        // Computed in the formatting pass over the mapped input, so it costs no extra read.
+        Checksum checksum = Checksum::None;
+        ZeroElision zeroElision = ZeroElision::None;
+        TextLiteral textLiteral = TextLiteral::Never;
     };
 
-    constexpr uint64_t UI_SOFT_LIMIT = 8ull * 1024ull * 1024ull;
+    inline bool operator==(const Format& a, const Format& b) noexcept
+    {
+        return a.elementType == b.elementType && a.arrayStyle == b.arrayStyle && a.byteOrder == b.byteOrder &&
+               a.alignment == b.alignment && a.sectionName == b.sectionName && a.tailPadding == b.tailPadding &&
+               a.checksum == b.checksum && a.zeroElision == b.zeroElision && a.textLiteral == b.textLiteral;
+    }
+
+    inline bool operator!=(const Format& a, const Format& b) noexcept { return !(a == b); }
+
+    // A further output of a fan-out job, formatted from the same pass over the input.
+    struct Sink
+    {
+        Format format{};
+        // Header to write; empty keeps the text in memory, as small mode does.
+        std::wstring outPath;
+    };
+
+    constexpr size_t MAX_CONCURRENT_JOBS = 4u;
+    constexpr size_t MAX_QUEUED_JOBS     = 32u;
 
     struct Job
     {
         HWND hwndNotify = nullptr;
         std::wstring inPath;
         std::wstring outPath;
+        // Large mode writes outPath. Small mode returns the text in memory, or writes it to a
+        // spill file when it would not fit in the memory budget (see MemoryBudget.h).
         bool largeMode = false;
+        // Large mode only: rewrite just the lines of changed input blocks when a matching block
+        // manifest from the previous run exists next to the output.
+        bool incremental = false;
+        // Large mode only: size the output up front, map it and format into it on several
+        // threads. Sparse outputs and in-place patches keep the buffered writer.
+        bool mappedOutput = false;
         Format format{};
+        // Outputs besides the job's own: the input is mapped and read once for all of them, and
+        // the dense ones are formatted side by side a step at a time. Jobs with sinks write every
+        // file output in full, so incremental and mappedOutput are ignored.
+        std::vector<Sink> sinks;
+        // Applied in order to the input bytes before formatting; every sink sees the result.
+        // Integrity values, text detection and the sparse scan all work on the transformed bytes.
+        Transform::Spec transforms;
+        // A view of inPath the caller already holds (the GUI keeps the selected file mapped),
+        // used instead of opening the file again.
+        std::shared_ptr<const FileIo::MappedInput> input;
+        Threading::Priority priority = Threading::Priority::Normal;
+    };
+
+    struct ConversionStats
+    {
+        uint64_t inputBytes = 0;
+        uint64_t outputBytes = 0;
+        // Size of the file before transforms; 0 when the job has none (inputBytes is the file).
+        uint64_t sourceBytes = 0;
+        double elapsedMs = 0.0;
+
+        // Incremental large mode: blocksRewritten < blocksTotal means the output was patched in place.
+        uint64_t blocksTotal = 0;
+        uint64_t blocksRewritten = 0;
+
+        // Phase breakdown in milliseconds; phases a mode does not have stay zero. Page faults on
+        // the mapped input land in the format phase.
+        double queueMs = 0.0;
+        double openMs = 0.0;
+        double transformMs = 0.0;
+        double hashMs = 0.0;
+        double formatMs = 0.0;
+        double writeMs = 0.0;
+        double closeMs = 0.0;
+
+        // Worker thread counters over the job, plus the process-wide working set peak.
+        double cpuMs = 0.0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t peakWorkingSetBytes = 0;
+
+        // Process page faults over the job (including any concurrent jobs) and the input bytes
+        // requested ahead of the formatter; compare cold-cache runs with read-ahead on and off.
+        uint64_t pageFaults = 0;
+        uint64_t readAheadBytes = 0;
+    };
+
+    struct ConversionResult
+    {
+        bool ok = false;
+        std::wstring message;
+        Text::Rope output; // small mode only
+        // Small mode: the output was over the memory budget and went to this temp file instead of
+        // output. The caller owns the file.
+        std::wstring spillPath;
+        // Per Job::sinks entry, the same pair for in-memory sinks.
+        std::vector<Text::Rope> sinkOutputs;
+        std::vector<std::wstring> sinkSpillPaths;
+        ConversionStats stats{};
+    };
+
+    namespace detail
+    {
+        struct JobState;
+    }
+
+    // Shared completion state of one job. WM_APP_DONE carries Id() in lParam when the job has a
+    // notify window; headless callers use Wait/IsReady instead.
+    class ConversionHandle final
+    {
+    public:
+        ConversionHandle() = default;
+
+        bool Valid() const noexcept { return m_state != nullptr; }
+        uint64_t Id() const noexcept;
+        int Progress() const noexcept;
+
+        bool IsReady() const;
+        void Wait() const;
+        bool WaitFor(uint32_t timeoutMs) const;
+
+        // Moves the result out once the job is complete; later calls yield an empty result.
+        ConversionResult Take();
+        void Cancel() noexcept;
+
+    private:
+        friend ConversionHandle StartConversionAsync(const Job& job);
+        explicit ConversionHandle(std::shared_ptr<detail::JobState> state) : m_state(std::move(state)) {}
+
+        std::shared_ptr<detail::JobState> m_state;
     };
 
     bool GetFileSizeU64(const std::wstring& path, uint64_t& outSize);
-    bool StartConversionAsync(const Job& job, std::wstring& outSmallOutput);
+
+    // Size of the header text fmt produces for an input of inputBytes: exact for the dense
+    // layouts, an upper bound for trimmed, sparse and text outputs, whose size depends on the
+    // content. Small mode checks it against the memory budget before it formats anything.
+    uint64_t PredictOutputBytes(const Format& fmt, uint64_t inputBytes);
+
+    // Building blocks for callers that assemble their own headers (bundles, deltas): the section
+    // macro preamble, and one complete array definition under the given name in fmt's element
+    // type, style and layout.
+    std::string FormatPreamble(const Format& fmt);
+    bool FormatArray(const char* name, const uint8_t* data, size_t byteCount, const Format& fmt, std::string& out, std::wstring& err);
+
+    ConversionHandle StartConversionAsync(const Job& job);
+    void ShutdownWorkers(Threading::ShutdownMode mode);
 }
@@ -0,0 +1,648 @@
+// Decoder.cpp
+#include "Decoder.h"
+#include "FileMapping.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define EMBEDPACK_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace EmbedPack::Decoder
+{
+    namespace
+    {
+        static constexpr std::string_view ARRAY_NAME = "fileBytes";
+        static constexpr std::string_view ORIGINAL_SIZE_DECL = "fileBytesOriginalSize = ";
+        static constexpr std::string_view SIZE_DECL = "fileBytesSize = ";
+        static constexpr std::string_view SIZEOF_DECL = "sizeof(fileBytes);";
+        static constexpr std::string_view SEGMENT_COUNT_DECL = "fileBytesSegmentCount = ";
+        static constexpr std::string_view SEGMENT_TABLE_DECL = "fileBytesSegments[] = {";
+        static constexpr std::string_view ELEMENT_DECL = "using fileBytesElement = ";
+        static constexpr std::string_view LINE_PREFIX = "\r\n    ";
+        static constexpr std::string_view SEPARATOR = ", ";
+
+        struct HexValueTable
+        {
+            uint8_t values[256];
+
+            constexpr HexValueTable() : values{}
+            {
+                for (size_t i = 0u; i < 256u; ++i)
+                    values[i] = 0xFFu;
+                for (size_t i = 0u; i < 10u; ++i)
+                    values['0' + i] = static_cast<uint8_t>(i);
+                for (size_t i = 0u; i < 6u; ++i)
+                {
+                    values['A' + i] = static_cast<uint8_t>(10u + i);
+                    values['a' + i] = static_cast<uint8_t>(10u + i);
+                }
+            }
+        };
+
+        static constexpr HexValueTable HEX_VALUES{};
+
+        static inline uint8_t HexValue(char ch) noexcept
+        {
+            return HEX_VALUES.values[static_cast<uint8_t>(ch)];
+        }
+
+        static bool IsIdentChar(char ch)
+        {
+            return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+        }
+
+        // 16 hex digits -> 8 bytes; false if any character is not a hex digit.
+        static inline bool HexToBytes8(const char* hex, uint8_t* out) noexcept
+        {
+#if defined(EMBEDPACK_DECODER_SSE2)
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex));
+            const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+
+            const __m128i isDigit = _mm_and_si128(
+                _mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+            const __m128i isAlpha = _mm_and_si128(
+                _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+            if (_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF)
+                return false;
+
+            const __m128i nibbles = _mm_or_si128(
+                _mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                _mm_and_si128(isAlpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+
+            // Each 16-bit lane holds (high nibble, low nibble) in memory order.
+            const __m128i hi = _mm_and_si128(nibbles, _mm_set1_epi16(0x00FF));
+            const __m128i lo = _mm_srli_epi16(nibbles, 8);
+            const __m128i words = _mm_or_si128(_mm_slli_epi16(hi, 4), lo);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(words, words));
+            return true;
+#else
+            for (size_t i = 0u; i < 8u; ++i)
+            {
+                const uint8_t hi = HexValue(hex[i * 2u]);
+                const uint8_t lo = HexValue(hex[i * 2u + 1u]);
+                if ((hi | lo) > 0x0Fu)
+                    return false;
+                out[i] = static_cast<uint8_t>((hi << 4u) | lo);
+            }
+            return true;
+#endif
+        }
+
+        // One instantiation per (element width, std::byte wrapping, byte order) so every offset in
+        // the fixed line layout is a compile-time constant.
+        template <size_t ElemSize, bool StdByte, bool BigEndian>
+        struct LineDecoder final
+        {
+            static constexpr size_t DIGITS = ElemSize * 2u;
+            static constexpr size_t PREFIX_LEN = (StdByte ? 10u : 0u) + 2u;
+            static constexpr size_t SUFFIX_LEN = StdByte ? 1u : 0u;
+            static constexpr size_t STRIDE = PREFIX_LEN + DIGITS + SUFFIX_LEN + SEPARATOR.size();
+            static constexpr size_t VALUES_PER_LINE = 16u / ElemSize;
+
+            // Fast path for one full line in the layout the converter writes: decorations are
+            // checked at fixed offsets and the 32 digits go through HexToBytes8.
+            static bool Decode(const char* line, uint8_t* dst) noexcept
+            {
+                if (std::memcmp(line, LINE_PREFIX.data(), LINE_PREFIX.size()) != 0)
+                    return false;
+
+                char hex[32];
+                const char* tok = line + LINE_PREFIX.size();
+                for (size_t k = 0u; k < VALUES_PER_LINE; ++k, tok += STRIDE)
+                {
+                    if constexpr (StdByte)
+                    {
+                        if (std::memcmp(tok, "std::byte{", 10u) != 0 || tok[PREFIX_LEN + DIGITS] != '}')
+                            return false;
+                    }
+
+                    const char* sep = tok + PREFIX_LEN + DIGITS + SUFFIX_LEN;
+                    if (tok[PREFIX_LEN - 2u] != '0' || tok[PREFIX_LEN - 1u] != 'x' || sep[0] != ',' || sep[1] != ' ')
+                        return false;
+
+                    std::memcpy(hex + k * DIGITS, tok + PREFIX_LEN, DIGITS);
+                }
+
+                if (!HexToBytes8(hex, dst) || !HexToBytes8(hex + 16, dst + 8))
+                    return false;
+
+                // Digits are most-significant first; little-endian grouping stores the low byte first.
+                if constexpr (!BigEndian && ElemSize > 1u)
+                {
+                    for (size_t e = 0u; e < 16u; e += ElemSize)
+                        std::reverse(dst + e, dst + e + ElemSize);
+                }
+                return true;
+            }
+        };
+
+        using DecodeLineFn = bool (*)(const char*, uint8_t*);
+
+        struct Layout
+        {
+            size_t elemSize = 1u;
+            size_t lineLen = 0u;
+            size_t stride = 0u;
+            bool bigEndian = false;
+            DecodeLineFn decodeLine = nullptr;
+        };
+
+        template <size_t ElemSize, bool StdByte, bool BigEndian>
+        static void SetLayout(Layout& l)
+        {
+            using D = LineDecoder<ElemSize, StdByte, BigEndian>;
+            l.elemSize = ElemSize;
+            l.stride = D::STRIDE;
+            l.lineLen = LINE_PREFIX.size() + D::VALUES_PER_LINE * D::STRIDE;
+            l.decodeLine = &D::Decode;
+        }
+
+        // Tolerant scanner for everything else: partial lines, the final element and text whose
+        // whitespace or line endings were rewritten after generation.
+        static bool DecodeTokenSlow(const Layout& l, const char*& p, const char* end, uint8_t* dst, std::wstring& err)
+        {
+            const size_t maxDigits = l.elemSize * 2u;
+
+            size_t n = 0u;
+            uint64_t value = 0u;
+            while (p < end && HexValue(*p) <= 0x0Fu)
+            {
+                if (++n > maxDigits)
+                {
+                    err = L"Value does not fit the element type.";
+                    return false;
+                }
+                value = (value << 4u) | HexValue(*p);
+                ++p;
+            }
+
+            if (n == 0u)
+            {
+                err = L"Malformed hex literal.";
+                return false;
+            }
+
+            for (size_t b = 0u; b < l.elemSize; ++b)
+            {
+                const size_t shift = l.bigEndian ? (l.elemSize - 1u - b) * 8u : b * 8u;
+                dst[b] = static_cast<uint8_t>(value >> shift);
+            }
+            return true;
+        }
+
+        static bool ParseLayout(std::string_view decl, const Options& opt, Layout& l, std::wstring& err)
+        {
+            const bool be = (opt.byteOrder == Converter::ByteOrder::BigEndian);
+            l.bigEndian = be;
+
+            // Skip alignas(...) / EMBEDPACK_SECTION(...) so a section name cannot look like a type.
+            const size_t attrEnd = decl.rfind(')');
+            if (attrEnd != std::string_view::npos)
+                decl.remove_prefix(attrEnd + 1u);
+
+            const auto has = [&](const char* name) { return decl.find(name) != std::string_view::npos; };
+
+            if (has("uint64_t"))
+                be ? SetLayout<8u, false, true>(l) : SetLayout<8u, false, false>(l);
+            else if (has("uint32_t"))
+                be ? SetLayout<4u, false, true>(l) : SetLayout<4u, false, false>(l);
+            else if (has("uint16_t") || has("unsigned short"))
+                be ? SetLayout<2u, false, true>(l) : SetLayout<2u, false, false>(l);
+            else if (has("std::byte"))
+                SetLayout<1u, true, false>(l);
+            else if (has("uint8_t") || has("unsigned char"))
+                SetLayout<1u, false, false>(l);
+            else
+            {
+                err = L"Unrecognized element type in the fileBytes declaration.";
+                return false;
+            }
+            return true;
+        }
+
+        static bool ParseUnsigned(std::string_view s, size_t& value)
+        {
+            value = 0u;
+            size_t n = 0u;
+            for (; n < s.size() && s[n] >= '0' && s[n] <= '9'; ++n)
+                value = value * 10u + static_cast<size_t>(s[n] - '0');
+            return n != 0u;
+        }
+
+        // Decodes the values between an initializer's braces into out (whole elements).
+        static bool DecodeInitializer(const Layout& l, const char* p, const char* const end, std::vector<uint8_t>& out, std::wstring& err)
+        {
+            // Sized for the standard layout; the slow path grows it if the text is denser than that.
+            const size_t estimate = static_cast<size_t>(end - p) / l.stride + 1u;
+            out.resize(estimate * l.elemSize);
+
+            const size_t lineLen = l.lineLen;
+            size_t written = 0u;
+
+            while (p < end)
+            {
+                if (static_cast<size_t>(end - p) >= lineLen && written + 16u <= out.size() &&
+                    l.decodeLine(p, out.data() + written))
+                {
+                    p += lineLen;
+                    written += 16u;
+                    continue;
+                }
+
+                const char* x = static_cast<const char*>(std::memchr(p, 'x', static_cast<size_t>(end - p)));
+                if (x == nullptr)
+                    break;
+
+                if (x == p || x[-1] != '0')
+                {
+                    err = L"Malformed hex literal.";
+                    return false;
+                }
+
+                if (written + l.elemSize > out.size())
+                    out.resize(std::max(out.size() * 2u, written + l.elemSize));
+
+                p = x + 1;
+                if (!DecodeTokenSlow(l, p, end, out.data() + written, err))
+                    return false;
+                written += l.elemSize;
+
+                // Step over the separator so the next full line is picked up by the fast path again.
+                while (p < end && (*p == '}' || *p == ',' || *p == ' '))
+                    ++p;
+            }
+
+            out.resize(written);
+            return true;
+        }
+
+        static size_t FindArrayName(std::string_view text)
+        {
+            size_t pos = 0u;
+            while ((pos = text.find(ARRAY_NAME, pos)) != std::string_view::npos)
+            {
+                const size_t after = pos + ARRAY_NAME.size();
+                const bool startOk = (pos == 0u) || !IsIdentChar(text[pos - 1u]);
+                const bool endOk = (after >= text.size()) || !IsIdentChar(text[after]);
+                if (startOk && endOk)
+                    return pos;
+                pos = after;
+            }
+            return std::string_view::npos;
+        }
+    }
+
+    namespace
+    {
+        static bool DecodeEscape(std::string_view text, size_t& pos, std::vector<uint8_t>& out, std::wstring& err)
+        {
+            const char e = text[pos++];
+            switch (e)
+            {
+            case 'n':  out.push_back('\n'); return true;
+            case 'r':  out.push_back('\r'); return true;
+            case 't':  out.push_back('\t'); return true;
+            case '\\': case '"': case '\'': case '?':
+                out.push_back(static_cast<uint8_t>(e));
+                return true;
+            case 'x':
+            {
+                // Greedy, like the compiler; the converter ends a literal after each escape run.
+                uint32_t value = 0u;
+                size_t digits = 0u;
+                for (; pos < text.size() && HexValue(text[pos]) != 0xFFu; ++pos, ++digits)
+                    value = (value << 4u) | HexValue(text[pos]);
+                if (digits == 0u || value > 0xFFu)
+                    break;
+                out.push_back(static_cast<uint8_t>(value));
+                return true;
+            }
+            default:
+                break;
+            }
+
+            err = L"Unsupported escape sequence in the fileBytes literal.";
+            return false;
+        }
+
+        // Raw and ordinary string literal pieces from pos to the ';' that ends the declaration,
+        // concatenated as the compiler would.
+        static bool DecodeLiterals(std::string_view text, size_t pos, std::vector<uint8_t>& out, size_t& end, std::wstring& err)
+        {
+            for (;;)
+            {
+                while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n'))
+                    ++pos;
+                if (pos >= text.size())
+                    break;
+
+                if (text[pos] == ';')
+                {
+                    end = pos;
+                    return true;
+                }
+
+                if (text[pos] == 'R' && pos + 1u < text.size() && text[pos + 1u] == '"')
+                {
+                    const size_t open = text.find('(', pos + 2u);
+                    if (open == std::string_view::npos || open - pos - 2u > 16u)
+                    {
+                        err = L"Malformed raw string literal.";
+                        return false;
+                    }
+
+                    const std::string close = ")" + std::string(text.substr(pos + 2u, open - pos - 2u)) + "\"";
+                    const size_t stop = text.find(close, open + 1u);
+                    if (stop == std::string_view::npos)
+                        break;
+
+                    // Source CR LF reads as LF, inside raw literals too.
+                    for (size_t i = open + 1u; i < stop; ++i)
+                    {
+                        if (text[i] != '\r' || i + 1u >= stop || text[i + 1u] != '\n')
+                            out.push_back(static_cast<uint8_t>(text[i]));
+                    }
+                    pos = stop + close.size();
+                }
+                else if (text[pos] == '"')
+                {
+                    ++pos;
+                    while (pos < text.size() && text[pos] != '"')
+                    {
+                        if (text[pos] != '\\')
+                            out.push_back(static_cast<uint8_t>(text[pos++]));
+                        else if (++pos < text.size() && !DecodeEscape(text, pos, out, err))
+                            return false;
+                    }
+                    if (pos >= text.size())
+                        break;
+                    ++pos;
+                }
+                else
+                {
+                    err = L"Unexpected token in the fileBytes literal.";
+                    return false;
+                }
+            }
+
+            err = L"Unterminated fileBytes initializer.";
+            return false;
+        }
+
+        // Drops tail padding when the header records the original length.
+        static bool ApplyOriginalSize(std::string_view text, size_t from, std::vector<uint8_t>& out, DecodeInfo& info, std::wstring& err)
+        {
+            const size_t orig = text.find(ORIGINAL_SIZE_DECL, from);
+            if (orig == std::string_view::npos)
+                return true;
+
+            size_t originalSize = 0u;
+            if (!ParseUnsigned(text.substr(orig + ORIGINAL_SIZE_DECL.size()), originalSize) || originalSize > out.size())
+            {
+                err = L"Invalid fileBytesOriginalSize.";
+                return false;
+            }
+
+            info.hadPadding = (originalSize != out.size());
+            out.resize(originalSize);
+            return true;
+        }
+
+        // Text headers state the byte count; the array itself also holds the terminating NUL. A
+        // padded one declares fileBytes[N] and states its size as the padded sizeof, like dense
+        // output, with the text's length in fileBytesOriginalSize.
+        static bool DecodeTextLiteral(std::string_view text, size_t namePos, size_t first, std::vector<uint8_t>& out, DecodeInfo& info, std::wstring& err)
+        {
+            size_t end = 0u;
+            if (!DecodeLiterals(text, first, out, end, err))
+                return false;
+
+            size_t padded = 0u;
+            const size_t bracket = namePos + ARRAY_NAME.size();
+            const bool hasPadding = bracket < text.size() && text[bracket] == '[' && ParseUnsigned(text.substr(bracket + 1u), padded);
+            if (hasPadding && padded <= out.size())
+            {
+                err = L"The fileBytes literal does not fit its declared size.";
+                return false;
+            }
+
+            const size_t sizePos = text.find(SIZE_DECL, end);
+            const std::string_view sizeText = (sizePos == std::string_view::npos) ? std::string_view() : text.substr(sizePos + SIZE_DECL.size());
+            size_t declared = 0u;
+            const bool sizeOk = hasPadding ? sizeText.substr(0u, SIZEOF_DECL.size()) == SIZEOF_DECL
+                                           : ParseUnsigned(sizeText, declared) && declared == out.size();
+            if (!sizeOk)
+            {
+                err = L"The fileBytes literal does not match fileBytesSize.";
+                return false;
+            }
+
+            if (hasPadding)
+                out.resize(padded, 0u);
+
+            info.elementSize = 1u;
+            info.elementCount = out.size();
+            return !hasPadding || ApplyOriginalSize(text, sizePos, out, info, err);
+        }
+
+        static bool DecodeDense(std::string_view text, const Options& opt, std::vector<uint8_t>& out, DecodeInfo& info, std::wstring& err)
+        {
+            const size_t namePos = FindArrayName(text);
+            if (namePos == std::string_view::npos)
+            {
+                err = L"No fileBytes declaration found.";
+                return false;
+            }
+
+            // Text outputs: "fileBytes[] =" followed by string literal pieces instead of a brace.
+            const size_t eq = text.find('=', namePos);
+            const size_t first = (eq == std::string_view::npos) ? eq : text.find_first_not_of(" \t\r\n", eq + 1u);
+            if (first != std::string_view::npos && (text[first] == 'R' || text[first] == '"'))
+                return DecodeTextLiteral(text, namePos, first, out, info, err);
+
+            const size_t lineStart = text.rfind('\n', namePos);
+            const size_t declStart = (lineStart == std::string_view::npos) ? 0u : lineStart + 1u;
+
+            Layout l;
+            if (!ParseLayout(text.substr(declStart, namePos - declStart), opt, l, err))
+                return false;
+
+            // std::array<T, N> and a trimmed fileBytes[N] state the element count up front.
+            size_t declaredCount = 0u;
+            bool hasDeclaredCount = false;
+            {
+                const std::string_view decl = text.substr(declStart, namePos - declStart);
+                const size_t arr = decl.find("std::array<");
+                const size_t comma = (arr == std::string_view::npos) ? arr : decl.find(',', arr);
+                if (comma != std::string_view::npos)
+                    hasDeclaredCount = ParseUnsigned(decl.substr(comma + 2u), declaredCount);
+                else if (namePos + ARRAY_NAME.size() < text.size() && text[namePos + ARRAY_NAME.size()] == '[')
+                    hasDeclaredCount = ParseUnsigned(text.substr(namePos + ARRAY_NAME.size() + 1u), declaredCount);
+            }
+
+            const size_t open = text.find('{', namePos);
+            const size_t close = (open == std::string_view::npos) ? open : text.find("};", open);
+            if (close == std::string_view::npos)
+            {
+                err = L"Unterminated fileBytes initializer.";
+                return false;
+            }
+
+            if (!DecodeInitializer(l, text.data() + open + 1u, text.data() + close, out, err))
+                return false;
+
+            info.elementSize = l.elemSize;
+            info.elementCount = out.size() / l.elemSize;
+
+            if (hasDeclaredCount)
+            {
+                if (info.elementCount > declaredCount)
+                {
+                    err = L"More initializers than the declared array size.";
+                    return false;
+                }
+
+                // Trailing zeros left to zero-initialization.
+                info.elementCount = declaredCount;
+                out.resize(declaredCount * l.elemSize, 0u);
+            }
+
+            return ApplyOriginalSize(text, close, out, info, err);
+        }
+
+        // Segment arrays placed into a zero-filled image of fileBytesSize bytes.
+        static bool DecodeSparse(std::string_view text, const Options& opt, std::vector<uint8_t>& out, DecodeInfo& info, std::wstring& err)
+        {
+            const size_t elemPos = text.find(ELEMENT_DECL);
+            const size_t sizePos = text.find(SIZE_DECL);
+            size_t totalBytes = 0u;
+            if (elemPos == std::string_view::npos || sizePos == std::string_view::npos ||
+                !ParseUnsigned(text.substr(sizePos + SIZE_DECL.size()), totalBytes))
+            {
+                err = L"Incomplete sparse header.";
+                return false;
+            }
+
+            const size_t elemEnd = text.find(';', elemPos);
+            Layout l;
+            if (!ParseLayout(text.substr(elemPos + ELEMENT_DECL.size(), elemEnd - elemPos - ELEMENT_DECL.size()), opt, l, err))
+                return false;
+            if (totalBytes % l.elemSize != 0u)
+            {
+                err = L"Sparse image size is not a whole number of elements.";
+                return false;
+            }
+
+            out.assign(totalBytes, 0u);
+            info.elementSize = l.elemSize;
+            info.elementCount = totalBytes / l.elemSize;
+
+            const size_t table = text.find(SEGMENT_TABLE_DECL);
+            if (table == std::string_view::npos)
+                return ApplyOriginalSize(text, sizePos, out, info, err);
+
+            const size_t tableEnd = text.find("};", table);
+            std::vector<uint8_t> segment;
+
+            // Rows read "{ offset, name, count },".
+            size_t row = text.find('{', table + SEGMENT_TABLE_DECL.size());
+            while (row != std::string_view::npos && row < tableEnd)
+            {
+                const size_t nameStart = text.find(", ", row);
+                const size_t nameEnd = (nameStart == std::string_view::npos) ? nameStart : text.find(',', nameStart + 2u);
+                size_t offset = 0u, count = 0u;
+                if (nameEnd == std::string_view::npos || !ParseUnsigned(text.substr(row + 2u), offset) ||
+                    !ParseUnsigned(text.substr(nameEnd + 2u), count))
+                {
+                    err = L"Malformed segment table.";
+                    return false;
+                }
+
+                const std::string decl = std::string(text.substr(nameStart + 2u, nameEnd - nameStart - 2u)) + "[] = {";
+                const size_t open = text.find(decl);
+                const size_t close = (open == std::string_view::npos) ? open : text.find("};", open);
+                if (close == std::string_view::npos)
+                {
+                    err = L"Missing segment array.";
+                    return false;
+                }
+
+                if (!DecodeInitializer(l, text.data() + open + decl.size(), text.data() + close, segment, err))
+                    return false;
+                if (segment.size() != count * l.elemSize || (offset + count) * l.elemSize > out.size())
+                {
+                    err = L"Segment does not match the segment table.";
+                    return false;
+                }
+
+                std::memcpy(out.data() + offset * l.elemSize, segment.data(), segment.size());
+                row = text.find('{', text.find('}', nameEnd));
+            }
+
+            return ApplyOriginalSize(text, tableEnd, out, info, err);
+        }
+    }
+
+    bool DecodeText(
+        std::string_view text,
+        const Options& opt,
+        std::vector<uint8_t>& out,
+        DecodeInfo& info,
+        std::wstring& err)
+    {
+        err.clear();
+        out.clear();
+        info = DecodeInfo{};
+
+        if (text.find(SEGMENT_COUNT_DECL) != std::string_view::npos)
+            return DecodeSparse(text, opt, out, info, err);
+        return DecodeDense(text, opt, out, info, err);
+    }
+
+    bool DecodeFile(
+        const std::wstring& path,
+        const Options& opt,
+        std::vector<uint8_t>& out,
+        DecodeInfo& info,
+        std::wstring& err)
+    {
+        FileIo::MappedInput input;
+        if (!FileIo::MapInputFile(path, input, err))
+            return false;
+
+        const std::string_view text(reinterpret_cast<const char*>(input.data()), input.size);
+        return DecodeText(text, opt, out, info, err);
+    }
+
+    bool CompareWithFile(const std::vector<uint8_t>& bytes, const std::wstring& path, std::wstring& err)
+    {
+        FileIo::MappedInput input;
+        if (!FileIo::MapInputFile(path, input, err))
+            return false;
+
+        const size_t common = std::min(bytes.size(), input.size);
+        const auto diff = std::mismatch(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(common), input.data());
+        const size_t at = static_cast<size_t>(diff.first - bytes.begin());
+
+        if (at == common && bytes.size() == input.size)
+            return true;
+
+        if (at == common)
+        {
+            err = L"Size mismatch: decoded " + std::to_wstring(bytes.size()) +
+                  L" bytes, reference has " + std::to_wstring(input.size) + L".";
+        }
+        else
+        {
+            err = L"Content mismatch at offset " + std::to_wstring(at) + L".";
+        }
+        return false;
+    }
+}
@@ -0,0 +1,47 @@
+// Decoder.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace EmbedPack::Decoder
+{
+    struct Options
+    {
+        // Generated text does not record the grouping of multi-byte elements; it has to match the
+        // byte order the header was produced with.
+        Converter::ByteOrder byteOrder = Converter::ByteOrder::LittleEndian;
+    };
+
+    struct DecodeInfo
+    {
+        size_t elementSize = 1u;
+        size_t elementCount = 0u;
+        bool hadPadding = false;
+    };
+
+    // Parses a header produced by the converter back into the original bytes. Tail padding is
+    // dropped when the header carries fileBytesOriginalSize; trimmed and sparse headers are
+    // expanded with the zeros they leave out.
+    bool DecodeText(
+        std::string_view text,
+        const Options& opt,
+        std::vector<uint8_t>& out,
+        DecodeInfo& info,
+        std::wstring& err);
+
+    bool DecodeFile(
+        const std::wstring& path,
+        const Options& opt,
+        std::vector<uint8_t>& out,
+        DecodeInfo& info,
+        std::wstring& err);
+
+    // Byte-for-byte comparison against a reference file; err names the first differing offset.
+    bool CompareWithFile(const std::vector<uint8_t>& bytes, const std::wstring& path, std::wstring& err);
+}
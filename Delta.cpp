@@ -0,0 +1,428 @@
+// Delta.cpp
+#include "Delta.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace EmbedPack::Delta
+{
+    namespace
+    {
+        constexpr uint32_t MIN_BLOCK = 8u;
+        constexpr uint32_t MAX_BLOCK = 4096u;
+
+        // Base blocks with the same hash tried per variant position; bounds the work on runs of
+        // identical blocks (zero fill, erased flash), where any of them matches equally well.
+        constexpr uint32_t MAX_CANDIDATES = 8u;
+
+        constexpr uint32_t HASH_MUL = 0x01000193u;
+        constexpr uint32_t NO_BLOCK = 0xFFFFFFFFu;
+
+        struct Op
+        {
+            bool copy;
+            size_t from; // base offset for a copy, variant offset for an insert
+            size_t length;
+        };
+
+        // Polynomial hash of a block; rolling it one byte costs a multiply and two adds.
+        static uint32_t BlockHash(const uint8_t* p, uint32_t block)
+        {
+            uint32_t h = 0u;
+            for (uint32_t i = 0u; i < block; ++i)
+                h = h * HASH_MUL + p[i];
+            return h;
+        }
+
+        static uint32_t Bucket(uint32_t h, uint32_t bits)
+        {
+            return (h * 0x9E3779B1u) >> (32u - bits);
+        }
+
+        static size_t MatchForward(const uint8_t* a, const uint8_t* b, size_t limit)
+        {
+            size_t n = 0u;
+            while (n + 8u <= limit)
+            {
+                uint64_t x, y;
+                std::memcpy(&x, a + n, 8u);
+                std::memcpy(&y, b + n, 8u);
+                if (x != y)
+                    break;
+                n += 8u;
+            }
+            while (n < limit && a[n] == b[n])
+                ++n;
+            return n;
+        }
+
+        static void PutVarint(uint64_t v, std::vector<uint8_t>& out)
+        {
+            while (v >= 0x80u)
+            {
+                out.push_back(static_cast<uint8_t>(v | 0x80u));
+                v >>= 7u;
+            }
+            out.push_back(static_cast<uint8_t>(v));
+        }
+
+        static bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+        {
+            v = 0u;
+            for (uint32_t shift = 0u; p != end && shift < 64u; shift += 7u)
+            {
+                const uint8_t b = *p++;
+                v |= static_cast<uint64_t>(b & 0x7Fu) << shift;
+                if (b < 0x80u)
+                    return true;
+            }
+            return false;
+        }
+
+        // Appends an op, merging it into the previous one when they are contiguous.
+        static void PushOp(std::vector<Op>& ops, const Op& op)
+        {
+            if (op.length == 0u)
+                return;
+            if (!ops.empty() && ops.back().copy == op.copy && ops.back().from + ops.back().length == op.from)
+            {
+                ops.back().length += op.length;
+                return;
+            }
+            ops.push_back(op);
+        }
+
+        // Must stay in step with Apply: the generated routine is the same loop.
+        static void AppendApply(bool stdArray, std::string& out)
+        {
+            out.append(
+                "// Rebuilds the variant into out (deltaVariantSize bytes) from the base the delta was made\r\n"
+                "// against; baseSize may include tail padding. Returns false for a base that is too short or\r\n"
+                "// a damaged op stream.\r\n"
+                "static inline bool deltaApply(const void* base, size_t baseSize, void* out) noexcept\r\n"
+                "{\r\n"
+                "    if (baseSize < deltaBaseSize)\r\n"
+                "        return false;\r\n"
+                "\r\n"
+                "    const unsigned char* op = reinterpret_cast<const unsigned char*>(");
+            out.append(stdArray ? "deltaOps.data()" : "deltaOps");
+            out.append(
+                ");\r\n"
+                "    const unsigned char* const opEnd = op + deltaOpsSize;\r\n"
+                "    const unsigned char* const src = static_cast<const unsigned char*>(base);\r\n"
+                "    unsigned char* dst = static_cast<unsigned char*>(out);\r\n"
+                "    size_t room = deltaVariantSize;\r\n"
+                "    uint64_t next = 0u;\r\n"
+                "\r\n"
+                "    const auto varint = [&](uint64_t& v) noexcept {\r\n"
+                "        v = 0u;\r\n"
+                "        for (unsigned shift = 0u; op != opEnd && shift < 64u; shift += 7u)\r\n"
+                "        {\r\n"
+                "            const unsigned char b = *op++;\r\n"
+                "            v |= static_cast<uint64_t>(b & 0x7Fu) << shift;\r\n"
+                "            if (b < 0x80u)\r\n"
+                "                return true;\r\n"
+                "        }\r\n"
+                "        return false;\r\n"
+                "    };\r\n"
+                "\r\n"
+                "    while (op != opEnd)\r\n"
+                "    {\r\n"
+                "        uint64_t tag = 0u;\r\n"
+                "        if (!varint(tag) || (tag >> 1) > room)\r\n"
+                "            return false;\r\n"
+                "        const size_t n = static_cast<size_t>(tag >> 1);\r\n"
+                "\r\n"
+                "        if (tag & 1u)\r\n"
+                "        {\r\n"
+                "            uint64_t zz = 0u;\r\n"
+                "            if (!varint(zz))\r\n"
+                "                return false;\r\n"
+                "            const uint64_t from = next + ((zz & 1u) ? ~(zz >> 1) : (zz >> 1));\r\n"
+                "            if (from > deltaBaseSize || n > deltaBaseSize - from)\r\n"
+                "                return false;\r\n"
+                "            std::memcpy(dst, src + from, n);\r\n"
+                "            next = from + n;\r\n"
+                "        }\r\n"
+                "        else\r\n"
+                "        {\r\n"
+                "            if (n > static_cast<size_t>(opEnd - op))\r\n"
+                "                return false;\r\n"
+                "            std::memcpy(dst, op, n);\r\n"
+                "            op += n;\r\n"
+                "        }\r\n"
+                "        dst += n;\r\n"
+                "        room -= n;\r\n"
+                "    }\r\n"
+                "    return room == 0u;\r\n"
+                "}\r\n");
+        }
+    }
+
+    bool Encode(
+        const uint8_t* base,
+        size_t baseSize,
+        const uint8_t* variant,
+        size_t variantSize,
+        uint32_t blockSize,
+        std::vector<uint8_t>& delta,
+        Summary& summary)
+    {
+        delta.clear();
+        summary = Summary{};
+        summary.baseBytes = baseSize;
+        summary.variantBytes = variantSize;
+
+        const uint32_t block = blockSize;
+        if (block < MIN_BLOCK || block > MAX_BLOCK || baseSize / block >= NO_BLOCK)
+            return false;
+
+        // Index every whole base block: a chained table of block numbers by hash.
+        const size_t blocks = baseSize / block;
+        uint32_t bits = 4u;
+        while (bits < 31u && (size_t{ 1 } << bits) < blocks * 2u)
+            ++bits;
+
+        std::vector<uint32_t> heads(size_t{ 1 } << bits, NO_BLOCK);
+        std::vector<uint32_t> chain(blocks, NO_BLOCK);
+        std::vector<uint32_t> hashes(blocks);
+        for (size_t b = blocks; b-- > 0u;)
+        {
+            const uint32_t h = BlockHash(base + b * block, block);
+            const uint32_t slot = Bucket(h, bits);
+            hashes[b] = h;
+            chain[b] = heads[slot];
+            heads[slot] = static_cast<uint32_t>(b);
+        }
+
+        // HASH_MUL^(block - 1), to take the outgoing byte off the rolling hash.
+        uint32_t outMul = 1u;
+        for (uint32_t i = 1u; i < block; ++i)
+            outMul *= HASH_MUL;
+
+        std::vector<Op> ops;
+        size_t pending = 0u;                 // start of the bytes not yet covered by an op
+        size_t baseNext = 0u, variantNext = 0u; // where the last copy ended in each file
+        size_t i = 0u;
+        uint32_t h = (variantSize >= block) ? BlockHash(variant, block) : 0u;
+
+        while (i + block <= variantSize)
+        {
+            size_t bestFrom = 0u, bestLength = 0u;
+
+            // An edit usually leaves the rest of the image where it was: try the position that
+            // continues the last copy before looking anything up.
+            const size_t expect = baseNext + (i - variantNext);
+            if (expect < baseSize)
+            {
+                const size_t n = MatchForward(base + expect, variant + i, std::min(baseSize - expect, variantSize - i));
+                if (n >= block)
+                {
+                    bestFrom = expect;
+                    bestLength = n;
+                }
+            }
+
+            if (bestLength == 0u)
+            {
+                uint32_t tried = 0u;
+                for (uint32_t b = heads[Bucket(h, bits)]; b != NO_BLOCK && tried < MAX_CANDIDATES; b = chain[b])
+                {
+                    if (hashes[b] != h)
+                        continue;
+                    ++tried;
+
+                    const size_t from = static_cast<size_t>(b) * block;
+                    const size_t n = MatchForward(base + from, variant + i, std::min(baseSize - from, variantSize - i));
+                    if (n >= block && n > bestLength)
+                    {
+                        bestFrom = from;
+                        bestLength = n;
+                    }
+                }
+            }
+
+            if (bestLength == 0u)
+            {
+                if (i + block == variantSize)
+                    break;
+                h = (h - variant[i] * outMul) * HASH_MUL + variant[i + block];
+                ++i;
+                continue;
+            }
+
+            // Grow the match back over bytes that would otherwise be inserted.
+            size_t back = 0u;
+            while (back < i - pending && back < bestFrom && variant[i - back - 1u] == base[bestFrom - back - 1u])
+                ++back;
+
+            PushOp(ops, Op{ false, pending, i - back - pending });
+            PushOp(ops, Op{ true, bestFrom - back, bestLength + back });
+
+            i += bestLength;
+            pending = i;
+            baseNext = bestFrom + bestLength;
+            variantNext = i;
+            if (i + block <= variantSize)
+                h = BlockHash(variant + i, block);
+        }
+        PushOp(ops, Op{ false, pending, variantSize - pending });
+
+        uint64_t next = 0u;
+        for (const Op& op : ops)
+        {
+            PutVarint((static_cast<uint64_t>(op.length) << 1u) | (op.copy ? 1u : 0u), delta);
+            if (op.copy)
+            {
+                const int64_t distance = static_cast<int64_t>(op.from - next);
+                PutVarint((static_cast<uint64_t>(distance) << 1u) ^ static_cast<uint64_t>(distance >> 63), delta);
+                next = op.from + op.length;
+                ++summary.copies;
+            }
+            else
+            {
+                delta.insert(delta.end(), variant + op.from, variant + op.from + op.length);
+                ++summary.inserts;
+                summary.insertedBytes += op.length;
+            }
+        }
+        summary.deltaBytes = delta.size();
+        return true;
+    }
+
+    bool Apply(const uint8_t* delta, size_t deltaSize, const uint8_t* base, size_t baseSize, std::vector<uint8_t>& out)
+    {
+        out.clear();
+        const uint8_t* p = delta;
+        const uint8_t* const end = delta + deltaSize;
+        uint64_t next = 0u;
+
+        while (p != end)
+        {
+            uint64_t tag = 0u;
+            if (!GetVarint(p, end, tag))
+                return false;
+            const uint64_t n = tag >> 1u;
+
+            if (tag & 1u)
+            {
+                uint64_t zz = 0u;
+                if (!GetVarint(p, end, zz))
+                    return false;
+                const uint64_t from = next + ((zz & 1u) ? ~(zz >> 1u) : (zz >> 1u));
+                if (from > baseSize || n > baseSize - from)
+                    return false;
+                out.insert(out.end(), base + from, base + from + n);
+                next = from + n;
+            }
+            else
+            {
+                if (n > static_cast<uint64_t>(end - p))
+                    return false;
+                out.insert(out.end(), p, p + n);
+                p += n;
+            }
+        }
+        return true;
+    }
+
+    bool WriteDelta(
+        const std::wstring& basePath,
+        const std::wstring& variantPath,
+        const std::wstring& outPath,
+        const Options& opt,
+        Summary& summary,
+        std::wstring& err)
+    {
+        const Converter::Format& fmt = opt.format;
+        if (fmt.elementType != Converter::ElementType::UnsignedChar && fmt.elementType != Converter::ElementType::Uint8 &&
+            fmt.elementType != Converter::ElementType::StdByte)
+        {
+            err = L"Deltas need a byte element type (uchar, uint8 or byte).";
+            return false;
+        }
+
+        if (opt.blockSize < MIN_BLOCK || opt.blockSize > MAX_BLOCK)
+        {
+            err = L"Invalid block size (expected 8 to 4096 bytes).";
+            return false;
+        }
+
+        FileIo::MappedInput base, variant;
+        if (!FileIo::MapInputFile(basePath, base, err) || !FileIo::MapInputFile(variantPath, variant, err))
+            return false;
+
+        if (variant.size == 0u)
+        {
+            err = L"The variant is empty.";
+            return false;
+        }
+
+        std::vector<uint8_t> delta;
+        if (!Encode(base.data(), base.size, variant.data(), variant.size, opt.blockSize, delta, summary))
+        {
+            err = L"The base is too large for this block size.";
+            return false;
+        }
+
+        // Cheap next to the encode, and a wrong header would only surface on the device.
+        std::vector<uint8_t> check;
+        if (!Apply(delta.data(), delta.size(), base.data(), base.size, check) || check.size() != variant.size ||
+            std::memcmp(check.data(), variant.data(), variant.size) != 0)
+        {
+            err = L"The delta failed to reproduce the variant.";
+            return false;
+        }
+
+        const bool stdArray = fmt.arrayStyle == Converter::ArrayStyle::ConstexprStdArray ||
+                              fmt.arrayStyle == Converter::ArrayStyle::StaticConstexprStdArray;
+
+        std::string out;
+        out.append("#include <cstddef>\r\n#include <cstdint>\r\n#include <cstring>\r\n");
+        if (stdArray)
+            out.append("#include <array>\r\n");
+        out.append("\r\n");
+        out.append(Converter::FormatPreamble(fmt));
+
+        if (!Converter::FormatArray("deltaOps", delta.data(), delta.size(), fmt, out, err))
+            return false;
+
+        char baseHash[19];
+        std::snprintf(baseHash, sizeof(baseHash), "0x%016llX", static_cast<unsigned long long>(Hashing::Xxh64(base.data(), base.size)));
+
+        out.append("constexpr size_t deltaOpsSize = ");
+        out.append(std::to_string(delta.size()));
+        out.append(";\r\nconstexpr size_t deltaBaseSize = ");
+        out.append(std::to_string(base.size));
+        out.append(";\r\nconstexpr size_t deltaVariantSize = ");
+        out.append(std::to_string(variant.size));
+        out.append(";\r\n// XXH64 of the base; compare with the base header's fileBytesXxh64 (--checksum xxh64).\r\n");
+        out.append("constexpr uint64_t deltaBaseXxh64 = ");
+        out.append(baseHash);
+        out.append("ull;\r\n\r\n");
+
+        AppendApply(stdArray, out);
+
+        FileIo::Handle h(CreateFileW(outPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!h.valid())
+        {
+            err = L"Failed to create output file.";
+            return false;
+        }
+
+        const char* p = out.data();
+        size_t remaining = out.size();
+        while (remaining > 0u)
+        {
+            const DWORD piece = static_cast<DWORD>(std::min<size_t>(remaining, 1u << 30));
+            if (!FileIo::WriteAll(h, p, piece, err))
+                return false;
+            p += piece;
+            remaining -= piece;
+        }
+        return true;
+    }
+}
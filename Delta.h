@@ -0,0 +1,57 @@
+// Delta.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Delta
+{
+    struct Options
+    {
+        // Only the byte element types are accepted; style, alignment, section and padding apply to
+        // the op array.
+        Converter::Format format{};
+        // Base blocks indexed for matching, in bytes: the shortest copy found by hashing. Smaller
+        // finds shorter matches at the cost of a larger index.
+        uint32_t blockSize = 32u;
+    };
+
+    struct Summary
+    {
+        uint64_t baseBytes = 0u;
+        uint64_t variantBytes = 0u;
+        uint64_t deltaBytes = 0u;
+        uint64_t copies = 0u;
+        uint64_t inserts = 0u;
+        uint64_t insertedBytes = 0u;
+    };
+
+    // The op stream: LEB128 tags of (length << 1) | copy. A copy is followed by the zigzag LEB128
+    // distance of its base offset from where the previous copy ended, an insert by its bytes.
+    // The variant is read once, front to back, matching base blocks with a rolling hash.
+    bool Encode(
+        const uint8_t* base,
+        size_t baseSize,
+        const uint8_t* variant,
+        size_t variantSize,
+        uint32_t blockSize,
+        std::vector<uint8_t>& delta,
+        Summary& summary);
+
+    // Reconstructs the variant the same way the generated deltaApply does; false when the stream
+    // is malformed or reads outside base.
+    bool Apply(const uint8_t* delta, size_t deltaSize, const uint8_t* base, size_t baseSize, std::vector<uint8_t>& out);
+
+    // One header: the op array, the base and variant sizes, the base's XXH64 and an inline
+    // deltaApply(base, baseSize, out) that rebuilds the variant from the separately embedded base.
+    bool WriteDelta(
+        const std::wstring& basePath,
+        const std::wstring& variantPath,
+        const std::wstring& outPath,
+        const Options& opt,
+        Summary& summary,
+        std::wstring& err);
+}
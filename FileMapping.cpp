@@ -0,0 +1,236 @@
+// FileMapping.cpp
+#include "FileMapping.h"
+#include "Tracing.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace EmbedPack::FileIo
+{
+    bool MapInputFile(const std::wstring& path, MappedInput& out, std::wstring& err, bool allowReplace)
+    {
+        out = MappedInput{};
+
+        out.file = Handle(CreateFileW(
+            path.c_str(),
+            GENERIC_READ,
+            allowReplace ? (FILE_SHARE_READ | FILE_SHARE_DELETE) : FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr));
+
+        if (!out.file.valid())
+        {
+            err = L"Failed to open the input file.";
+            return false;
+        }
+
+        LARGE_INTEGER liSize{};
+        if (!GetFileSizeEx(out.file, &liSize))
+        {
+            err = L"Failed to query input file size.";
+            return false;
+        }
+
+        if (liSize.QuadPart < 0)
+        {
+            err = L"Invalid input file size.";
+            return false;
+        }
+
+        const uint64_t fileSize64 = static_cast<uint64_t>(liSize.QuadPart);
+        if (fileSize64 > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+        {
+            err = L"File is too large for this process.";
+            return false;
+        }
+
+        out.size = static_cast<size_t>(fileSize64);
+
+        // CreateFileMapping rejects empty files; an empty input simply has no view.
+        if (out.size == 0u)
+            return true;
+
+        out.mapping = Handle(CreateFileMappingW(out.file, nullptr, PAGE_READONLY, 0u, 0u, nullptr));
+        if (!out.mapping.valid())
+        {
+            err = L"Failed to create file mapping.";
+            return false;
+        }
+
+        out.view = MappedView(MapViewOfFile(out.mapping, FILE_MAP_READ, 0u, 0u, 0u));
+        if (!out.view.valid())
+        {
+            err = L"Failed to map file view.";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool MapOutputFile(const std::wstring& path, uint64_t size, MappedOutput& out, std::wstring& err)
+    {
+        out = MappedOutput{};
+
+        if (size == 0u || size > static_cast<uint64_t>(std::numeric_limits<size_t>::max()))
+        {
+            err = L"Invalid output size for a mapped file.";
+            return false;
+        }
+
+        out.file = Handle(CreateFileW(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr));
+
+        if (!out.file.valid())
+        {
+            err = L"Failed to create output file.";
+            return false;
+        }
+
+        // Creating the section with the final size extends the file; nothing is written yet.
+        out.mapping = Handle(CreateFileMappingW(
+            out.file,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(size >> 32u),
+            static_cast<DWORD>(size & 0xFFFFFFFFu),
+            nullptr));
+        if (!out.mapping.valid())
+        {
+            err = L"Failed to create output file mapping.";
+            return false;
+        }
+
+        out.view = MappedView(MapViewOfFile(out.mapping, FILE_MAP_WRITE, 0u, 0u, 0u));
+        if (!out.view.valid())
+        {
+            err = L"Failed to map output file view.";
+            return false;
+        }
+
+        out.size = static_cast<size_t>(size);
+        return true;
+    }
+
+    ReadAhead::ReadAhead(const uint8_t* data, size_t size, size_t windowBytes, bool touchThread, uint64_t& requestedBytes)
+        : m_data(data), m_size(size), m_window(windowBytes), m_requestedBytes(requestedBytes)
+    {
+        if (m_window == 0u || m_data == nullptr)
+            return;
+
+        if (touchThread)
+            m_toucher = std::thread(&ReadAhead::TouchLoop, this);
+        Request(0u, m_window);
+    }
+
+    ReadAhead::~ReadAhead()
+    {
+        if (!m_toucher.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_toucher.join();
+    }
+
+    void ReadAhead::Advance(size_t offset)
+    {
+        if (m_window == 0u || m_requested == m_size)
+            return;
+
+        if (offset + m_window / 2u >= m_requested)
+            Request(std::max(offset, m_requested), offset + m_window);
+    }
+
+    void ReadAhead::Request(size_t begin, size_t end)
+    {
+        end = std::min(end, m_size);
+        if (begin >= end)
+            return;
+
+        // Only a hint: a failure (or an older system) just leaves the page faults in place.
+        WIN32_MEMORY_RANGE_ENTRY range{};
+        range.VirtualAddress = const_cast<uint8_t*>(m_data + begin);
+        range.NumberOfBytes = end - begin;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1u, &range, 0u);
+
+        m_requested = end;
+        m_requestedBytes += end - begin;
+
+        if (m_toucher.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_touchBegin = std::max(m_touchBegin, begin);
+                m_touchEnd = end;
+            }
+            m_cv.notify_one();
+        }
+    }
+
+    void ReadAhead::TouchLoop()
+    {
+        if (Trace::Enabled())
+            Trace::SetThreadName("read-ahead");
+
+        constexpr size_t PAGE = 4096u;
+        constexpr size_t BATCH = 1024u * 1024u;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_cv.wait(lock, [this] { return m_stop || m_touchBegin < m_touchEnd; });
+            if (m_stop)
+                return;
+
+            // Batches keep the lock free for Request and let the destructor stop a long run early.
+            const size_t begin = m_touchBegin;
+            const size_t end = std::min(m_touchEnd, begin + BATCH);
+            m_touchBegin = end;
+            lock.unlock();
+
+            {
+                Trace::Scope trace("touch ahead", end - begin);
+                uint8_t sink = 0u;
+                for (size_t at = begin; at < end; at += PAGE)
+                    sink = static_cast<uint8_t>(sink ^ *static_cast<const volatile uint8_t*>(m_data + at));
+                (void)sink;
+            }
+
+            lock.lock();
+        }
+    }
+
+    bool WriteAll(HANDLE h, const void* data, DWORD size, std::wstring& err)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        DWORD remaining = size;
+        while (remaining > 0u)
+        {
+            DWORD written = 0u;
+            if (!WriteFile(h, p, remaining, &written, nullptr))
+            {
+                err = L"Failed to write output file.";
+                return false;
+            }
+            if (written == 0u)
+            {
+                err = L"Failed to write output file (0 bytes written).";
+                return false;
+            }
+            p += written;
+            remaining -= written;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,145 @@
+// FileMapping.h
+#pragma once
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace EmbedPack::FileIo
+{
+    struct Handle final
+    {
+        HANDLE h = nullptr;
+
+        Handle() = default;
+        explicit Handle(HANDLE hh) : h(hh) {}
+
+        ~Handle()
+        {
+            if (h != nullptr && h != INVALID_HANDLE_VALUE)
+                CloseHandle(h);
+        }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        Handle(Handle&& o) noexcept : h(o.h) { o.h = nullptr; }
+        Handle& operator=(Handle&& o) noexcept
+        {
+            if (this != &o)
+            {
+                if (h != nullptr && h != INVALID_HANDLE_VALUE)
+                    CloseHandle(h);
+                h = o.h;
+                o.h = nullptr;
+            }
+            return *this;
+        }
+
+        bool valid() const noexcept { return (h != nullptr && h != INVALID_HANDLE_VALUE); }
+        operator HANDLE() const noexcept { return h; }
+    };
+
+    struct MappedView final
+    {
+        const void* p = nullptr;
+
+        MappedView() = default;
+        explicit MappedView(const void* pp) : p(pp) {}
+
+        ~MappedView()
+        {
+            if (p != nullptr)
+                UnmapViewOfFile(p);
+        }
+
+        MappedView(const MappedView&) = delete;
+        MappedView& operator=(const MappedView&) = delete;
+
+        MappedView(MappedView&& o) noexcept : p(o.p) { o.p = nullptr; }
+        MappedView& operator=(MappedView&& o) noexcept
+        {
+            if (this != &o)
+            {
+                if (p != nullptr)
+                    UnmapViewOfFile(p);
+                p = o.p;
+                o.p = nullptr;
+            }
+            return *this;
+        }
+
+        const void* get() const noexcept { return p; }
+        bool valid() const noexcept { return p != nullptr; }
+    };
+
+    // Read-only view of a whole input file. Empty files are valid and yield data() == nullptr.
+    struct MappedInput final
+    {
+        Handle file;
+        Handle mapping;
+        MappedView view;
+        size_t size = 0;
+
+        const uint8_t* data() const noexcept { return static_cast<const uint8_t*>(view.get()); }
+    };
+
+    // Writable view of a new output file of exactly size bytes (created or truncated).
+    struct MappedOutput final
+    {
+        Handle file;
+        Handle mapping;
+        MappedView view;
+        size_t size = 0;
+
+        uint8_t* data() const noexcept { return static_cast<uint8_t*>(const_cast<void*>(view.get())); }
+    };
+
+    // allowReplace also shares delete access, so the file can be deleted or renamed over while
+    // the view is held (the view keeps the old contents); writers are still refused.
+    bool MapInputFile(const std::wstring& path, MappedInput& out, std::wstring& err, bool allowReplace = false);
+    bool MapOutputFile(const std::wstring& path, uint64_t size, MappedOutput& out, std::wstring& err);
+
+    // Sequential read-ahead over a mapped input. The consumer reports its position through
+    // Advance; whenever it gets within half a window of the requested end, the next window is
+    // requested with PrefetchVirtualMemory, so the disk is read in large batches instead of one
+    // 4 KiB page fault at a time. With touchThread, a helper thread also faults the requested
+    // pages in, which moves the soft faults off the consumer. windowBytes == 0 disables it.
+    // requestedBytes accumulates the bytes handed to the prefetcher.
+    class ReadAhead final
+    {
+    public:
+        ReadAhead(const uint8_t* data, size_t size, size_t windowBytes, bool touchThread, uint64_t& requestedBytes);
+        ~ReadAhead();
+
+        ReadAhead(const ReadAhead&) = delete;
+        ReadAhead& operator=(const ReadAhead&) = delete;
+
+        void Advance(size_t offset);
+
+    private:
+        void Request(size_t begin, size_t end);
+        void TouchLoop();
+
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0u;
+        size_t m_window = 0u;
+        size_t m_requested = 0u;
+        uint64_t& m_requestedBytes;
+
+        std::thread m_toucher;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        size_t m_touchBegin = 0u;
+        size_t m_touchEnd = 0u;
+        bool m_stop = false;
+    };
+
+    bool WriteAll(HANDLE h, const void* data, DWORD size, std::wstring& err);
+}
@@ -0,0 +1,316 @@
+// Hashing.cpp
+#include "Hashing.h"
+
+#define NOMINMAX
+#include <windows.h>
+#include <bcrypt.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define EMBEDPACK_HASHING_CRC_HW 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define EMBEDPACK_TARGET_SSE42
+#else
+#include <cpuid.h>
+#define EMBEDPACK_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace EmbedPack::Hashing
+{
+    namespace
+    {
+        constexpr uint64_t XXH_PRIME1 = 11400714785074694791ull;
+        constexpr uint64_t XXH_PRIME2 = 14029467366897019727ull;
+        constexpr uint64_t XXH_PRIME3 = 1609587929392839161ull;
+        constexpr uint64_t XXH_PRIME4 = 9650029242287828579ull;
+        constexpr uint64_t XXH_PRIME5 = 2870177450012600261ull;
+
+        static inline uint64_t Rotl64(uint64_t v, unsigned r) noexcept
+        {
+            return (v << r) | (v >> (64u - r));
+        }
+
+        static inline uint64_t Read64(const uint8_t* p) noexcept
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static inline uint32_t Read32(const uint8_t* p) noexcept
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static inline uint64_t XxhRound(uint64_t acc, uint64_t input) noexcept
+        {
+            acc += input * XXH_PRIME2;
+            acc = Rotl64(acc, 31u);
+            return acc * XXH_PRIME1;
+        }
+
+        static inline uint64_t XxhMerge(uint64_t acc, uint64_t v) noexcept
+        {
+            acc ^= XxhRound(0u, v);
+            return acc * XXH_PRIME1 + XXH_PRIME4;
+        }
+
+        static inline uint64_t XxhConverge(const uint64_t v[4]) noexcept
+        {
+            uint64_t h = Rotl64(v[0], 1u) + Rotl64(v[1], 7u) + Rotl64(v[2], 12u) + Rotl64(v[3], 18u);
+            for (size_t i = 0u; i < 4u; ++i)
+                h = XxhMerge(h, v[i]);
+            return h;
+        }
+
+        // Mixes in the final (< 32) bytes and avalanches.
+        static uint64_t XxhFinish(uint64_t h, const uint8_t* p, const uint8_t* end) noexcept
+        {
+            for (; p + 8 <= end; p += 8)
+            {
+                h ^= XxhRound(0u, Read64(p));
+                h = Rotl64(h, 27u) * XXH_PRIME1 + XXH_PRIME4;
+            }
+
+            if (p + 4 <= end)
+            {
+                h ^= static_cast<uint64_t>(Read32(p)) * XXH_PRIME1;
+                h = Rotl64(h, 23u) * XXH_PRIME2 + XXH_PRIME3;
+                p += 4;
+            }
+
+            for (; p < end; ++p)
+            {
+                h ^= static_cast<uint64_t>(*p) * XXH_PRIME5;
+                h = Rotl64(h, 11u) * XXH_PRIME1;
+            }
+
+            h ^= h >> 33u;
+            h *= XXH_PRIME2;
+            h ^= h >> 29u;
+            h *= XXH_PRIME3;
+            h ^= h >> 32u;
+            return h;
+        }
+
+        // Reflected Castagnoli polynomial.
+        constexpr uint32_t CRC32C_POLY = 0x82F63B78u;
+
+        struct Crc32cTables
+        {
+            uint32_t t[8][256];
+
+            constexpr Crc32cTables() : t{}
+            {
+                for (uint32_t i = 0u; i < 256u; ++i)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = (c & 1u) ? (c >> 1u) ^ CRC32C_POLY : (c >> 1u);
+                    t[0][i] = c;
+                }
+                for (uint32_t i = 0u; i < 256u; ++i)
+                {
+                    for (size_t k = 1u; k < 8u; ++k)
+                        t[k][i] = (t[k - 1u][i] >> 8u) ^ t[0][t[k - 1u][i] & 0xFFu];
+                }
+            }
+        };
+
+        static constexpr Crc32cTables CRC32C_TABLES{};
+
+        static uint32_t Crc32cSoftware(uint32_t crc, const uint8_t* p, size_t size) noexcept
+        {
+            const auto& t = CRC32C_TABLES.t;
+            for (; size >= 8u; p += 8, size -= 8u)
+            {
+                const uint32_t lo = Read32(p) ^ crc;
+                const uint32_t hi = Read32(p + 4);
+                crc = t[7][lo & 0xFFu] ^ t[6][(lo >> 8u) & 0xFFu] ^ t[5][(lo >> 16u) & 0xFFu] ^ t[4][lo >> 24u] ^
+                      t[3][hi & 0xFFu] ^ t[2][(hi >> 8u) & 0xFFu] ^ t[1][(hi >> 16u) & 0xFFu] ^ t[0][hi >> 24u];
+            }
+            for (; size > 0u; ++p, --size)
+                crc = (crc >> 8u) ^ t[0][(crc ^ *p) & 0xFFu];
+            return crc;
+        }
+
+#if defined(EMBEDPACK_HASHING_CRC_HW)
+        static bool HasSse42() noexcept
+        {
+#if defined(_MSC_VER)
+            int regs[4]{};
+            __cpuid(regs, 1);
+            return (regs[2] & (1 << 20)) != 0;
+#else
+            unsigned eax = 0u, ebx = 0u, ecx = 0u, edx = 0u;
+            return __get_cpuid(1u, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 20u)) != 0u;
+#endif
+        }
+
+        EMBEDPACK_TARGET_SSE42
+        static uint32_t Crc32cHardware(uint32_t crc, const uint8_t* p, size_t size) noexcept
+        {
+            uint64_t c = crc;
+            for (; size >= 8u; p += 8, size -= 8u)
+                c = _mm_crc32_u64(c, Read64(p));
+
+            crc = static_cast<uint32_t>(c);
+            for (; size > 0u; ++p, --size)
+                crc = _mm_crc32_u8(crc, *p);
+            return crc;
+        }
+#endif
+    }
+
+    bool Sha256(const void* data, size_t size, Sha256Digest& out)
+    {
+        BCRYPT_ALG_HANDLE alg = nullptr;
+        if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&alg, BCRYPT_SHA256_ALGORITHM, nullptr, 0u)))
+            return false;
+
+        BCRYPT_HASH_HANDLE hash = nullptr;
+        bool ok = BCRYPT_SUCCESS(BCryptCreateHash(alg, &hash, nullptr, 0u, nullptr, 0u, 0u));
+
+        // BCryptHashData takes a ULONG length; feed large inputs in bounded pieces.
+        const auto* p = static_cast<const uint8_t*>(data);
+        size_t remaining = size;
+        while (ok && remaining > 0u)
+        {
+            const ULONG piece = static_cast<ULONG>(std::min<size_t>(remaining, 1u << 30));
+            ok = BCRYPT_SUCCESS(BCryptHashData(hash, const_cast<PUCHAR>(p), piece, 0u));
+            p += piece;
+            remaining -= piece;
+        }
+
+        if (ok)
+            ok = BCRYPT_SUCCESS(BCryptFinishHash(hash, out.data(), static_cast<ULONG>(out.size()), 0u));
+
+        if (hash)
+            BCryptDestroyHash(hash);
+        BCryptCloseAlgorithmProvider(alg, 0u);
+        return ok;
+    }
+
+    uint64_t Xxh64(const void* data, size_t size, uint64_t seed)
+    {
+        const auto* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + size;
+
+        uint64_t h;
+        if (size >= 32u)
+        {
+            uint64_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+            uint64_t v2 = seed + XXH_PRIME2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - XXH_PRIME1;
+
+            const uint8_t* const limit = end - 32;
+            do
+            {
+                v1 = XxhRound(v1, Read64(p));
+                v2 = XxhRound(v2, Read64(p + 8));
+                v3 = XxhRound(v3, Read64(p + 16));
+                v4 = XxhRound(v4, Read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            const uint64_t v[4] = { v1, v2, v3, v4 };
+            h = XxhConverge(v);
+        }
+        else
+        {
+            h = seed + XXH_PRIME5;
+        }
+
+        return XxhFinish(h + static_cast<uint64_t>(size), p, end);
+    }
+
+    Xxh64Stream::Xxh64Stream(uint64_t seed) noexcept
+        : m_acc{ seed + XXH_PRIME1 + XXH_PRIME2, seed + XXH_PRIME2, seed, seed - XXH_PRIME1 },
+          m_seed(seed),
+          m_buffer{}
+    {
+    }
+
+    void Xxh64Stream::Update(const void* data, size_t size) noexcept
+    {
+        const auto* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + size;
+        m_total += size;
+
+        if (m_buffered + size < 32u)
+        {
+            if (size != 0u)
+                std::memcpy(m_buffer + m_buffered, p, size);
+            m_buffered += size;
+            return;
+        }
+
+        if (m_buffered != 0u)
+        {
+            const size_t take = 32u - m_buffered;
+            std::memcpy(m_buffer + m_buffered, p, take);
+            p += take;
+            for (size_t i = 0u; i < 4u; ++i)
+                m_acc[i] = XxhRound(m_acc[i], Read64(m_buffer + i * 8u));
+            m_buffered = 0u;
+        }
+
+        uint64_t v1 = m_acc[0], v2 = m_acc[1], v3 = m_acc[2], v4 = m_acc[3];
+        for (; end - p >= 32; p += 32)
+        {
+            v1 = XxhRound(v1, Read64(p));
+            v2 = XxhRound(v2, Read64(p + 8));
+            v3 = XxhRound(v3, Read64(p + 16));
+            v4 = XxhRound(v4, Read64(p + 24));
+        }
+        m_acc[0] = v1;
+        m_acc[1] = v2;
+        m_acc[2] = v3;
+        m_acc[3] = v4;
+
+        m_buffered = static_cast<size_t>(end - p);
+        if (m_buffered != 0u)
+            std::memcpy(m_buffer, p, m_buffered);
+    }
+
+    uint64_t Xxh64Stream::Digest() const noexcept
+    {
+        const uint64_t h = (m_total >= 32u) ? XxhConverge(m_acc) : m_seed + XXH_PRIME5;
+        return XxhFinish(h + m_total, m_buffer, m_buffer + m_buffered);
+    }
+
+    uint32_t Crc32c(const void* data, size_t size, uint32_t crc)
+    {
+        const auto* p = static_cast<const uint8_t*>(data);
+        crc = ~crc;
+
+#if defined(EMBEDPACK_HASHING_CRC_HW)
+        static const bool hardware = HasSse42();
+        if (hardware)
+            return ~Crc32cHardware(crc, p, size);
+#endif
+        return ~Crc32cSoftware(crc, p, size);
+    }
+
+    std::string ToHex(const uint8_t* bytes, size_t size)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+
+        std::string s;
+        s.resize(size * 2u);
+        for (size_t i = 0u; i < size; ++i)
+        {
+            s[i * 2u]      = HEX[bytes[i] >> 4u];
+            s[i * 2u + 1u] = HEX[bytes[i] & 0x0Fu];
+        }
+        return s;
+    }
+}
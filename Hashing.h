@@ -0,0 +1,41 @@
+// Hashing.h
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace EmbedPack::Hashing
+{
+    using Sha256Digest = std::array<uint8_t, 32>;
+
+    bool Sha256(const void* data, size_t size, Sha256Digest& out);
+
+    // Non-cryptographic 64-bit hash (XXH64), for change detection where SHA-256 is too slow.
+    uint64_t Xxh64(const void* data, size_t size, uint64_t seed = 0u);
+
+    // Incremental XXH64; Digest() over any split of the input equals Xxh64() over the whole.
+    class Xxh64Stream final
+    {
+    public:
+        explicit Xxh64Stream(uint64_t seed = 0u) noexcept;
+
+        void Update(const void* data, size_t size) noexcept;
+        uint64_t Digest() const noexcept;
+
+    private:
+        uint64_t m_acc[4];
+        uint64_t m_seed;
+        uint64_t m_total = 0u;
+        uint8_t m_buffer[32];
+        size_t m_buffered = 0u;
+    };
+
+    // CRC-32C (Castagnoli). Pass the previous result as crc to continue over a split input.
+    // Uses the SSE4.2 crc32 instruction when the CPU has it, slicing-by-8 tables otherwise.
+    uint32_t Crc32c(const void* data, size_t size, uint32_t crc = 0u);
+
+    // Lowercase hex, two digits per byte.
+    std::string ToHex(const uint8_t* bytes, size_t size);
+}
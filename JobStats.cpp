@@ -0,0 +1,223 @@
+// JobStats.cpp
+#include "JobStats.h"
+#include "FileMapping.h"
+
+#include <psapi.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local uint64_t t_allocations = 0;
+    thread_local uint64_t t_allocatedBytes = 0;
+
+    void* CountedAlloc(size_t size)
+    {
+        ++t_allocations;
+        t_allocatedBytes += size;
+
+        if (void* p = std::malloc(size != 0u ? size : 1u))
+            return p;
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new(size_t size) { return CountedAlloc(size); }
+void* operator new[](size_t size) { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace EmbedPack::Stats
+{
+    namespace
+    {
+        static double FileTimeMs(const FILETIME& ft)
+        {
+            const uint64_t ticks = (static_cast<uint64_t>(ft.dwHighDateTime) << 32u) | ft.dwLowDateTime;
+            return static_cast<double>(ticks) / 10000.0;
+        }
+
+        // Input or output megabytes per second of a phase; 0 when the phase did not run.
+        static double Throughput(uint64_t bytes, double ms)
+        {
+            return (ms > 0.0) ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0;
+        }
+
+        static std::string Utf8(const std::wstring& s)
+        {
+            if (s.empty())
+                return {};
+
+            const int wlen = static_cast<int>(s.size());
+            const int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, nullptr, 0, nullptr, nullptr);
+            if (len <= 0)
+                return {};
+
+            std::string out(static_cast<size_t>(len), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, s.c_str(), wlen, &out[0], len, nullptr, nullptr);
+            return out;
+        }
+
+        static void AppendString(std::string& out, const std::wstring& value)
+        {
+            out.push_back('"');
+            for (const char ch : Utf8(value))
+            {
+                switch (ch)
+                {
+                case '"':  out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\r': out.append("\\r"); break;
+                case '\n': out.append("\\n"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20u)
+                    {
+                        char esc[8];
+                        std::snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned>(ch));
+                        out.append(esc);
+                    }
+                    else
+                    {
+                        out.push_back(ch);
+                    }
+                }
+            }
+            out.push_back('"');
+        }
+
+        static void AppendNumber(std::string& out, double value)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.3f", value);
+            out.append(buf);
+        }
+
+        static void AppendPhase(std::string& out, const char* name, double ms, uint64_t bytes, bool last = false)
+        {
+            out.append("    \"");
+            out.append(name);
+            out.append("\": { \"ms\": ");
+            AppendNumber(out, ms);
+            out.append(", \"mbps\": ");
+            AppendNumber(out, Throughput(bytes, ms));
+            out.append(last ? " }\n" : " },\n");
+        }
+    }
+
+    ThreadSample SampleThread()
+    {
+        ThreadSample s;
+        s.allocations = t_allocations;
+        s.allocatedBytes = t_allocatedBytes;
+
+        FILETIME created{}, exited{}, kernel{}, user{};
+        if (GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+            s.cpuMs = FileTimeMs(kernel) + FileTimeMs(user);
+        return s;
+    }
+
+    uint64_t PeakWorkingSetBytes()
+    {
+        PROCESS_MEMORY_COUNTERS pmc{};
+        pmc.cb = sizeof(pmc);
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            return 0u;
+        return static_cast<uint64_t>(pmc.PeakWorkingSetSize);
+    }
+
+    uint64_t PageFaultCount()
+    {
+        PROCESS_MEMORY_COUNTERS pmc{};
+        pmc.cb = sizeof(pmc);
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            return 0u;
+        return pmc.PageFaultCount;
+    }
+
+    std::string ToJson(const Converter::Job& job, const Converter::ConversionResult& r)
+    {
+        const Converter::ConversionStats& s = r.stats;
+
+        std::string out;
+        out.append("{\n  \"input\": ");
+        AppendString(out, job.inPath);
+        out.append(",\n  \"output\": ");
+        AppendString(out, job.outPath);
+        out.append(",\n  \"mode\": ");
+        out.append(job.largeMode ? "\"large\"" : "\"small\"");
+        out.append(",\n  \"incremental\": ");
+        out.append(job.incremental ? "true" : "false");
+        out.append(",\n  \"mappedOutput\": ");
+        out.append(job.mappedOutput ? "true" : "false");
+        out.append(",\n  \"ok\": ");
+        out.append(r.ok ? "true" : "false");
+        out.append(",\n  \"inputBytes\": ");
+        out.append(std::to_string(s.inputBytes));
+        out.append(",\n  \"sourceBytes\": ");
+        out.append(std::to_string(s.sourceBytes));
+        out.append(",\n  \"transforms\": \"");
+        out.append(Transform::Describe(job.transforms));
+        out.append("\"");
+        out.append(",\n  \"outputBytes\": ");
+        out.append(std::to_string(s.outputBytes));
+        out.append(",\n  \"elapsedMs\": ");
+        AppendNumber(out, s.elapsedMs);
+
+        // Input throughput for open/hash/format, output throughput for write/close. The transform
+        // phase is measured against the file as read.
+        out.append(",\n  \"phases\": {\n");
+        AppendPhase(out, "queue", s.queueMs, 0u);
+        AppendPhase(out, "open", s.openMs, s.sourceBytes ? s.sourceBytes : s.inputBytes);
+        AppendPhase(out, "transform", s.transformMs, s.sourceBytes);
+        AppendPhase(out, "hash", s.hashMs, s.inputBytes);
+        AppendPhase(out, "format", s.formatMs, s.inputBytes);
+        AppendPhase(out, "write", s.writeMs, s.outputBytes);
+        AppendPhase(out, "close", s.closeMs, s.outputBytes, true);
+        out.append("  },\n  \"allocations\": { \"count\": ");
+        out.append(std::to_string(s.allocations));
+        out.append(", \"bytes\": ");
+        out.append(std::to_string(s.allocatedBytes));
+        out.append(" },\n  \"peakWorkingSetBytes\": ");
+        out.append(std::to_string(s.peakWorkingSetBytes));
+        out.append(",\n  \"pageFaults\": ");
+        out.append(std::to_string(s.pageFaults));
+        out.append(",\n  \"readAheadBytes\": ");
+        out.append(std::to_string(s.readAheadBytes));
+
+        // CPU time of the worker thread over wall time: near 1 means CPU-bound, low values mean
+        // the job mostly waited on the disk.
+        out.append(",\n  \"thread\": { \"cpuMs\": ");
+        AppendNumber(out, s.cpuMs);
+        out.append(", \"utilization\": ");
+        AppendNumber(out, (s.elapsedMs > 0.0) ? s.cpuMs / s.elapsedMs : 0.0);
+        out.append(" },\n  \"blocks\": { \"total\": ");
+        out.append(std::to_string(s.blocksTotal));
+        out.append(", \"rewritten\": ");
+        out.append(std::to_string(s.blocksRewritten));
+        out.append(" }\n}\n");
+        return out;
+    }
+
+    bool WriteJson(const std::wstring& path, const Converter::Job& job, const Converter::ConversionResult& r, std::wstring& err)
+    {
+        const std::string json = ToJson(job, r);
+
+        FileIo::Handle h(CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!h.valid())
+        {
+            err = L"Failed to create stats file.";
+            return false;
+        }
+        return FileIo::WriteAll(h, json.data(), static_cast<DWORD>(json.size()), err);
+    }
+
+    std::wstring SidecarPath(const std::wstring& outPath)
+    {
+        return outPath + L".stats.json";
+    }
+}
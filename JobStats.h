@@ -0,0 +1,48 @@
+// JobStats.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace EmbedPack::Stats
+{
+    // Counters of the calling thread. Allocations are counted by the replaceable global
+    // operator new, so only C++ heap allocations are included.
+    struct ThreadSample
+    {
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        double cpuMs = 0.0;
+    };
+
+    ThreadSample SampleThread();
+    uint64_t PeakWorkingSetBytes();
+    // Process-wide; a job's delta includes faults of jobs running next to it.
+    uint64_t PageFaultCount();
+
+    // Adds the lifetime of the scope to a phase accumulator.
+    class ScopedPhase final
+    {
+    public:
+        explicit ScopedPhase(double& accMs) : m_acc(accMs), m_start(std::chrono::steady_clock::now()) {}
+        ~ScopedPhase()
+        {
+            m_acc += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+        ScopedPhase(const ScopedPhase&) = delete;
+        ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+    private:
+        double& m_acc;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    std::string ToJson(const Converter::Job& job, const Converter::ConversionResult& r);
+    bool WriteJson(const std::wstring& path, const Converter::Job& job, const Converter::ConversionResult& r, std::wstring& err);
+
+    std::wstring SidecarPath(const std::wstring& outPath);
+}
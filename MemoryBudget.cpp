@@ -0,0 +1,89 @@
+// MemoryBudget.cpp
+#include "MemoryBudget.h"
+#include "Tuning.h"
+
+#include <mutex>
+
+namespace EmbedPack::Memory
+{
+    namespace
+    {
+        static std::mutex g_mutex;
+        static uint64_t g_reserved = 0u;
+
+        static uint64_t AvailablePhysical()
+        {
+            MEMORYSTATUSEX ms{};
+            ms.dwLength = sizeof(ms);
+            return GlobalMemoryStatusEx(&ms) ? ms.ullAvailPhys : 0u;
+        }
+
+        static void Release(uint64_t bytes)
+        {
+            if (bytes == 0u)
+                return;
+
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_reserved -= bytes;
+        }
+    }
+
+    uint64_t Budget()
+    {
+        const uint64_t configured = Tuning::Active().memoryBudget;
+        return (configured != 0u) ? configured : AvailablePhysical() / 2u;
+    }
+
+    Reservation::~Reservation()
+    {
+        Release(m_bytes);
+    }
+
+    Reservation& Reservation::operator=(Reservation&& o) noexcept
+    {
+        if (this != &o)
+        {
+            Release(m_bytes);
+            m_bytes = o.m_bytes;
+            o.m_bytes = 0u;
+        }
+        return *this;
+    }
+
+    bool TryReserve(uint64_t textBytes, Reservation& out)
+    {
+        out = Reservation{};
+
+        // Outputs too large to count are certainly over budget.
+        if (textBytes > UINT64_MAX / IN_MEMORY_BYTES_PER_CHAR)
+            return false;
+        const uint64_t bytes = textBytes * IN_MEMORY_BYTES_PER_CHAR;
+
+        // Queried outside the lock; without a configured budget, memory the other reservations
+        // already use is missing from the available figure as well, which errs on spilling.
+        const uint64_t budget = Budget();
+
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (bytes > budget || g_reserved > budget - bytes)
+            return false;
+
+        g_reserved += bytes;
+        out.m_bytes = bytes;
+        return true;
+    }
+
+    bool CreateSpillFile(std::wstring& path, std::wstring& err)
+    {
+        wchar_t dir[MAX_PATH + 1]{};
+        const DWORD n = GetTempPathW(MAX_PATH + 1, dir);
+        wchar_t name[MAX_PATH]{};
+        if (n == 0u || n > MAX_PATH || GetTempFileNameW(dir, L"epk", 0u, name) == 0u)
+        {
+            err = L"Failed to create a temporary file for the output.";
+            return false;
+        }
+
+        path = name;
+        return true;
+    }
+}
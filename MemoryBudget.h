@@ -0,0 +1,45 @@
+// MemoryBudget.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace EmbedPack::Memory
+{
+    // Memory an in-memory output holds per character at its peak: the UTF-16 result plus the
+    // edit control's copy of it once the GUI shows it (the formatter's narrow text is gone by
+    // then, and dense outputs never hold more than one slice of it).
+    constexpr uint64_t IN_MEMORY_BYTES_PER_CHAR = 4u;
+
+    // Total in-memory outputs may hold at once: the tuning profile's memory_budget, or without
+    // one, half of the physical memory available at the time of the request.
+    uint64_t Budget();
+
+    // Memory set aside for one in-memory output; handed back when the reservation goes away.
+    class Reservation final
+    {
+    public:
+        Reservation() = default;
+        ~Reservation();
+
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+        Reservation(Reservation&& o) noexcept : m_bytes(o.m_bytes) { o.m_bytes = 0u; }
+        Reservation& operator=(Reservation&& o) noexcept;
+
+        uint64_t Bytes() const noexcept { return m_bytes; }
+
+    private:
+        friend bool TryReserve(uint64_t textBytes, Reservation& out);
+
+        uint64_t m_bytes = 0u;
+    };
+
+    // Reserves what an in-memory output of textBytes characters costs when that fits in the
+    // budget next to the reservations already held. False means the output should go to a
+    // spill file instead.
+    bool TryReserve(uint64_t textBytes, Reservation& out);
+
+    // Creates an empty file in the temp directory for an output that did not fit.
+    bool CreateSpillFile(std::wstring& path, std::wstring& err);
+}
@@ -0,0 +1,498 @@
+// Server.cpp
+#include "Server.h"
+#include "JobStats.h"
+
+#include <winsock2.h>
+#include <afunix.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace EmbedPack::Server
+{
+    namespace
+    {
+        // Every message is a FrameHeader and then `bytes` of payload. Both ends are the same
+        // EmbedPack build on the same machine, so integers and UTF-16 text go in native order.
+        enum class FrameKind : uint32_t
+        {
+            // Client: PROTOCOL_VERSION, the working directory, the argument count and arguments.
+            Request = 1,
+            // Server: text for the client's standard output and error streams.
+            Out,
+            Err,
+            // Server: the int32 exit code; always the last frame.
+            Exit
+        };
+
+        struct FrameHeader
+        {
+            uint32_t kind;
+            uint32_t bytes;
+        };
+
+        static constexpr uint32_t PROTOCOL_VERSION = 1u;
+        static constexpr uint32_t MAX_REQUEST_BYTES = 1u << 20;
+        // How often the accept loop looks at the stop event and trims the cache.
+        static constexpr long POLL_MS = 500;
+
+        class Socket final
+        {
+        public:
+            Socket() = default;
+            explicit Socket(SOCKET s) : m_s(s) {}
+
+            ~Socket()
+            {
+                if (valid())
+                    closesocket(m_s);
+            }
+
+            Socket(const Socket&) = delete;
+            Socket& operator=(const Socket&) = delete;
+
+            Socket(Socket&& o) noexcept : m_s(o.m_s) { o.m_s = INVALID_SOCKET; }
+            Socket& operator=(Socket&& o) noexcept
+            {
+                if (this != &o)
+                {
+                    if (valid())
+                        closesocket(m_s);
+                    m_s = o.m_s;
+                    o.m_s = INVALID_SOCKET;
+                }
+                return *this;
+            }
+
+            bool valid() const noexcept { return m_s != INVALID_SOCKET; }
+            operator SOCKET() const noexcept { return m_s; }
+
+        private:
+            SOCKET m_s = INVALID_SOCKET;
+        };
+
+        static bool StartWinsock()
+        {
+            static const bool started = [] {
+                WSADATA data{};
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+            return started;
+        }
+
+        static bool MakeAddress(const std::wstring& path, sockaddr_un& addr)
+        {
+            addr = {};
+            addr.sun_family = AF_UNIX;
+
+            const int wlen = static_cast<int>(path.size());
+            const int len = WideCharToMultiByte(CP_UTF8, 0, path.c_str(), wlen, nullptr, 0, nullptr, nullptr);
+            if (len <= 0 || static_cast<size_t>(len) >= sizeof(addr.sun_path))
+                return false;
+
+            WideCharToMultiByte(CP_UTF8, 0, path.c_str(), wlen, addr.sun_path, len, nullptr, nullptr);
+            return true;
+        }
+
+        static Socket Connect(const sockaddr_un& addr)
+        {
+            Socket s(socket(AF_UNIX, SOCK_STREAM, 0));
+            if (!s.valid() || connect(s, reinterpret_cast<const sockaddr*>(&addr), static_cast<int>(sizeof(addr))) != 0)
+                return Socket();
+            return s;
+        }
+
+        static bool SendAll(SOCKET s, const void* data, size_t size)
+        {
+            const char* p = static_cast<const char*>(data);
+            while (size > 0u)
+            {
+                const int n = send(s, p, static_cast<int>(std::min<size_t>(size, 1u << 20)), 0);
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        static bool RecvAll(SOCKET s, void* data, size_t size)
+        {
+            char* p = static_cast<char*>(data);
+            while (size > 0u)
+            {
+                const int n = recv(s, p, static_cast<int>(std::min<size_t>(size, 1u << 20)), 0);
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        static bool SendFrame(SOCKET s, FrameKind kind, const void* payload, size_t bytes)
+        {
+            const FrameHeader h{ static_cast<uint32_t>(kind), static_cast<uint32_t>(bytes) };
+            return SendAll(s, &h, sizeof(h)) && SendAll(s, payload, bytes);
+        }
+
+        static bool RecvFrame(SOCKET s, FrameHeader& h, std::vector<uint8_t>& payload, uint32_t maxBytes)
+        {
+            if (!RecvAll(s, &h, sizeof(h)) || h.bytes > maxBytes)
+                return false;
+            payload.resize(h.bytes);
+            return h.bytes == 0u || RecvAll(s, payload.data(), payload.size());
+        }
+
+        static std::wstring PayloadText(const std::vector<uint8_t>& payload)
+        {
+            std::wstring text(payload.size() / sizeof(wchar_t), L'\0');
+            if (!text.empty())
+                std::memcpy(&text[0], payload.data(), text.size() * sizeof(wchar_t));
+            return text;
+        }
+
+        static void PutU32(std::vector<uint8_t>& out, uint32_t v)
+        {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+            out.insert(out.end(), p, p + sizeof(v));
+        }
+
+        static void PutString(std::vector<uint8_t>& out, const std::wstring& s)
+        {
+            PutU32(out, static_cast<uint32_t>(s.size()));
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(s.data());
+            out.insert(out.end(), p, p + s.size() * sizeof(wchar_t));
+        }
+
+        struct PayloadReader
+        {
+            const uint8_t* p;
+            size_t left;
+
+            bool U32(uint32_t& v)
+            {
+                if (left < sizeof(v))
+                    return false;
+                std::memcpy(&v, p, sizeof(v));
+                p += sizeof(v);
+                left -= sizeof(v);
+                return true;
+            }
+
+            bool String(std::wstring& s)
+            {
+                uint32_t chars = 0u;
+                if (!U32(chars) || left / sizeof(wchar_t) < chars)
+                    return false;
+                s.assign(chars, L'\0');
+                if (chars != 0u)
+                    std::memcpy(&s[0], p, chars * sizeof(wchar_t));
+                p += chars * sizeof(wchar_t);
+                left -= chars * sizeof(wchar_t);
+                return true;
+            }
+        };
+
+        static std::vector<uint8_t> EncodeRequest(const Request& r)
+        {
+            std::vector<uint8_t> out;
+            PutU32(out, PROTOCOL_VERSION);
+            PutString(out, r.workingDir);
+            PutU32(out, static_cast<uint32_t>(r.argv.size()));
+            for (const std::wstring& a : r.argv)
+                PutString(out, a);
+            return out;
+        }
+
+        static bool DecodeRequest(const std::vector<uint8_t>& payload, Request& r, std::wstring& err)
+        {
+            PayloadReader in{ payload.data(), payload.size() };
+            uint32_t version = 0u;
+            uint32_t argc = 0u;
+            if (!in.U32(version) || version != PROTOCOL_VERSION)
+            {
+                err = L"The client and the server are different EmbedPack versions; restart the server.";
+                return false;
+            }
+            if (!in.String(r.workingDir) || !in.U32(argc) || argc > in.left / sizeof(uint32_t))
+            {
+                err = L"Malformed request.";
+                return false;
+            }
+
+            r.argv.resize(argc);
+            for (std::wstring& a : r.argv)
+            {
+                if (!in.String(a))
+                {
+                    err = L"Malformed request.";
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Reads one request, runs it on this thread and streams the reply. A client that goes
+        // away does not stop the request; its output is dropped.
+        static void ServeConnection(Socket client, const Handler& handler, Metrics& metrics, const TextFn& log)
+        {
+            // Closed without a word: a server starting at the same path checking for this one.
+            char first = 0;
+            if (recv(client, &first, 1, MSG_PEEK) == 0)
+                return;
+
+            FrameHeader h{};
+            std::vector<uint8_t> payload;
+            if (!RecvFrame(client, h, payload, MAX_REQUEST_BYTES) || h.kind != static_cast<uint32_t>(FrameKind::Request))
+            {
+                ++metrics.protocolErrors;
+                return;
+            }
+
+            Request request;
+            std::wstring err;
+            if (!DecodeRequest(payload, request, err))
+            {
+                ++metrics.protocolErrors;
+                const std::wstring text = L"ERROR: " + err + L"\r\n";
+                const int32_t code = 1;
+                if (SendFrame(client, FrameKind::Err, text.data(), text.size() * sizeof(wchar_t)))
+                    SendFrame(client, FrameKind::Exit, &code, sizeof(code));
+                return;
+            }
+
+            std::mutex sendMutex;
+            bool connected = true;
+            const auto reply = [&](FrameKind kind, const std::wstring& text) {
+                std::lock_guard<std::mutex> lock(sendMutex);
+                if (connected && !text.empty())
+                    connected = SendFrame(client, kind, text.data(), text.size() * sizeof(wchar_t));
+            };
+
+            ++metrics.requests;
+            ++metrics.active;
+            const auto start = std::chrono::steady_clock::now();
+
+            const int32_t code = handler(
+                request,
+                [&](const std::wstring& text) { reply(FrameKind::Out, text); },
+                [&](const std::wstring& text) { reply(FrameKind::Err, text); });
+
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            metrics.busyUs += static_cast<uint64_t>(us);
+            --metrics.active;
+            if (code != 0)
+                ++metrics.failed;
+
+            {
+                std::lock_guard<std::mutex> lock(sendMutex);
+                if (connected)
+                    SendFrame(client, FrameKind::Exit, &code, sizeof(code));
+            }
+
+            std::wstring line = request.argv.size() > 1u ? request.argv[1] : L"(empty)";
+            if (request.argv.size() > 2u)
+                line += L" " + request.argv[2];
+            log(line + L": exit " + std::to_wstring(code) + L" (" + std::to_wstring(us / 1000) + L" ms)");
+        }
+
+        static void AppendField(std::string& out, const char* name, uint64_t value, bool last = false)
+        {
+            out.append("\"");
+            out.append(name);
+            out.append("\": ");
+            out.append(std::to_string(value));
+            if (!last)
+                out.append(", ");
+        }
+    }
+
+    std::wstring DefaultSocketPath()
+    {
+        wchar_t buf[MAX_PATH];
+        DWORD n = GetEnvironmentVariableW(L"EMBEDPACK_SERVER", buf, MAX_PATH);
+        if (n > 0u && n < MAX_PATH)
+            return std::wstring(buf, n);
+
+        n = GetEnvironmentVariableW(L"LOCALAPPDATA", buf, MAX_PATH);
+        if (n == 0u || n >= MAX_PATH)
+            return {};
+        return std::wstring(buf, n) + L"\\EmbedPack\\server.sock";
+    }
+
+    bool Serve(const Options& opt, HANDLE stopEvent, const Handler& handler, Metrics& metrics, const TextFn& log, std::wstring& err)
+    {
+        sockaddr_un addr;
+        if (!StartWinsock())
+        {
+            err = L"Failed to initialize Winsock.";
+            return false;
+        }
+        if (!MakeAddress(opt.socketPath, addr))
+        {
+            err = L"The socket path is too long: " + opt.socketPath;
+            return false;
+        }
+        if (Connect(addr).valid())
+        {
+            err = L"A server is already listening on " + opt.socketPath + L".";
+            return false;
+        }
+
+        // The socket file outlives a server that did not shut down cleanly, and would make bind fail.
+        DeleteFileW(opt.socketPath.c_str());
+
+        Socket listener(socket(AF_UNIX, SOCK_STREAM, 0));
+        if (!listener.valid() ||
+            bind(listener, reinterpret_cast<const sockaddr*>(&addr), static_cast<int>(sizeof(addr))) != 0 ||
+            listen(listener, SOMAXCONN) != 0)
+        {
+            err = L"Failed to listen on " + opt.socketPath + L".";
+            return false;
+        }
+
+        struct Connection
+        {
+            std::thread thread;
+            std::atomic<bool> done{ false };
+        };
+        std::list<Connection> connections;
+
+        bool ok = true;
+        while (WaitForSingleObject(stopEvent, 0) != WAIT_OBJECT_0)
+        {
+            for (auto it = connections.begin(); it != connections.end();)
+            {
+                if (!it->done.load())
+                {
+                    ++it;
+                    continue;
+                }
+                it->thread.join();
+                it = connections.erase(it);
+            }
+
+            if (opt.cache != nullptr)
+                opt.cache->Trim();
+
+            if (connections.size() >= opt.maxConnections)
+            {
+                WaitForSingleObject(stopEvent, 10u);
+                continue;
+            }
+
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(listener, &readable);
+            timeval timeout{ 0, POLL_MS * 1000 };
+
+            const int ready = select(0, &readable, nullptr, nullptr, &timeout);
+            if (ready == SOCKET_ERROR)
+            {
+                err = L"Waiting for connections failed.";
+                ok = false;
+                break;
+            }
+            if (ready == 0)
+                continue;
+
+            Socket client(accept(listener, nullptr, nullptr));
+            if (!client.valid())
+                continue;
+
+            ++metrics.connections;
+            Connection& c = connections.emplace_back();
+            c.thread = std::thread([&handler, &metrics, &log, &c, s = std::move(client)]() mutable {
+                ServeConnection(std::move(s), handler, metrics, log);
+                c.done = true;
+            });
+        }
+
+        listener = Socket();
+        DeleteFileW(opt.socketPath.c_str());
+
+        for (Connection& c : connections)
+            c.thread.join();
+        return ok;
+    }
+
+    bool Forward(const std::wstring& socketPath, const Request& request, const TextFn& out, const TextFn& err, int& exitCode)
+    {
+        sockaddr_un addr;
+        if (!StartWinsock() || !MakeAddress(socketPath, addr))
+            return false;
+
+        Socket s = Connect(addr);
+        const std::vector<uint8_t> payload = EncodeRequest(request);
+        if (!s.valid() || !SendFrame(s, FrameKind::Request, payload.data(), payload.size()))
+            return false;
+
+        FrameHeader h{};
+        std::vector<uint8_t> reply;
+        while (RecvFrame(s, h, reply, UINT32_MAX))
+        {
+            switch (static_cast<FrameKind>(h.kind))
+            {
+            case FrameKind::Out:
+                out(PayloadText(reply));
+                break;
+            case FrameKind::Err:
+                err(PayloadText(reply));
+                break;
+            case FrameKind::Exit:
+                if (reply.size() != sizeof(int32_t))
+                    break;
+                int32_t code;
+                std::memcpy(&code, reply.data(), sizeof(code));
+                exitCode = code;
+                return true;
+            default:
+                break;
+            }
+        }
+
+        err(L"ERROR: The server closed the connection before the command finished.\r\n");
+        exitCode = 1;
+        return true;
+    }
+
+    std::string StatusJson(const Metrics& metrics, const CacheCounters& cache)
+    {
+        const auto uptime = std::chrono::steady_clock::now() - metrics.started;
+
+        std::string out;
+        out.append("{\n  ");
+        AppendField(out, "uptimeMs", static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(uptime).count()));
+        AppendField(out, "connections", metrics.connections.load());
+        AppendField(out, "protocolErrors", metrics.protocolErrors.load(), true);
+        out.append(",\n  \"requests\": { ");
+        AppendField(out, "total", metrics.requests.load());
+        AppendField(out, "active", metrics.active.load());
+        AppendField(out, "failed", metrics.failed.load());
+        AppendField(out, "busyMs", metrics.busyUs.load() / 1000u, true);
+        out.append(" },\n  \"mapped\": { ");
+        AppendField(out, "entries", cache.mappedInputs);
+        AppendField(out, "bytes", cache.mappedBytes);
+        AppendField(out, "hits", cache.mapHits);
+        AppendField(out, "misses", cache.mapMisses);
+        AppendField(out, "evictions", cache.evictions, true);
+        out.append(" },\n  \"hashes\": { ");
+        AppendField(out, "entries", cache.hashes);
+        AppendField(out, "hits", cache.hashHits);
+        AppendField(out, "misses", cache.hashMisses);
+        AppendField(out, "hashedBytes", cache.hashedBytes, true);
+        out.append(" },\n  \"results\": { ");
+        AppendField(out, "entries", cache.results);
+        AppendField(out, "upToDate", cache.upToDate, true);
+        out.append(" },\n  ");
+        AppendField(out, "peakWorkingSetBytes", Stats::PeakWorkingSetBytes(), true);
+        out.append("\n}\n");
+        return out;
+    }
+}
@@ -0,0 +1,66 @@
+// Server.h
+#pragma once
+
+#include "ServerCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Server
+{
+    // One command run on behalf of a client: the client's working directory (with a trailing
+    // separator) and the arguments it was started with.
+    struct Request
+    {
+        std::wstring workingDir;
+        std::vector<std::wstring> argv;
+    };
+
+    using TextFn = std::function<void(const std::wstring&)>;
+
+    // Runs a request inside the server. Text passed to out and err reaches the client as it is
+    // produced; the return value becomes the client's exit code.
+    using Handler = std::function<int(const Request& request, const TextFn& out, const TextFn& err)>;
+
+    // Live counters of a running server.
+    struct Metrics
+    {
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        std::atomic<uint64_t> connections{ 0 };
+        std::atomic<uint64_t> requests{ 0 };
+        std::atomic<uint64_t> failed{ 0 };
+        std::atomic<uint64_t> active{ 0 };
+        std::atomic<uint64_t> busyUs{ 0 };
+        std::atomic<uint64_t> protocolErrors{ 0 };
+    };
+
+    struct Options
+    {
+        std::wstring socketPath;
+        // Requests run at once, each on a connection thread; further clients wait in the listen
+        // backlog. Conversions from all of them share the converter's worker pool.
+        size_t maxConnections = 16u;
+        // Trimmed while the server waits for connections; may be null.
+        Cache* cache = nullptr;
+    };
+
+    // %EMBEDPACK_SERVER%, else %LOCALAPPDATA%\EmbedPack\server.sock; empty when neither is set.
+    std::wstring DefaultSocketPath();
+
+    // Listens on an AF_UNIX socket at opt.socketPath until stopEvent is signalled, then waits for
+    // the requests in flight. Fails when another server already answers at that path.
+    bool Serve(const Options& opt, HANDLE stopEvent, const Handler& handler, Metrics& metrics, const TextFn& log, std::wstring& err);
+
+    // Runs request in the server at socketPath, relaying its output, and returns true with the
+    // server's exit code. Returns false without anything having run when no server accepts the
+    // connection, so the caller can run the command itself. A connection lost part way is
+    // reported through err with exit code 1.
+    bool Forward(const std::wstring& socketPath, const Request& request, const TextFn& out, const TextFn& err, int& exitCode);
+
+    // The metrics and cache counters as JSON, for "EmbedPack status".
+    std::string StatusJson(const Metrics& metrics, const CacheCounters& cache);
+}
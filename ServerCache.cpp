@@ -0,0 +1,221 @@
+// ServerCache.cpp
+#include "ServerCache.h"
+#include "Hashing.h"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace EmbedPack::Server
+{
+    namespace
+    {
+        static uint64_t FileTimeValue(const FILETIME& ft)
+        {
+            return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+        }
+
+        // Paths reach the cache absolute; Windows compares them without regard to case.
+        static std::wstring PathKey(const std::wstring& path)
+        {
+            std::wstring key = path;
+            std::transform(key.begin(), key.end(), key.begin(), [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(static_cast<wint_t>(ch))); });
+            return key;
+        }
+
+        // The version of the file a mapping was made from, which may be newer than the one
+        // looked up by path just before.
+        static bool HandleVersion(HANDLE file, FileVersion& version)
+        {
+            BY_HANDLE_FILE_INFORMATION info{};
+            if (!GetFileInformationByHandle(file, &info))
+                return false;
+
+            version.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+            version.writeTime = FileTimeValue(info.ftLastWriteTime);
+            return true;
+        }
+    }
+
+    bool QueryVersion(const std::wstring& path, FileVersion& version)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA fad{};
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad))
+            return false;
+
+        version.size = (static_cast<uint64_t>(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+        version.writeTime = FileTimeValue(fad.ftLastWriteTime);
+        return true;
+    }
+
+    template <typename K, typename V>
+    V* Cache::Lru<K, V>::Find(const K& key)
+    {
+        const auto it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+
+        items.splice(items.begin(), items, it->second);
+        return &it->second->second;
+    }
+
+    template <typename K, typename V>
+    V& Cache::Lru<K, V>::Put(const K& key, V value)
+    {
+        const auto it = index.find(key);
+        if (it != index.end())
+        {
+            items.splice(items.begin(), items, it->second);
+            it->second->second = std::move(value);
+            return it->second->second;
+        }
+
+        items.emplace_front(key, std::move(value));
+        index.emplace(key, items.begin());
+        return items.front().second;
+    }
+
+    template <typename K, typename V>
+    void Cache::Lru<K, V>::Erase(typename List::iterator it)
+    {
+        index.erase(it->first);
+        items.erase(it);
+    }
+
+    void Cache::EraseMappedLocked(Lru<std::wstring, Mapped>::List::iterator it)
+    {
+        m_mappedBytes -= it->second.view->size;
+        m_mapped.Erase(it);
+        ++m_counters.evictions;
+    }
+
+    bool Cache::Acquire(const std::wstring& path, bool withHash, Input& out, std::wstring& err)
+    {
+        out = Input{};
+        const std::wstring key = PathKey(path);
+
+        FileVersion version;
+        const bool known = QueryVersion(path, version);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Mapped* m = known ? m_mapped.Find(key) : nullptr;
+            if (m != nullptr && m->version == version)
+            {
+                ++m_counters.mapHits;
+                m->lastUsed = Clock::now();
+                out.view = m->view;
+            }
+        }
+
+        if (!out.view)
+        {
+            auto input = std::make_shared<FileIo::MappedInput>();
+            if (!FileIo::MapInputFile(path, *input, err, true))
+                return false;
+            HandleVersion(input->file, version);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_counters.mapMisses;
+            if (Mapped* old = m_mapped.Find(key))
+                m_mappedBytes -= old->view->size;
+            m_mapped.Put(key, Mapped{ version, input, Clock::now() });
+            m_mappedBytes += input->size;
+
+            while (m_mapped.items.size() > m_limits.maxMapped || (m_mappedBytes > m_limits.maxMappedBytes && m_mapped.items.size() > 1u))
+                EraseMappedLocked(std::prev(m_mapped.items.end()));
+
+            out.view = std::move(input);
+        }
+
+        if (!withHash)
+            return true;
+
+        if (FindHash(path, version, out.hash))
+            return true;
+
+        // Outside the lock: other requests keep being served while a large input is read.
+        out.hash = Hashing::Xxh64(out.view->data(), out.view->size);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hashes.Put(key, Hashed{ version, out.hash });
+        if (m_hashes.items.size() > m_limits.maxHashes)
+            m_hashes.Erase(std::prev(m_hashes.items.end()));
+        m_counters.hashedBytes += out.view->size;
+        return true;
+    }
+
+    bool Cache::FindHash(const std::wstring& path, const FileVersion& version, uint64_t& hash)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const Hashed* h = m_hashes.Find(PathKey(path));
+        if (h == nullptr || h->version != version)
+        {
+            ++m_counters.hashMisses;
+            return false;
+        }
+
+        ++m_counters.hashHits;
+        hash = h->hash;
+        return true;
+    }
+
+    bool Cache::UpToDate(const std::string& request, uint64_t inputHash)
+    {
+        std::vector<std::pair<std::wstring, FileVersion>> outputs;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const Result* r = m_results.Find(request);
+            if (r == nullptr || r->inputHash != inputHash)
+                return false;
+            outputs = r->outputs;
+        }
+
+        for (const auto& o : outputs)
+        {
+            FileVersion now;
+            if (!QueryVersion(o.first, now) || now != o.second)
+                return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_counters.upToDate;
+        return true;
+    }
+
+    void Cache::Record(const std::string& request, uint64_t inputHash, const std::vector<std::wstring>& outputs)
+    {
+        Result r;
+        r.inputHash = inputHash;
+        for (const std::wstring& path : outputs)
+        {
+            FileVersion version;
+            if (!QueryVersion(path, version))
+                return;
+            r.outputs.emplace_back(path, version);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.Put(request, std::move(r));
+        if (m_results.items.size() > m_limits.maxResults)
+            m_results.Erase(std::prev(m_results.items.end()));
+    }
+
+    void Cache::Trim()
+    {
+        const Clock::time_point cutoff = Clock::now() - std::chrono::milliseconds(m_limits.keepMappedMs);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_mapped.items.empty() && m_mapped.items.back().second.lastUsed < cutoff)
+            EraseMappedLocked(std::prev(m_mapped.items.end()));
+    }
+
+    CacheCounters Cache::Counters() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        CacheCounters c = m_counters;
+        c.mappedInputs = m_mapped.items.size();
+        c.mappedBytes = m_mappedBytes;
+        c.hashes = m_hashes.items.size();
+        c.results = m_results.items.size();
+        return c;
+    }
+}
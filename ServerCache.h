@@ -0,0 +1,136 @@
+// ServerCache.h
+#pragma once
+
+#include "FileMapping.h"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EmbedPack::Server
+{
+    // A file version as the file system reports it; a different size or write time is a new version.
+    struct FileVersion
+    {
+        uint64_t size = 0u;
+        uint64_t writeTime = 0u;
+
+        bool operator==(const FileVersion& o) const noexcept { return size == o.size && writeTime == o.writeTime; }
+        bool operator!=(const FileVersion& o) const noexcept { return !(*this == o); }
+    };
+
+    bool QueryVersion(const std::wstring& path, FileVersion& version);
+
+    struct CacheCounters
+    {
+        uint64_t mapHits = 0u;
+        uint64_t mapMisses = 0u;
+        uint64_t hashHits = 0u;
+        uint64_t hashMisses = 0u;
+        uint64_t hashedBytes = 0u;
+        uint64_t upToDate = 0u;
+        uint64_t evictions = 0u;
+
+        uint64_t mappedInputs = 0u;
+        uint64_t mappedBytes = 0u;
+        uint64_t hashes = 0u;
+        uint64_t results = 0u;
+    };
+
+    // What a server keeps warm between requests: mapped views of recent inputs, XXH64 hashes of
+    // their contents by file version, and the hashes and output versions of recent successful
+    // requests, so repeating one whose input did not change costs an attribute lookup.
+    class Cache final
+    {
+    public:
+        struct Limits
+        {
+            size_t maxMapped = 64u;
+            uint64_t maxMappedBytes = 1ull << 30;
+            // A mapped input blocks writers of the file (renaming over it still works), so views
+            // unused for this long are released.
+            uint32_t keepMappedMs = 2000u;
+            size_t maxHashes = 4096u;
+            size_t maxResults = 4096u;
+        };
+
+        struct Input
+        {
+            std::shared_ptr<const FileIo::MappedInput> view;
+            uint64_t hash = 0u; // only when Acquire was asked for it
+        };
+
+        explicit Cache(const Limits& limits) : m_limits(limits) {}
+
+        Cache(const Cache&) = delete;
+        Cache& operator=(const Cache&) = delete;
+
+        // The mapped view of path, reused while the file's version is unchanged.
+        bool Acquire(const std::wstring& path, bool withHash, Input& out, std::wstring& err);
+
+        // The content hash recorded for path at version, without opening the file.
+        bool FindHash(const std::wstring& path, const FileVersion& version, uint64_t& hash);
+
+        // Whether request last succeeded on input contents hashing to inputHash, and every output
+        // it wrote still has the version it left behind.
+        bool UpToDate(const std::string& request, uint64_t inputHash);
+        void Record(const std::string& request, uint64_t inputHash, const std::vector<std::wstring>& outputs);
+
+        // Releases views idle for longer than keepMappedMs; the server calls it about once a second.
+        void Trim();
+
+        CacheCounters Counters() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Mapped
+        {
+            FileVersion version;
+            std::shared_ptr<const FileIo::MappedInput> view;
+            Clock::time_point lastUsed;
+        };
+
+        struct Hashed
+        {
+            FileVersion version;
+            uint64_t hash = 0u;
+        };
+
+        struct Result
+        {
+            uint64_t inputHash = 0u;
+            std::vector<std::pair<std::wstring, FileVersion>> outputs;
+        };
+
+        // Most recently used first, with an index into the list.
+        template <typename K, typename V>
+        struct Lru
+        {
+            using List = std::list<std::pair<K, V>>;
+
+            List items;
+            std::unordered_map<K, typename List::iterator> index;
+
+            V* Find(const K& key);
+            V& Put(const K& key, V value);
+            void Erase(typename List::iterator it);
+        };
+
+        void EraseMappedLocked(Lru<std::wstring, Mapped>::List::iterator it);
+
+        const Limits m_limits;
+
+        mutable std::mutex m_mutex;
+        Lru<std::wstring, Mapped> m_mapped;
+        uint64_t m_mappedBytes = 0u;
+        Lru<std::wstring, Hashed> m_hashes;
+        Lru<std::string, Result> m_results;
+        CacheCounters m_counters;
+    };
+}
@@ -0,0 +1,156 @@
+// TextRope.cpp
+#include "TextRope.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace EmbedPack::Text
+{
+    namespace
+    {
+        static constexpr size_t CHUNK_BYTES = Rope::CHUNK_CHARS * sizeof(wchar_t);
+        // 4 MiB of chunks stay cached between outputs; the rest go back to the heap.
+        static constexpr size_t CACHED_CHUNKS = 64u;
+
+        using ChunkCache = Threading::BlockCache<CHUNK_BYTES, CACHED_CHUNKS>;
+
+        static void* AllocChunk()
+        {
+            if (void* p = ChunkCache::Pop())
+                return p;
+            return ::operator new(CHUNK_BYTES);
+        }
+
+        static void FreeChunk(void* p) noexcept
+        {
+            if (!ChunkCache::Push(p))
+                ::operator delete(p);
+        }
+    }
+
+    Rope::~Rope()
+    {
+        Clear();
+    }
+
+    Rope::Rope(Rope&& o) noexcept
+        : m_chunks(std::move(o.m_chunks)), m_size(o.m_size)
+    {
+        o.m_chunks.clear();
+        o.m_size = 0u;
+    }
+
+    Rope& Rope::operator=(Rope&& o) noexcept
+    {
+        if (this != &o)
+        {
+            Clear();
+            m_chunks.swap(o.m_chunks);
+            m_size = o.m_size;
+            o.m_size = 0u;
+        }
+        return *this;
+    }
+
+    void Rope::Clear() noexcept
+    {
+        for (Chunk* c : m_chunks)
+            FreeChunk(c);
+        m_chunks.clear();
+        m_size = 0u;
+    }
+
+    wchar_t* Rope::Reserve(size_t& room)
+    {
+        const size_t used = m_size % CHUNK_CHARS;
+        if (m_size == m_chunks.size() * CHUNK_CHARS)
+            m_chunks.push_back(static_cast<Chunk*>(AllocChunk()));
+
+        room = CHUNK_CHARS - used;
+        return m_chunks.back()->chars + used;
+    }
+
+    void Rope::AppendAscii(const char* text, size_t count)
+    {
+        while (count != 0u)
+        {
+            size_t room = 0u;
+            wchar_t* dst = Reserve(room);
+            const size_t n = std::min(room, count);
+
+            for (size_t i = 0u; i < n; ++i)
+                dst[i] = static_cast<unsigned char>(text[i]);
+
+            text += n;
+            count -= n;
+            m_size += n;
+        }
+    }
+
+    void Rope::Append(const wchar_t* text, size_t count)
+    {
+        while (count != 0u)
+        {
+            size_t room = 0u;
+            wchar_t* dst = Reserve(room);
+            const size_t n = std::min(room, count);
+
+            std::memcpy(dst, text, n * sizeof(wchar_t));
+
+            text += n;
+            count -= n;
+            m_size += n;
+        }
+    }
+
+    size_t Rope::CopyTo(size_t pos, wchar_t* dst, size_t count) const noexcept
+    {
+        if (pos >= m_size)
+            return 0u;
+
+        count = std::min(count, m_size - pos);
+        size_t copied = 0u;
+        while (copied < count)
+        {
+            const size_t at = pos + copied;
+            const size_t offset = at % CHUNK_CHARS;
+            const size_t n = std::min(count - copied, CHUNK_CHARS - offset);
+
+            std::memcpy(dst + copied, m_chunks[at / CHUNK_CHARS]->chars + offset, n * sizeof(wchar_t));
+            copied += n;
+        }
+        return copied;
+    }
+
+    std::wstring Rope::Flatten() const
+    {
+        std::wstring s(m_size, L'\0');
+        if (m_size != 0u)
+            CopyTo(0u, &s[0], m_size);
+        return s;
+    }
+
+    size_t Rope::Reader::Read(void* dst, size_t bytes) noexcept
+    {
+        const size_t total = m_rope->Size() * sizeof(wchar_t);
+        uint8_t* out = static_cast<uint8_t*>(dst);
+
+        size_t copied = 0u;
+        while (copied < bytes && m_posBytes < total)
+        {
+            // Byte offsets, so a consumer asking for an odd count resumes mid-character.
+            const size_t chunk = m_posBytes / CHUNK_BYTES;
+            const size_t offset = m_posBytes % CHUNK_BYTES;
+            const size_t avail = std::min(CHUNK_BYTES - offset, total - m_posBytes);
+            const size_t n = std::min(bytes - copied, avail);
+
+            std::memcpy(out + copied, reinterpret_cast<const uint8_t*>(m_rope->ChunkData(chunk)) + offset, n);
+            copied += n;
+            m_posBytes += n;
+        }
+        return copied;
+    }
+}
@@ -0,0 +1,109 @@
+// TextRope.h
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Text
+{
+    // UTF-16 text held in fixed-size chunks instead of one contiguous buffer. Appending never
+    // moves what is already there, so building an output costs one chunk allocation per
+    // CHUNK_CHARS characters and peak memory is the text itself plus at most one partly filled
+    // chunk. Freed chunks go back to a process-wide cache for the next output.
+    class Rope final
+    {
+    public:
+        static constexpr size_t CHUNK_CHARS = 32u * 1024u;
+
+        Rope() = default;
+        ~Rope();
+
+        Rope(const Rope&) = delete;
+        Rope& operator=(const Rope&) = delete;
+        Rope(Rope&& o) noexcept;
+        Rope& operator=(Rope&& o) noexcept;
+
+        size_t Size() const noexcept { return m_size; }
+        bool Empty() const noexcept { return m_size == 0u; }
+
+        void Clear() noexcept;
+
+        // Widens ASCII text as it is copied in.
+        void AppendAscii(const char* text, size_t count);
+        void AppendAscii(const std::string& text) { AppendAscii(text.data(), text.size()); }
+        void Append(const wchar_t* text, size_t count);
+
+        size_t ChunkCount() const noexcept { return m_chunks.size(); }
+        const wchar_t* ChunkData(size_t i) const noexcept { return m_chunks[i]->chars; }
+        size_t ChunkSize(size_t i) const noexcept
+        {
+            return (i + 1u < m_chunks.size()) ? CHUNK_CHARS : m_size - i * CHUNK_CHARS;
+        }
+
+        // Copies up to count characters from pos on; returns how many were copied.
+        size_t CopyTo(size_t pos, wchar_t* dst, size_t count) const noexcept;
+
+        // One contiguous copy, for callers that need it; everything else reads chunk-wise.
+        std::wstring Flatten() const;
+
+        class const_iterator final
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = wchar_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const wchar_t*;
+            using reference = const wchar_t&;
+
+            const_iterator() = default;
+
+            reference operator*() const noexcept { return m_rope->m_chunks[m_pos / CHUNK_CHARS]->chars[m_pos % CHUNK_CHARS]; }
+            pointer operator->() const noexcept { return &**this; }
+
+            const_iterator& operator++() noexcept { ++m_pos; return *this; }
+            const_iterator operator++(int) noexcept { const_iterator t = *this; ++m_pos; return t; }
+
+            bool operator==(const const_iterator& o) const noexcept { return m_pos == o.m_pos; }
+            bool operator!=(const const_iterator& o) const noexcept { return m_pos != o.m_pos; }
+
+        private:
+            friend class Rope;
+            const_iterator(const Rope* rope, size_t pos) noexcept : m_rope(rope), m_pos(pos) {}
+
+            const Rope* m_rope = nullptr;
+            size_t m_pos = 0u;
+        };
+
+        const_iterator begin() const noexcept { return const_iterator(this, 0u); }
+        const_iterator end() const noexcept { return const_iterator(this, m_size); }
+
+        // Hands the text out in byte-sized pieces of whatever length the consumer asks for, as
+        // stream callbacks (EM_STREAMIN) want it. The rope must outlive the reader and stay
+        // unchanged while it is read.
+        class Reader final
+        {
+        public:
+            explicit Reader(const Rope& rope) noexcept : m_rope(&rope) {}
+
+            // Returns the bytes copied; 0 at the end of the text.
+            size_t Read(void* dst, size_t bytes) noexcept;
+
+        private:
+            const Rope* m_rope;
+            size_t m_posBytes = 0u;
+        };
+
+    private:
+        struct Chunk
+        {
+            wchar_t chars[CHUNK_CHARS];
+        };
+
+        wchar_t* Reserve(size_t& room);
+
+        std::vector<Chunk*> m_chunks;
+        size_t m_size = 0u;
+    };
+}
@@ -0,0 +1,124 @@
+// TextScan.cpp
+#include "TextScan.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define EMBEDPACK_TEXTSCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace EmbedPack::TextScan
+{
+    namespace
+    {
+        static inline bool IsTextAscii(uint8_t b) noexcept
+        {
+            return (b >= 0x20u && b < 0x7Fu) || b == '\t' || b == '\n' || b == '\r';
+        }
+
+        // Validates one character starting at data[i] and advances i past it.
+        static bool Step(const uint8_t* data, size_t size, size_t& i) noexcept
+        {
+            const uint8_t b = data[i];
+            if (b < 0x80u)
+            {
+                ++i;
+                return IsTextAscii(b);
+            }
+
+            // Second-byte ranges exclude overlong forms, surrogates and code points past U+10FFFF.
+            size_t extra = 0u;
+            uint8_t lo = 0x80u, hi = 0xBFu;
+            if (b >= 0xC2u && b <= 0xDFu)
+                extra = 1u;
+            else if (b >= 0xE0u && b <= 0xEFu)
+            {
+                extra = 2u;
+                if (b == 0xE0u)
+                    lo = 0xA0u;
+                else if (b == 0xEDu)
+                    hi = 0x9Fu;
+            }
+            else if (b >= 0xF0u && b <= 0xF4u)
+            {
+                extra = 3u;
+                if (b == 0xF0u)
+                    lo = 0x90u;
+                else if (b == 0xF4u)
+                    hi = 0x8Fu;
+            }
+            else
+                return false;
+
+            if (size - i <= extra)
+                return false;
+
+            const uint8_t second = data[i + 1u];
+            if (second < lo || second > hi)
+                return false;
+            for (size_t k = 2u; k <= extra; ++k)
+            {
+                if ((data[i + k] & 0xC0u) != 0x80u)
+                    return false;
+            }
+
+            i += extra + 1u;
+            return true;
+        }
+
+#if defined(EMBEDPACK_TEXTSCAN_SSE2)
+        // Bit per byte: set for bytes >= 0x80 in high, for disallowed ASCII bytes in bad.
+        static inline void Classify(const uint8_t* p, int& high, int& bad) noexcept
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+            // Signed compare: bytes >= 0x80 are negative and land in ctrl as well; high masks
+            // them back out.
+            const __m128i ctrl = _mm_cmplt_epi8(v, _mm_set1_epi8(0x20));
+            const __m128i allowed = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+            const __m128i del = _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F));
+
+            high = _mm_movemask_epi8(v);
+            bad = _mm_movemask_epi8(_mm_or_si128(_mm_andnot_si128(allowed, ctrl), del)) & ~high;
+        }
+#endif
+    }
+
+    bool IsText(const uint8_t* data, size_t size)
+    {
+        if (size == 0u)
+            return false;
+
+        size_t i = 0u;
+#if defined(EMBEDPACK_TEXTSCAN_SSE2)
+        while (size - i >= 16u)
+        {
+            int high = 0, bad = 0;
+            Classify(data + i, high, bad);
+            if (bad != 0)
+                return false;
+            if (high == 0)
+            {
+                i += 16u;
+                continue;
+            }
+
+            // Multi-byte characters: validate them one by one to the end of this block; the last
+            // one may run into the next.
+            const size_t blockEnd = i + 16u;
+            while (i < blockEnd)
+            {
+                if (!Step(data, size, i))
+                    return false;
+            }
+        }
+#endif
+        while (i < size)
+        {
+            if (!Step(data, size, i))
+                return false;
+        }
+        return true;
+    }
+}
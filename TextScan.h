@@ -0,0 +1,14 @@
+// TextScan.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace EmbedPack::TextScan
+{
+    // True for non-empty, well-formed UTF-8 whose only control characters are tab, LF and CR:
+    // inputs that can be embedded as a string literal. Pure ASCII runs are checked 16 bytes at a
+    // time; the scan stops at the first byte that rules the input out, which for binary data is
+    // usually within the first few lines.
+    bool IsText(const uint8_t* data, size_t size);
+}
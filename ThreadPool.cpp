@@ -0,0 +1,104 @@
+// ThreadPool.cpp
+#include "ThreadPool.h"
+#include "Tracing.h"
+
+#include <algorithm>
+
+namespace EmbedPack::Threading
+{
+    ThreadPool::ThreadPool(size_t maxConcurrent, size_t queueCapacity)
+        : m_capacity(std::max<size_t>(1u, queueCapacity))
+    {
+        const size_t workers = std::max<size_t>(1u, maxConcurrent);
+        m_workers.reserve(workers);
+        for (size_t i = 0u; i < workers; ++i)
+            m_workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        Shutdown(ShutdownMode::Drain);
+    }
+
+    bool ThreadPool::Submit(Task* task, Priority priority)
+    {
+        if (task == nullptr)
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping || m_queued >= m_capacity)
+                return false;
+
+            m_queues[static_cast<size_t>(priority)].push_back(task);
+            ++m_queued;
+        }
+
+        m_cv.notify_one();
+        return true;
+    }
+
+    void ThreadPool::Shutdown(ShutdownMode mode)
+    {
+        std::vector<Task*> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+
+            if (mode == ShutdownMode::Cancel)
+            {
+                m_cancel.store(true, std::memory_order_relaxed);
+                while (Task* t = PopLocked())
+                    dropped.push_back(t);
+            }
+        }
+
+        m_cv.notify_all();
+
+        for (Task* t : dropped)
+            t->Discard();
+
+        for (auto& w : m_workers)
+        {
+            if (w.joinable())
+                w.join();
+        }
+        m_workers.clear();
+    }
+
+    Task* ThreadPool::PopLocked()
+    {
+        for (size_t p = std::size(m_queues); p-- > 0u;)
+        {
+            auto& q = m_queues[p];
+            if (!q.empty())
+            {
+                Task* t = q.front();
+                q.pop_front();
+                --m_queued;
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    void ThreadPool::WorkerLoop(size_t index)
+    {
+        Trace::SetThreadName("pool worker " + std::to_string(index + 1u));
+
+        for (;;)
+        {
+            Task* task = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this] { return m_stopping || m_queued != 0u; });
+
+                task = PopLocked();
+                if (task == nullptr)
+                    return;
+            }
+
+            task->Run(m_cancel);
+        }
+    }
+}
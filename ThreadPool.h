@@ -0,0 +1,216 @@
+// ThreadPool.h
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EmbedPack::Threading
+{
+    enum class Priority : uint8_t
+    {
+        Low = 0,
+        Normal,
+        High
+    };
+
+    enum class ShutdownMode : uint8_t
+    {
+        Drain = 0,
+        Cancel
+    };
+
+    // Combines the pool-wide cancel flag with an optional per-job flag.
+    struct CancelToken
+    {
+        const std::atomic<bool>* pool = nullptr;
+        const std::atomic<bool>* job = nullptr;
+
+        bool IsSet() const noexcept
+        {
+            return (pool && pool->load(std::memory_order_relaxed)) ||
+                   (job && job->load(std::memory_order_relaxed));
+        }
+    };
+
+    class Task
+    {
+    public:
+        virtual ~Task() = default;
+
+        // Runs on a pool worker; long-running tasks poll `cancelled` and stop early when it is set.
+        virtual void Run(const std::atomic<bool>& cancelled) = 0;
+
+        // Called instead of Run when the task is dropped from the queue by Shutdown(Cancel).
+        virtual void Discard() = 0;
+    };
+
+    class ThreadPool final
+    {
+    public:
+        ThreadPool(size_t maxConcurrent, size_t queueCapacity);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Returns false when the queue is full or the pool is shutting down; ownership of the
+        // task stays with the caller in that case.
+        bool Submit(Task* task, Priority priority);
+
+        void Shutdown(ShutdownMode mode);
+
+        size_t WorkerCount() const noexcept { return m_workers.size(); }
+        bool CancelRequested() const noexcept { return m_cancel.load(std::memory_order_relaxed); }
+
+    private:
+        void WorkerLoop(size_t index);
+        Task* PopLocked();
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<Task*> m_queues[3];
+        std::vector<std::thread> m_workers;
+
+        size_t m_capacity = 0;
+        size_t m_queued = 0;
+        bool m_stopping = false;
+        std::atomic<bool> m_cancel{ false };
+    };
+
+    // Fixed-capacity free list of pre-constructed objects; Acquire returns nullptr when exhausted.
+    template <typename T>
+    class ObjectPool final
+    {
+    public:
+        explicit ObjectPool(size_t capacity)
+            : m_slots(capacity)
+        {
+            m_free.reserve(capacity);
+            for (auto& slot : m_slots)
+                m_free.push_back(&slot);
+        }
+
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        T* Acquire()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_free.empty())
+                return nullptr;
+
+            T* p = m_free.back();
+            m_free.pop_back();
+            return p;
+        }
+
+        void Release(T* p)
+        {
+            if (p == nullptr)
+                return;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(p);
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<T> m_slots;
+        std::vector<T*> m_free;
+    };
+
+    // Keeps up to MaxCached freed blocks of one size class for reuse.
+    template <size_t BlockSize, size_t MaxCached>
+    class BlockCache final
+    {
+    public:
+        static void* Pop()
+        {
+            BlockCache& c = Instance();
+            std::lock_guard<std::mutex> lock(c.m_mutex);
+            if (c.m_blocks.empty())
+                return nullptr;
+
+            void* p = c.m_blocks.back();
+            c.m_blocks.pop_back();
+            return p;
+        }
+
+        static bool Push(void* p)
+        {
+            BlockCache& c = Instance();
+            std::lock_guard<std::mutex> lock(c.m_mutex);
+            if (c.m_blocks.size() >= MaxCached)
+                return false;
+
+            c.m_blocks.push_back(p);
+            return true;
+        }
+
+    private:
+        BlockCache() { m_blocks.reserve(MaxCached); }
+
+        ~BlockCache()
+        {
+            for (void* p : m_blocks)
+                ::operator delete(p);
+        }
+
+        static BlockCache& Instance()
+        {
+            static BlockCache cache;
+            return cache;
+        }
+
+        std::mutex m_mutex;
+        std::vector<void*> m_blocks;
+    };
+
+    // Allocator for std::allocate_shared: single-object allocations are recycled through a
+    // BlockCache, so steady-state job submission does not touch the heap.
+    template <typename T, size_t MaxCached = 64u>
+    struct RecyclingAllocator
+    {
+        using value_type = T;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = RecyclingAllocator<U, MaxCached>;
+        };
+
+        RecyclingAllocator() noexcept = default;
+
+        template <typename U>
+        RecyclingAllocator(const RecyclingAllocator<U, MaxCached>&) noexcept {}
+
+        T* allocate(size_t n)
+        {
+            if (n == 1u)
+            {
+                if (void* p = BlockCache<sizeof(T), MaxCached>::Pop())
+                    return static_cast<T*>(p);
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept
+        {
+            if (n == 1u && BlockCache<sizeof(T), MaxCached>::Push(p))
+                return;
+            ::operator delete(p);
+        }
+
+        template <typename U>
+        bool operator==(const RecyclingAllocator<U, MaxCached>&) const noexcept { return true; }
+
+        template <typename U>
+        bool operator!=(const RecyclingAllocator<U, MaxCached>&) const noexcept { return false; }
+    };
+}
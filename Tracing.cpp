@@ -0,0 +1,194 @@
+// Tracing.cpp
+#include "Tracing.h"
+#include "FileMapping.h"
+
+#include <psapi.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace EmbedPack::Trace
+{
+    namespace
+    {
+        // Bounds memory if tracing is left on for a long watch session.
+        constexpr size_t MAX_EVENTS_PER_THREAD = 1u << 20;
+
+        struct Event
+        {
+            const char* name;
+            char phase; // 'X' complete span, 'C' counter
+            int64_t ts;
+            int64_t dur;
+            uint64_t value;
+        };
+
+        // One per thread that ever recorded. The owning thread appends under an uncontended lock;
+        // the exporter takes the same lock, so buffers can be written while jobs still run.
+        struct ThreadBuffer
+        {
+            DWORD tid = 0u;
+            std::string name;
+            std::mutex mutex;
+            std::vector<Event> events;
+            uint64_t dropped = 0u;
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        };
+
+        static Registry& GetRegistry()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        thread_local ThreadBuffer* t_buffer = nullptr;
+
+        static ThreadBuffer& LocalBuffer()
+        {
+            if (t_buffer == nullptr)
+            {
+                auto b = std::make_unique<ThreadBuffer>();
+                b->tid = GetCurrentThreadId();
+
+                Registry& r = GetRegistry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                t_buffer = b.get();
+                r.buffers.push_back(std::move(b));
+            }
+            return *t_buffer;
+        }
+
+        static void Record(const Event& e)
+        {
+            ThreadBuffer& b = LocalBuffer();
+            std::lock_guard<std::mutex> lock(b.mutex);
+            if (b.events.size() >= MAX_EVENTS_PER_THREAD)
+            {
+                ++b.dropped;
+                return;
+            }
+            b.events.push_back(e);
+        }
+
+        static void AppendEscaped(std::string& out, const char* s)
+        {
+            for (; *s; ++s)
+            {
+                if (*s == '"' || *s == '\\')
+                    out.push_back('\\');
+                if (static_cast<unsigned char>(*s) >= 0x20u)
+                    out.push_back(*s);
+            }
+        }
+
+        static void AppendEvent(std::string& out, const Event& e, DWORD tid)
+        {
+            out.append(",\n{\"name\":\"");
+            AppendEscaped(out, e.name);
+            out.append("\",\"cat\":\"embedpack\",\"ph\":\"");
+            out.push_back(e.phase);
+            out.append("\",\"ts\":");
+            out.append(std::to_string(e.ts));
+            if (e.phase == 'X')
+            {
+                out.append(",\"dur\":");
+                out.append(std::to_string(e.dur));
+            }
+            out.append(",\"pid\":1,\"tid\":");
+            out.append(std::to_string(tid));
+            out.append(e.phase == 'C' ? ",\"args\":{\"value\":" : ",\"args\":{\"bytes\":");
+            out.append(std::to_string(e.value));
+            out.append("}}");
+        }
+    }
+
+    void Enable(bool on)
+    {
+        NowUs(); // pins the epoch before the first event
+        detail::g_enabled.store(on, std::memory_order_relaxed);
+    }
+
+    int64_t ToUs(std::chrono::steady_clock::time_point t) noexcept
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch).count();
+    }
+
+    void SetThreadName(const std::string& name)
+    {
+        ThreadBuffer& b = LocalBuffer();
+        std::lock_guard<std::mutex> lock(b.mutex);
+        b.name = name;
+    }
+
+    void Complete(const char* name, int64_t startUs, int64_t endUs, uint64_t bytes)
+    {
+        if (Enabled())
+            Record({ name, 'X', startUs, endUs - startUs, bytes });
+    }
+
+    void Counter(const char* name, uint64_t value)
+    {
+        if (Enabled())
+            Record({ name, 'C', NowUs(), 0, value });
+    }
+
+    void SamplePageFaults()
+    {
+        if (!Enabled())
+            return;
+
+        PROCESS_MEMORY_COUNTERS pmc{};
+        pmc.cb = sizeof(pmc);
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+            Counter("page faults", pmc.PageFaultCount);
+    }
+
+    bool WriteJson(const std::wstring& path, std::wstring& err)
+    {
+        std::string out;
+        out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        out.append("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"EmbedPack\"}}");
+
+        {
+            Registry& r = GetRegistry();
+            std::lock_guard<std::mutex> registryLock(r.mutex);
+            for (const auto& b : r.buffers)
+            {
+                std::lock_guard<std::mutex> lock(b->mutex);
+
+                const std::string name = b->name.empty() ? "thread " + std::to_string(b->tid) : b->name;
+                out.append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+                out.append(std::to_string(b->tid));
+                out.append(",\"args\":{\"name\":\"");
+                AppendEscaped(out, name.c_str());
+                out.append("\"}}");
+
+                for (const Event& e : b->events)
+                    AppendEvent(out, e, b->tid);
+
+                if (b->dropped != 0u)
+                {
+                    const Event e{ "dropped events", 'C', b->events.empty() ? 0 : b->events.back().ts, 0, b->dropped };
+                    AppendEvent(out, e, b->tid);
+                }
+            }
+        }
+
+        out.append("\n]}\n");
+
+        FileIo::Handle h(CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (!h.valid())
+        {
+            err = L"Failed to create trace file.";
+            return false;
+        }
+        return FileIo::WriteAll(h, out.data(), static_cast<DWORD>(out.size()), err);
+    }
+}
@@ -0,0 +1,59 @@
+// Tracing.h
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace EmbedPack::Trace
+{
+    namespace detail
+    {
+        inline std::atomic<bool> g_enabled{ false };
+    }
+
+    // Off by default; every recording call is a single relaxed load while disabled.
+    inline bool Enabled() noexcept { return detail::g_enabled.load(std::memory_order_relaxed); }
+    void Enable(bool on);
+
+    // Microseconds on the steady clock, relative to the first use in the process.
+    int64_t ToUs(std::chrono::steady_clock::time_point t) noexcept;
+    inline int64_t NowUs() noexcept { return ToUs(std::chrono::steady_clock::now()); }
+
+    void SetThreadName(const std::string& name);
+
+    // name must be a string literal (or otherwise outlive the trace); it is stored by pointer.
+    void Complete(const char* name, int64_t startUs, int64_t endUs, uint64_t bytes = 0u);
+    void Counter(const char* name, uint64_t value);
+
+    // Process page-fault count as a counter track, so faults on the mapped input line up with
+    // the format spans that caused them.
+    void SamplePageFaults();
+
+    class Scope final
+    {
+    public:
+        explicit Scope(const char* name, uint64_t bytes = 0u) noexcept
+            : m_name(Enabled() ? name : nullptr), m_bytes(bytes), m_start(m_name ? NowUs() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (m_name)
+                Complete(m_name, m_start, NowUs(), m_bytes);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_bytes;
+        int64_t m_start;
+    };
+
+    // Chrome/Perfetto trace-event JSON of everything recorded so far, all threads.
+    bool WriteJson(const std::wstring& path, std::wstring& err);
+}
@@ -0,0 +1,518 @@
+// Transform.cpp
+#include "Transform.h"
+
+#include <algorithm>
+
+namespace EmbedPack::Transform
+{
+    namespace
+    {
+        static bool IsBlank(uint8_t c) { return c == ' ' || c == '\t'; }
+        static bool IsSpace(uint8_t c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v'; }
+
+        static bool IsWord(uint8_t c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80u;
+        }
+
+        // Operator characters that can combine with a neighbour into another token (a - -b, a / *p).
+        static bool IsJoiningOperator(uint8_t c)
+        {
+            switch (c)
+            {
+            case '+': case '-': case '*': case '/': case '%': case '<': case '>':
+            case '=': case '!': case '&': case '|': case '^': case '.': case '#':
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        class LineEndingStage final : public Stage
+        {
+        public:
+            explicit LineEndingStage(bool crlf) : m_crlf(crlf) {}
+
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                for (size_t i = 0u; i < size; ++i)
+                {
+                    const uint8_t c = data[i];
+                    if (m_pendingCr)
+                    {
+                        m_pendingCr = false;
+                        Eol(out);
+                        if (c == '\n')
+                            continue;
+                    }
+
+                    if (c == '\r')
+                        m_pendingCr = true;
+                    else if (c == '\n')
+                        Eol(out);
+                    else
+                        out.push_back(c);
+                }
+            }
+
+            void Finish(std::vector<uint8_t>& out) override
+            {
+                if (m_pendingCr)
+                    Eol(out);
+                m_pendingCr = false;
+            }
+
+        private:
+            void Eol(std::vector<uint8_t>& out) const
+            {
+                if (m_crlf)
+                    out.push_back('\r');
+                out.push_back('\n');
+            }
+
+            bool m_crlf;
+            // A CR at the end of one piece may be the first half of a CRLF split across two.
+            bool m_pendingCr = false;
+        };
+
+        class StripTrailingStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                for (size_t i = 0u; i < size; ++i)
+                {
+                    const uint8_t c = data[i];
+                    if (IsBlank(c))
+                    {
+                        m_blank.push_back(c);
+                        continue;
+                    }
+
+                    if (c != '\r' && c != '\n')
+                        out.insert(out.end(), m_blank.begin(), m_blank.end());
+                    m_blank.clear();
+                    out.push_back(c);
+                }
+            }
+
+            void Finish(std::vector<uint8_t>&) override { m_blank.clear(); }
+
+        private:
+            // The current run of blanks; it is only written once something other than a line
+            // break follows it.
+            std::vector<uint8_t> m_blank;
+        };
+
+        class StripCommentsStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                for (size_t i = 0u; i < size; ++i)
+                    Step(data[i], out);
+            }
+
+            void Finish(std::vector<uint8_t>& out) override
+            {
+                if (m_state == State::Slash)
+                    Emit('/', out);
+                m_state = State::Code;
+                m_spaceOwed = false;
+            }
+
+        private:
+            enum class State : uint8_t { Code, Slash, Line, Block, BlockStar, Literal, Escape };
+
+            void Emit(uint8_t c, std::vector<uint8_t>& out)
+            {
+                out.push_back(c);
+                m_last = c;
+            }
+
+            void Step(uint8_t c, std::vector<uint8_t>& out)
+            {
+                switch (m_state)
+                {
+                case State::Code:
+                    // The space a block comment left is dropped next to whitespace that separates
+                    // the tokens anyway.
+                    if (m_spaceOwed)
+                    {
+                        m_spaceOwed = false;
+                        if (c != '/' && !IsSpace(c) && m_last != 0u && !IsSpace(m_last))
+                            Emit(' ', out);
+                    }
+
+                    if (c == '/')
+                        m_state = State::Slash;
+                    else
+                    {
+                        if (c == '"' || c == '\'')
+                        {
+                            m_quote = c;
+                            m_state = State::Literal;
+                        }
+                        Emit(c, out);
+                    }
+                    return;
+
+                case State::Slash:
+                    if (c == '/')
+                    {
+                        m_state = State::Line;
+                        return;
+                    }
+                    if (c == '*')
+                    {
+                        m_state = State::Block;
+                        return;
+                    }
+                    Emit('/', out);
+                    m_state = State::Code;
+                    Step(c, out);
+                    return;
+
+                case State::Line:
+                    if (c == '\r' || c == '\n')
+                    {
+                        m_state = State::Code;
+                        Emit(c, out);
+                    }
+                    return;
+
+                case State::Block:
+                    if (c == '*')
+                        m_state = State::BlockStar;
+                    return;
+
+                case State::BlockStar:
+                    if (c == '/')
+                    {
+                        m_state = State::Code;
+                        m_spaceOwed = true;
+                    }
+                    else if (c != '*')
+                        m_state = State::Block;
+                    return;
+
+                case State::Literal:
+                    Emit(c, out);
+                    if (c == '\\')
+                        m_state = State::Escape;
+                    else if (c == m_quote || c == '\n')
+                        m_state = State::Code;
+                    return;
+
+                case State::Escape:
+                    Emit(c, out);
+                    m_state = State::Literal;
+                    return;
+                }
+            }
+
+            State m_state = State::Code;
+            uint8_t m_quote = 0u;
+            uint8_t m_last = 0u;
+            bool m_spaceOwed = false;
+        };
+
+        class MinifyJsonStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                for (size_t i = 0u; i < size; ++i)
+                {
+                    const uint8_t c = data[i];
+                    if (m_escape)
+                        m_escape = false;
+                    else if (m_inString)
+                    {
+                        if (c == '\\')
+                            m_escape = true;
+                        else if (c == '"')
+                            m_inString = false;
+                    }
+                    else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+                        continue;
+                    else if (c == '"')
+                        m_inString = true;
+
+                    out.push_back(c);
+                }
+            }
+
+        private:
+            bool m_inString = false;
+            bool m_escape = false;
+        };
+
+        // Runs after comment stripping. Outside directives a run of whitespace disappears unless
+        // the tokens on either side would otherwise merge; inside a directive it becomes one space,
+        // since there it can matter (#define F(x) against #define F (x)).
+        class CollapseGlslStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                for (size_t i = 0u; i < size; ++i)
+                {
+                    const uint8_t c = data[i];
+                    // CR counts as a blank, so CRLF sources come out with LF line breaks.
+                    if (c == '\n')
+                    {
+                        // A backslash continues the directive onto the next line.
+                        if (m_directive && m_last == '\\')
+                        {
+                            Emit('\n', out);
+                            m_spaceOwed = false;
+                            continue;
+                        }
+                        if (m_directive)
+                        {
+                            m_directive = false;
+                            m_newlineOwed = true;
+                        }
+                        m_spaceOwed = true;
+                        m_lineStart = true;
+                        continue;
+                    }
+
+                    if (IsSpace(c))
+                    {
+                        m_spaceOwed = true;
+                        continue;
+                    }
+
+                    if (c == '#' && m_lineStart)
+                    {
+                        if (m_last != 0u && m_last != '\n')
+                            Emit('\n', out);
+                        m_newlineOwed = false;
+                        m_spaceOwed = false;
+                        m_directive = true;
+                    }
+                    else if (m_newlineOwed)
+                    {
+                        Emit('\n', out);
+                        m_newlineOwed = false;
+                    }
+                    else if (m_spaceOwed && m_last != 0u && m_last != '\n' && NeedsSpace(c))
+                        Emit(' ', out);
+
+                    m_spaceOwed = false;
+                    m_lineStart = false;
+                    Emit(c, out);
+                }
+            }
+
+            void Finish(std::vector<uint8_t>& out) override
+            {
+                // Keeps the last directive terminated.
+                if (m_newlineOwed || m_directive)
+                    Emit('\n', out);
+                m_newlineOwed = false;
+                m_directive = false;
+            }
+
+        private:
+            bool NeedsSpace(uint8_t next) const
+            {
+                if (m_directive)
+                    return true;
+                // "return .5" must not become "return.5"; a '.' after a word may start a number.
+                return (IsWord(m_last) && (IsWord(next) || next == '.')) || (IsJoiningOperator(m_last) && IsJoiningOperator(next));
+            }
+
+            void Emit(uint8_t c, std::vector<uint8_t>& out)
+            {
+                out.push_back(c);
+                m_last = c;
+            }
+
+            uint8_t m_last = 0u;
+            bool m_lineStart = true;
+            bool m_directive = false;
+            bool m_spaceOwed = false;
+            bool m_newlineOwed = false;
+        };
+
+        class MinifyGlslStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                m_code.clear();
+                m_comments.Process(data, size, m_code);
+                m_collapse.Process(m_code.data(), m_code.size(), out);
+            }
+
+            void Finish(std::vector<uint8_t>& out) override
+            {
+                m_code.clear();
+                m_comments.Finish(m_code);
+                m_collapse.Process(m_code.data(), m_code.size(), out);
+                m_collapse.Finish(out);
+            }
+
+        private:
+            StripCommentsStage m_comments;
+            CollapseGlslStage m_collapse;
+            std::vector<uint8_t> m_code;
+        };
+
+        class NulTerminateStage final : public Stage
+        {
+        public:
+            void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) override
+            {
+                out.insert(out.end(), data, data + size);
+            }
+
+            void Finish(std::vector<uint8_t>& out) override { out.push_back(0u); }
+        };
+
+        struct NamedKind
+        {
+            const char* name;
+            Kind kind;
+        };
+
+        static constexpr NamedKind kKinds[] = {
+            { "lf",             Kind::Lf },
+            { "crlf",           Kind::Crlf },
+            { "strip-trailing", Kind::StripTrailing },
+            { "strip-comments", Kind::StripComments },
+            { "minify-json",    Kind::MinifyJson },
+            { "minify-glsl",    Kind::MinifyGlsl },
+            { "nul",            Kind::NulTerminate },
+        };
+    }
+
+    std::unique_ptr<Stage> CreateStage(Kind kind)
+    {
+        switch (kind)
+        {
+        case Kind::Lf:            return std::make_unique<LineEndingStage>(false);
+        case Kind::Crlf:          return std::make_unique<LineEndingStage>(true);
+        case Kind::StripTrailing: return std::make_unique<StripTrailingStage>();
+        case Kind::StripComments: return std::make_unique<StripCommentsStage>();
+        case Kind::MinifyJson:    return std::make_unique<MinifyJsonStage>();
+        case Kind::MinifyGlsl:    return std::make_unique<MinifyGlslStage>();
+        case Kind::NulTerminate:  return std::make_unique<NulTerminateStage>();
+        }
+        return nullptr;
+    }
+
+    const char* KindName(Kind kind)
+    {
+        for (const NamedKind& k : kKinds)
+        {
+            if (k.kind == kind)
+                return k.name;
+        }
+        return "?";
+    }
+
+    bool ParseSpec(const std::wstring& list, Spec& spec, std::wstring& err)
+    {
+        size_t pos = 0u;
+        while (pos <= list.size())
+        {
+            size_t end = list.find(L',', pos);
+            if (end == std::wstring::npos)
+                end = list.size();
+            const std::wstring name = list.substr(pos, end - pos);
+            pos = end + 1u;
+
+            const auto* match = std::find_if(std::begin(kKinds), std::end(kKinds), [&](const NamedKind& k) {
+                return name == std::wstring(k.name, k.name + std::char_traits<char>::length(k.name));
+            });
+            if (match == std::end(kKinds))
+            {
+                err = L"Unknown transform '" + name + L"' (expected lf, crlf, strip-trailing, strip-comments, "
+                      L"minify-json, minify-glsl or nul).";
+                return false;
+            }
+            spec.push_back(match->kind);
+        }
+        return true;
+    }
+
+    std::string Describe(const Spec& spec)
+    {
+        std::string out;
+        for (const Kind kind : spec)
+        {
+            if (!out.empty())
+                out.push_back(',');
+            out.append(KindName(kind));
+        }
+        return out;
+    }
+
+    Pipeline::Pipeline(const Spec& spec)
+    {
+        for (const Kind kind : spec)
+            Add(CreateStage(kind));
+    }
+
+    void Pipeline::Add(std::unique_ptr<Stage> stage)
+    {
+        if (!stage)
+            return;
+
+        m_stages.push_back(std::move(stage));
+        m_scratch.emplace_back();
+    }
+
+    // Feeds one piece to stage first and what comes out of it on through the rest; the last
+    // stage appends to out.
+    void Pipeline::Push(size_t first, const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+    {
+        if (first == m_stages.size())
+        {
+            out.insert(out.end(), data, data + size);
+            return;
+        }
+
+        for (size_t i = first; i < m_stages.size(); ++i)
+        {
+            if (i + 1u == m_stages.size())
+            {
+                m_stages[i]->Process(data, size, out);
+                return;
+            }
+
+            std::vector<uint8_t>& next = m_scratch[i];
+            next.clear();
+            m_stages[i]->Process(data, size, next);
+            data = next.data();
+            size = next.size();
+        }
+    }
+
+    bool Pipeline::Run(const uint8_t* data, size_t size, const Threading::CancelToken& cancel, std::vector<uint8_t>& out)
+    {
+        out.clear();
+        out.reserve(size + 1u);
+
+        for (size_t offset = 0u; offset < size; offset += CHUNK_BYTES)
+        {
+            if (cancel.IsSet())
+                return false;
+            Push(0u, data + offset, std::min(CHUNK_BYTES, size - offset), out);
+        }
+
+        // Whatever a stage held back at the end still goes through the stages after it.
+        std::vector<uint8_t> tail;
+        for (size_t i = 0u; i < m_stages.size(); ++i)
+        {
+            tail.clear();
+            m_stages[i]->Finish(tail);
+            Push(i + 1u, tail.data(), tail.size(), out);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,81 @@
+// Transform.h
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Transform
+{
+    // Built-in stages, applied to the input bytes before any formatting.
+    enum class Kind : uint8_t
+    {
+        // Line endings: CRLF and lone CR become LF, or every line break becomes CRLF.
+        Lf = 0,
+        Crlf,
+        // Spaces and tabs before a line break or the end of the input.
+        StripTrailing,
+        // C-family comments (// and /* */) outside string and character literals. A block comment
+        // between two tokens leaves one space.
+        StripComments,
+        // Whitespace outside JSON strings.
+        MinifyJson,
+        // GLSL (and other C-preprocessed shader source): comments removed, whitespace collapsed to
+        // what separates tokens, preprocessor directives kept on lines of their own.
+        MinifyGlsl,
+        // Appends one zero byte, so the embedded text can be used as a C string.
+        NulTerminate
+    };
+
+    using Spec = std::vector<Kind>;
+
+    // One step of a pipeline. Input arrives in pieces split at arbitrary points, so a stage keeps
+    // whatever state spans them (an open comment, held-back whitespace) in the object.
+    class Stage
+    {
+    public:
+        virtual ~Stage() = default;
+
+        // Transforms the next piece of the input, appending the result to out.
+        virtual void Process(const uint8_t* data, size_t size, std::vector<uint8_t>& out) = 0;
+
+        // End of input: appends anything still held back.
+        virtual void Finish(std::vector<uint8_t>& out) { (void)out; }
+    };
+
+    std::unique_ptr<Stage> CreateStage(Kind kind);
+
+    // Command line names ("lf", "minify-glsl", ...); ParseSpec takes a comma-separated list.
+    const char* KindName(Kind kind);
+    bool ParseSpec(const std::wstring& list, Spec& spec, std::wstring& err);
+    std::string Describe(const Spec& spec);
+
+    // Runs the input through its stages CHUNK_BYTES at a time: each stage's output for one chunk
+    // is the next stage's input, so no intermediate result is ever held whole and nothing goes
+    // through a temp file. Only the final bytes accumulate, for the formatter to read.
+    class Pipeline final
+    {
+    public:
+        static constexpr size_t CHUNK_BYTES = 64u * 1024u;
+
+        Pipeline() = default;
+        explicit Pipeline(const Spec& spec);
+
+        // Stages run in the order they were added; callers may add their own.
+        void Add(std::unique_ptr<Stage> stage);
+        bool Empty() const noexcept { return m_stages.empty(); }
+
+        // Replaces out with the transformed input; false when cancelled part way.
+        bool Run(const uint8_t* data, size_t size, const Threading::CancelToken& cancel, std::vector<uint8_t>& out);
+
+    private:
+        void Push(size_t first, const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+        std::vector<std::unique_ptr<Stage>> m_stages;
+        std::vector<std::vector<uint8_t>> m_scratch;
+    };
+}
@@ -0,0 +1,424 @@
+// Tuning.cpp
+#include "Tuning.h"
+#include "FileMapping.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace EmbedPack::Tuning
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr uint32_t MIN_FLUSH_BYTES = 64u * 1024u;
+        constexpr uint32_t MAX_FLUSH_BYTES = 256u * 1024u * 1024u;
+        constexpr uint64_t MAX_MEMORY_BUDGET = 1ull << 48u;
+        constexpr uint32_t MAX_READ_AHEAD_BYTES = 1024u * 1024u * 1024u;
+
+        constexpr size_t MIB = 1024u * 1024u;
+
+        // Synthetic input; random so the formatter sees every byte value.
+        constexpr size_t SAMPLE_BYTES = 16u * MIB;
+        // Per thread-count and format-rate measurement.
+        constexpr auto MEASURE_WINDOW = std::chrono::milliseconds(250);
+        // Input formatted and written per flush-size candidate.
+        constexpr size_t WRITE_SAMPLE_BYTES = 16u * MIB;
+        // A smaller setting within this fraction of the best one wins: less memory, same speed.
+        constexpr double GOOD_ENOUGH = 0.95;
+
+        static double ElapsedMs(Clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        static double MiBps(double bytes, double ms)
+        {
+            return (ms > 0.0) ? (bytes / static_cast<double>(MIB)) / (ms / 1000.0) : 0.0;
+        }
+
+        static std::wstring FormatRate(double mbps)
+        {
+            wchar_t buf[32];
+            std::swprintf(buf, 32, L"%.1f MB/s", mbps);
+            return buf;
+        }
+
+        static void AppendKey(std::string& out, const char* key, const std::string& value)
+        {
+            out.append(key);
+            out.push_back('=');
+            out.append(value);
+            out.append("\r\n");
+        }
+
+        static std::string FormatDouble(double value)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.1f", value);
+            return buf;
+        }
+
+        static bool ParseU64(const std::string& text, uint64_t lo, uint64_t hi, uint64_t& value)
+        {
+            if (text.empty() || text[0] < '0' || text[0] > '9')
+                return false;
+
+            char* end = nullptr;
+            const unsigned long long n = std::strtoull(text.c_str(), &end, 10);
+            if (end == nullptr || *end != '\0' || n < lo || n > hi)
+                return false;
+
+            value = n;
+            return true;
+        }
+
+        static std::vector<uint8_t> MakeSample()
+        {
+            std::vector<uint8_t> data(SAMPLE_BYTES);
+            uint64_t x = 0x9E3779B97F4A7C15ull;
+            for (uint8_t& b : data)
+            {
+                x ^= x << 13u;
+                x ^= x >> 7u;
+                x ^= x << 17u;
+                b = static_cast<uint8_t>(x >> 56u);
+            }
+            return data;
+        }
+
+        // Input bytes per second over MEASURE_WINDOW with threads formatting 1 MiB pieces of the
+        // shared sample concurrently.
+        static double MeasureFormat(const std::vector<uint8_t>& sample, size_t threads)
+        {
+            std::atomic<uint64_t> total{ 0 };
+            const Clock::time_point start = Clock::now();
+            const Clock::time_point deadline = start + MEASURE_WINDOW;
+
+            auto work = [&](size_t index) {
+                Converter::Format fmt;
+                std::string text;
+                std::wstring err;
+                uint64_t done = 0u;
+                size_t at = (index * MIB) % sample.size();
+                while (Clock::now() < deadline)
+                {
+                    text.clear();
+                    Converter::FormatArray("sample", sample.data() + at, MIB, fmt, text, err);
+                    done += MIB;
+                    at = (at + MIB) % sample.size();
+                }
+                total.fetch_add(done, std::memory_order_relaxed);
+            };
+
+            std::vector<std::thread> pool;
+            for (size_t i = 1u; i < threads; ++i)
+                pool.emplace_back(work, i);
+            work(0u);
+            for (std::thread& t : pool)
+                t.join();
+
+            return MiBps(static_cast<double>(total.load()), ElapsedMs(start));
+        }
+
+        // Emulates the large-mode loop: format about flushBytes of text, write it, repeat; then
+        // flush to disk. Returns input MB/s end to end, and the output text rate in textMBps.
+        static bool MeasureFlush(
+            const std::wstring& scratchPath,
+            const std::vector<uint8_t>& sample,
+            uint32_t flushBytes,
+            double& inputMBps,
+            double& textMBps,
+            std::wstring& err)
+        {
+            FileIo::Handle h(CreateFileW(
+                scratchPath.c_str(),
+                GENERIC_WRITE,
+                0,
+                nullptr,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE,
+                nullptr));
+            if (!h.valid())
+            {
+                err = L"Failed to create the calibration scratch file.";
+                return false;
+            }
+
+            // A uchar token plus separator is 6 characters per input byte.
+            const size_t piece = std::max<size_t>(16u, (flushBytes / 6u) & ~size_t{ 15 });
+
+            Converter::Format fmt;
+            std::string text;
+            text.reserve(flushBytes + flushBytes / 8u);
+            uint64_t written = 0u;
+
+            const Clock::time_point start = Clock::now();
+            for (size_t done = 0u; done < WRITE_SAMPLE_BYTES; done += piece)
+            {
+                const size_t n = std::min(piece, WRITE_SAMPLE_BYTES - done);
+                text.clear();
+                if (!Converter::FormatArray("sample", sample.data() + (done % sample.size()), n, fmt, text, err) ||
+                    !FileIo::WriteAll(h, text.data(), static_cast<DWORD>(text.size()), err))
+                    return false;
+                written += text.size();
+            }
+            FlushFileBuffers(h);
+            const double ms = ElapsedMs(start);
+
+            inputMBps = MiBps(static_cast<double>(WRITE_SAMPLE_BYTES), ms);
+            textMBps = MiBps(static_cast<double>(written), ms);
+            return true;
+        }
+    }
+
+    std::wstring DefaultProfilePath()
+    {
+        wchar_t buf[MAX_PATH];
+        DWORD n = GetEnvironmentVariableW(L"EMBEDPACK_PROFILE", buf, MAX_PATH);
+        if (n > 0u && n < MAX_PATH)
+            return std::wstring(buf, n);
+
+        n = GetEnvironmentVariableW(L"LOCALAPPDATA", buf, MAX_PATH);
+        if (n == 0u || n >= MAX_PATH)
+            return {};
+        return std::wstring(buf, n) + L"\\EmbedPack\\tuning.ini";
+    }
+
+    bool LoadProfile(const std::wstring& path, Profile& p, std::wstring& err)
+    {
+        FileIo::MappedInput input;
+        if (!FileIo::MapInputFile(path, input, err))
+            return false;
+
+        const char* text = reinterpret_cast<const char*>(input.data());
+        Profile loaded;
+        size_t pos = 0u;
+        while (pos < input.size)
+        {
+            size_t eol = pos;
+            while (eol < input.size && text[eol] != '\n')
+                ++eol;
+            std::string line(text + pos, eol - pos);
+            pos = eol + 1u;
+
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty() || line[0] == ';' || line[0] == '#')
+                continue;
+
+            const size_t eq = line.find('=');
+            if (eq == std::string::npos)
+                continue;
+
+            const std::string key = line.substr(0u, eq);
+            const std::string value = line.substr(eq + 1u);
+            uint64_t n = 0u;
+            bool ok = true;
+            if (key == "flush_bytes")
+            {
+                ok = ParseU64(value, MIN_FLUSH_BYTES, MAX_FLUSH_BYTES, n);
+                loaded.flushBytes = static_cast<uint32_t>(n);
+            }
+            else if (key == "progress_tick_ms")
+            {
+                ok = ParseU64(value, 15u, 5000u, n);
+                loaded.progressTickMs = static_cast<uint32_t>(n);
+            }
+            else if (key == "memory_budget")
+            {
+                ok = ParseU64(value, 0u, MAX_MEMORY_BUDGET, n);
+                loaded.memoryBudget = n;
+            }
+            else if (key == "worker_threads")
+            {
+                ok = ParseU64(value, 0u, MAX_WORKER_THREADS, n);
+                loaded.workerThreads = static_cast<uint32_t>(n);
+            }
+            else if (key == "read_ahead_bytes")
+            {
+                ok = ParseU64(value, 0u, MAX_READ_AHEAD_BYTES, n);
+                loaded.readAheadBytes = static_cast<uint32_t>(n);
+            }
+            else if (key == "prefetch_thread")
+            {
+                ok = ParseU64(value, 0u, 1u, n);
+                loaded.prefetchThread = (n != 0u);
+            }
+            else if (key == "format_mbps")
+            {
+                loaded.formatMBps = std::strtod(value.c_str(), nullptr);
+            }
+            else if (key == "write_mbps")
+            {
+                loaded.writeMBps = std::strtod(value.c_str(), nullptr);
+            }
+
+            if (!ok)
+            {
+                err = L"Invalid value for " + std::wstring(key.begin(), key.end()) + L" in the tuning profile.";
+                return false;
+            }
+        }
+
+        p = loaded;
+        return true;
+    }
+
+    bool SaveProfile(const std::wstring& path, const Profile& p, std::wstring& err)
+    {
+        std::string data = "; EmbedPack tuning profile, written by 'EmbedPack calibrate'.\r\n";
+        AppendKey(data, "flush_bytes", std::to_string(p.flushBytes));
+        AppendKey(data, "progress_tick_ms", std::to_string(p.progressTickMs));
+        AppendKey(data, "memory_budget", std::to_string(p.memoryBudget));
+        AppendKey(data, "worker_threads", std::to_string(p.workerThreads));
+        AppendKey(data, "read_ahead_bytes", std::to_string(p.readAheadBytes));
+        AppendKey(data, "prefetch_thread", p.prefetchThread ? "1" : "0");
+        AppendKey(data, "format_mbps", FormatDouble(p.formatMBps));
+        AppendKey(data, "write_mbps", FormatDouble(p.writeMBps));
+
+        const size_t slash = path.find_last_of(L"\\/");
+        if (slash != std::wstring::npos)
+            CreateDirectoryW(path.substr(0u, slash).c_str(), nullptr);
+
+        const std::wstring tmp = path + L".tmp";
+        {
+            FileIo::Handle h(CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+            if (!h.valid())
+            {
+                err = L"Failed to create the tuning profile.";
+                return false;
+            }
+            if (!FileIo::WriteAll(h, data.data(), static_cast<DWORD>(data.size()), err))
+                return false;
+        }
+
+        if (!MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            DeleteFileW(tmp.c_str());
+            err = L"Failed to replace the tuning profile.";
+            return false;
+        }
+        return true;
+    }
+
+    const Profile& Active()
+    {
+        // A broken profile is ignored rather than failing every conversion.
+        static const Profile profile = [] {
+            Profile p;
+            std::wstring err;
+            const std::wstring path = DefaultProfilePath();
+            if (!path.empty() && GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES)
+                LoadProfile(path, p, err);
+            return p;
+        }();
+        return profile;
+    }
+
+    size_t WorkerThreads(const Profile& p)
+    {
+        if (p.workerThreads != 0u)
+            return std::min(p.workerThreads, MAX_WORKER_THREADS);
+        return std::min<size_t>(Converter::MAX_CONCURRENT_JOBS, std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    bool Calibrate(const std::wstring& scratchDir, Profile& out, const LogFn& log, std::wstring& err)
+    {
+        const std::vector<uint8_t> sample = MakeSample();
+        Profile p;
+        // Policies rather than measurements, so values set by hand survive recalibration.
+        const Profile& active = Active();
+        p.memoryBudget = active.memoryBudget;
+        p.readAheadBytes = active.readAheadBytes;
+        p.prefetchThread = active.prefetchThread;
+
+        // Warm-up so page faults on the sample and the first text buffer are not measured.
+        MeasureFormat(sample, 1u);
+
+        p.formatMBps = MeasureFormat(sample, 1u);
+
+        // Powers of two up to the hardware thread count, plus the count itself.
+        const size_t hw = std::min<size_t>(MAX_WORKER_THREADS, std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<size_t> counts;
+        for (size_t t = 1u; t < hw; t *= 2u)
+            counts.push_back(t);
+        counts.push_back(hw);
+
+        std::vector<double> rates;
+        for (const size_t t : counts)
+        {
+            rates.push_back(t == 1u ? p.formatMBps : MeasureFormat(sample, t));
+            log(L"format, " + std::to_wstring(t) + L" thread(s): " + FormatRate(rates.back()));
+        }
+
+        const double bestRate = *std::max_element(rates.begin(), rates.end());
+        for (size_t i = 0u; i < counts.size(); ++i)
+        {
+            if (rates[i] >= bestRate * GOOD_ENOUGH)
+            {
+                p.workerThreads = static_cast<uint32_t>(counts[i]);
+                break;
+            }
+        }
+
+        std::wstring scratch = scratchDir;
+        if (!scratch.empty() && scratch.back() != L'\\' && scratch.back() != L'/')
+            scratch.push_back(L'\\');
+        scratch += L"embedpack-calibrate.tmp";
+
+        std::vector<uint32_t> flushSizes;
+        std::vector<double> flushRates;
+        std::vector<double> textRates;
+        for (uint32_t size = 1u * MIB; size <= 32u * MIB; size *= 2u)
+        {
+            // Best of two runs; a single pass is easily skewed by cache write-back from the last one.
+            double inputRate = 0.0;
+            double textRate = 0.0;
+            for (int run = 0; run < 2; ++run)
+            {
+                double in = 0.0;
+                double text = 0.0;
+                if (!MeasureFlush(scratch, sample, size, in, text, err))
+                    return false;
+                if (in > inputRate)
+                {
+                    inputRate = in;
+                    textRate = text;
+                }
+            }
+
+            flushSizes.push_back(size);
+            flushRates.push_back(inputRate);
+            textRates.push_back(textRate);
+            log(L"format+write, " + std::to_wstring(size / MIB) + L" MiB flushes: " + FormatRate(inputRate) +
+                L" in, " + FormatRate(textRate) + L" out");
+        }
+
+        const double bestFlush = *std::max_element(flushRates.begin(), flushRates.end());
+        for (size_t i = 0u; i < flushSizes.size(); ++i)
+        {
+            if (flushRates[i] >= bestFlush * GOOD_ENOUGH)
+            {
+                p.flushBytes = flushSizes[i];
+                p.writeMBps = textRates[i];
+                break;
+            }
+        }
+
+        // Progress only moves once per flush, so ticking faster than two flushes buys nothing.
+        const double flushMs = (p.writeMBps > 0.0) ? (static_cast<double>(p.flushBytes) / MIB) / p.writeMBps * 1000.0 : 0.0;
+        p.progressTickMs = static_cast<uint32_t>(std::clamp(2.0 * flushMs, 60.0, 250.0));
+
+        log(L"profile: " + std::to_wstring(p.workerThreads) + L" worker threads, " + std::to_wstring(p.flushBytes / MIB) +
+            L" MiB flushes, " + std::to_wstring(p.progressTickMs) + L" ms progress tick");
+
+        out = p;
+        return true;
+    }
+}
@@ -0,0 +1,57 @@
+// Tuning.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace EmbedPack::Tuning
+{
+    constexpr uint32_t DEFAULT_FLUSH_BYTES      = 8u * 1024u * 1024u;
+    constexpr uint32_t DEFAULT_PROGRESS_TICK_MS = 120u;
+    constexpr uint32_t DEFAULT_READ_AHEAD_BYTES = 32u * 1024u * 1024u;
+    constexpr uint32_t MAX_WORKER_THREADS       = 64u;
+
+    // Host-specific knobs. Defaults are the built-in values used when no profile exists.
+    struct Profile
+    {
+        // Large mode writes whenever this much output text is pending.
+        uint32_t flushBytes = DEFAULT_FLUSH_BYTES;
+        // Minimum interval between progress notifications.
+        uint32_t progressTickMs = DEFAULT_PROGRESS_TICK_MS;
+        // In-memory outputs may hold this much at once before new ones spill to a temp file;
+        // 0 uses half of the physical memory available when a job starts (see MemoryBudget.h).
+        uint64_t memoryBudget = 0u;
+        // Conversion jobs running at once; 0 keeps min(MAX_CONCURRENT_JOBS, hardware threads).
+        uint32_t workerThreads = 0u;
+        // Input prefetched ahead of the formatter; 0 leaves it to page faults alone.
+        uint32_t readAheadBytes = DEFAULT_READ_AHEAD_BYTES;
+        // A helper thread faults the prefetched pages in ahead of the formatter.
+        bool prefetchThread = false;
+
+        // Measured rates, kept for reference only.
+        double formatMBps = 0.0;
+        double writeMBps = 0.0;
+    };
+
+    // %LOCALAPPDATA%\EmbedPack\tuning.ini, or EMBEDPACK_PROFILE when that is set.
+    std::wstring DefaultProfilePath();
+
+    // key=value lines; unknown keys are ignored, out-of-range values fail the load.
+    bool LoadProfile(const std::wstring& path, Profile& p, std::wstring& err);
+    bool SaveProfile(const std::wstring& path, const Profile& p, std::wstring& err);
+
+    // Loaded from DefaultProfilePath() on first use and fixed for the life of the process.
+    const Profile& Active();
+
+    size_t WorkerThreads(const Profile& p);
+
+    using LogFn = std::function<void(const std::wstring& line)>;
+
+    // Short micro-benchmarks on this machine: single-thread format rate, format throughput per
+    // concurrent thread count, and write throughput per buffer size (through a scratch file in
+    // scratchDir, which should sit on the disk outputs go to). Takes a few seconds.
+    bool Calibrate(const std::wstring& scratchDir, Profile& out, const LogFn& log, std::wstring& err);
+}
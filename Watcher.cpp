@@ -0,0 +1,423 @@
+// Watcher.cpp
+#include "Watcher.h"
+#include "FileMapping.h"
+#include "Hashing.h"
+#include "JobStats.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <memory>
+#include <utility>
+
+namespace EmbedPack::Watch
+{
+    namespace
+    {
+        // Editors often hold the file open exclusively for a moment after a change notification.
+        constexpr uint32_t MAX_OPEN_RETRIES = 20u;
+        // Completion of in-flight conversions is polled at this interval.
+        constexpr DWORD POLL_MS = 50u;
+        constexpr DWORD NOTIFY_BUFFER_BYTES = 64u * 1024u;
+
+        struct Entry
+        {
+            WatchItem item;
+            std::wstring fileName;
+
+            ULONGLONG deadline = 0u; // 0 = nothing scheduled
+            uint32_t openRetries = 0u;
+
+            bool hasHash = false;
+            Hashing::Sha256Digest lastHash{};
+            Hashing::Sha256Digest pendingHash{};
+            Converter::Job pendingJob{};
+            Converter::ConversionHandle pending;
+        };
+
+        // One overlapped ReadDirectoryChangesW per directory. Not movable once armed: the kernel
+        // keeps pointers to ov and buffer.
+        struct DirWatch
+        {
+            std::wstring path;
+            FileIo::Handle dir;
+            FileIo::Handle event;
+            OVERLAPPED ov{};
+            std::vector<DWORD> buffer = std::vector<DWORD>(NOTIFY_BUFFER_BYTES / sizeof(DWORD));
+            std::vector<size_t> entries;
+
+            bool Arm()
+            {
+                ov = OVERLAPPED{};
+                ov.hEvent = event;
+                return ReadDirectoryChangesW(
+                    dir,
+                    buffer.data(),
+                    NOTIFY_BUFFER_BYTES,
+                    FALSE,
+                    FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE,
+                    nullptr,
+                    &ov,
+                    nullptr) != FALSE;
+            }
+        };
+
+        static std::wstring FullPath(const std::wstring& path)
+        {
+            wchar_t buf[MAX_PATH]{};
+            const DWORD n = GetFullPathNameW(path.c_str(), MAX_PATH, buf, nullptr);
+            if (n == 0u || n >= MAX_PATH)
+                return path;
+            return std::wstring(buf, n);
+        }
+
+        static bool SameName(const std::wstring& a, const std::wstring& b)
+        {
+            return _wcsicmp(a.c_str(), b.c_str()) == 0;
+        }
+
+        static bool GetWriteTime(const std::wstring& path, FILETIME& ft)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA fad{};
+            if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad))
+                return false;
+            ft = fad.ftLastWriteTime;
+            return true;
+        }
+
+        static bool HashFile(const std::wstring& path, Hashing::Sha256Digest& out, std::wstring& err)
+        {
+            FileIo::MappedInput input;
+            if (!FileIo::MapInputFile(path, input, err))
+                return false;
+
+            if (!Hashing::Sha256(input.data(), input.size, out))
+            {
+                err = L"SHA-256 computation failed.";
+                return false;
+            }
+            return true;
+        }
+
+        class Watcher final
+        {
+        public:
+            Watcher(const WatchOptions& opt, const LogFn& log) : m_opt(opt), m_log(log) {}
+
+            bool Init(const std::vector<WatchItem>& items, std::wstring& err);
+            void Run(HANDLE stopEvent);
+
+        private:
+            void OnNotify(DirWatch& d, DWORD bytes);
+            void Fire(Entry& e, ULONGLONG now);
+            void Reap();
+            // Starts every entry whose quiet period has elapsed; returns the next wait timeout.
+            DWORD FireDue(ULONGLONG now);
+            void Shutdown();
+
+            void Log(const std::wstring& line) const
+            {
+                if (m_log)
+                    m_log(line);
+            }
+
+            const WatchOptions& m_opt;
+            const LogFn& m_log;
+            std::vector<Entry> m_entries;
+            std::vector<std::unique_ptr<DirWatch>> m_dirs;
+        };
+
+        bool Watcher::Init(const std::vector<WatchItem>& items, std::wstring& err)
+        {
+            const ULONGLONG now = GetTickCount64();
+
+            m_entries.reserve(items.size());
+            for (const WatchItem& it : items)
+            {
+                Entry e;
+                e.item.inPath = FullPath(it.inPath);
+                e.item.outPath = FullPath(it.outPath);
+
+                const size_t slash = e.item.inPath.find_last_of(L"\\/");
+                const std::wstring dirPath = e.item.inPath.substr(0, slash + 1u);
+                e.fileName = e.item.inPath.substr(slash + 1u);
+
+                auto d = std::find_if(m_dirs.begin(), m_dirs.end(),
+                    [&](const std::unique_ptr<DirWatch>& w) { return SameName(w->path, dirPath); });
+
+                if (d == m_dirs.end())
+                {
+                    // The stop event takes one wait slot.
+                    if (m_dirs.size() + 1u >= MAXIMUM_WAIT_OBJECTS)
+                    {
+                        err = L"Too many watched directories.";
+                        return false;
+                    }
+
+                    auto w = std::make_unique<DirWatch>();
+                    w->path = dirPath;
+                    w->dir = FileIo::Handle(CreateFileW(
+                        dirPath.c_str(),
+                        FILE_LIST_DIRECTORY,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr,
+                        OPEN_EXISTING,
+                        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                        nullptr));
+                    w->event = FileIo::Handle(CreateEventW(nullptr, TRUE, FALSE, nullptr));
+
+                    if (!w->dir.valid() || !w->event.valid() || !w->Arm())
+                    {
+                        err = L"Cannot watch directory: " + dirPath;
+                        return false;
+                    }
+
+                    m_dirs.push_back(std::move(w));
+                    d = m_dirs.end() - 1;
+                }
+
+                (*d)->entries.push_back(m_entries.size());
+
+                // Outputs that are missing or older than their input are regenerated right away;
+                // up-to-date ones only record the input hash so a touch without edits is skipped.
+                FILETIME inTime{}, outTime{};
+                if (!GetWriteTime(e.item.inPath, inTime))
+                {
+                    err = L"Input not found: " + e.item.inPath;
+                    return false;
+                }
+
+                std::wstring hashErr;
+                if (!GetWriteTime(e.item.outPath, outTime) || CompareFileTime(&outTime, &inTime) < 0)
+                    e.deadline = now;
+                else
+                    e.hasHash = HashFile(e.item.inPath, e.lastHash, hashErr);
+
+                m_entries.push_back(std::move(e));
+            }
+
+            return true;
+        }
+
+        void Watcher::OnNotify(DirWatch& d, DWORD bytes)
+        {
+            const ULONGLONG deadline = GetTickCount64() + m_opt.debounceMs;
+
+            // A zero-byte completion means the buffer overflowed; every file in the directory
+            // may have changed.
+            if (bytes == 0u)
+            {
+                for (const size_t idx : d.entries)
+                    m_entries[idx].deadline = deadline;
+                return;
+            }
+
+            const auto* base = reinterpret_cast<const uint8_t*>(d.buffer.data());
+            size_t offset = 0u;
+            for (;;)
+            {
+                const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(base + offset);
+                const std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+                if (info->Action == FILE_ACTION_ADDED ||
+                    info->Action == FILE_ACTION_MODIFIED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    for (const size_t idx : d.entries)
+                    {
+                        Entry& e = m_entries[idx];
+                        if (SameName(e.fileName, name))
+                        {
+                            // Every further event in a burst pushes the deadline out again.
+                            e.deadline = deadline;
+                            e.openRetries = 0u;
+                        }
+                    }
+                }
+
+                if (info->NextEntryOffset == 0u)
+                    break;
+                offset += info->NextEntryOffset;
+            }
+        }
+
+        void Watcher::Fire(Entry& e, ULONGLONG now)
+        {
+            e.deadline = 0u;
+
+            Hashing::Sha256Digest digest{};
+            std::wstring err;
+            if (!HashFile(e.item.inPath, digest, err))
+            {
+                if (++e.openRetries < MAX_OPEN_RETRIES)
+                    e.deadline = now + m_opt.debounceMs;
+                else
+                    Log(L"skipped " + e.item.inPath + L": " + err);
+                return;
+            }
+            e.openRetries = 0u;
+
+            if (e.hasHash && digest == e.lastHash)
+            {
+                Log(L"unchanged " + e.item.inPath);
+                return;
+            }
+
+            Converter::Job job;
+            job.inPath = e.item.inPath;
+            job.outPath = e.item.outPath;
+            job.largeMode = true;
+            job.incremental = m_opt.incremental;
+            job.mappedOutput = m_opt.mappedOutput;
+            job.format = m_opt.format;
+            job.transforms = m_opt.transforms;
+
+            e.pending = Converter::StartConversionAsync(job);
+            if (!e.pending.Valid())
+            {
+                // Pool queue is full; try again after another quiet period.
+                e.deadline = now + m_opt.debounceMs;
+                return;
+            }
+
+            e.pendingHash = digest;
+            e.pendingJob = job;
+            Log(L"converting " + e.item.inPath);
+        }
+
+        void Watcher::Reap()
+        {
+            for (Entry& e : m_entries)
+            {
+                if (!e.pending.Valid() || !e.pending.IsReady())
+                    continue;
+
+                Converter::ConversionResult r = e.pending.Take();
+                e.pending = Converter::ConversionHandle{};
+
+                std::wstring err;
+                if (m_opt.writeStats && !Stats::WriteJson(Stats::SidecarPath(e.item.outPath), e.pendingJob, r, err))
+                    Log(L"warning: " + err);
+
+                if (r.ok)
+                {
+                    e.lastHash = e.pendingHash;
+                    e.hasHash = true;
+                    Log(L"updated " + e.item.outPath + L" (" + std::to_wstring(static_cast<uint64_t>(r.stats.elapsedMs)) + L" ms)");
+                }
+                else
+                {
+                    Log(L"failed " + e.item.inPath + L": " + r.message);
+                }
+            }
+        }
+
+        DWORD Watcher::FireDue(ULONGLONG now)
+        {
+            DWORD timeout = INFINITE;
+            for (Entry& e : m_entries)
+            {
+                if (e.pending.Valid())
+                    timeout = std::min(timeout, POLL_MS);
+
+                if (e.deadline == 0u)
+                    continue;
+
+                if (now >= e.deadline)
+                {
+                    // A conversion of the previous content is still running; wait for it so
+                    // the output is not written by two jobs at once.
+                    if (e.pending.Valid())
+                        continue;
+
+                    Fire(e, now);
+                    if (e.pending.Valid())
+                        timeout = std::min(timeout, POLL_MS);
+                }
+
+                if (e.deadline != 0u)
+                    timeout = std::min(timeout, static_cast<DWORD>(std::max<ULONGLONG>(e.deadline, now + 1u) - now));
+            }
+            return timeout;
+        }
+
+        void Watcher::Run(HANDLE stopEvent)
+        {
+            // watched[i] owns handles[i + 1]; both drop a directory that can no longer be armed,
+            // so wait positions never index m_dirs.
+            std::vector<HANDLE> handles;
+            std::vector<DirWatch*> watched;
+            handles.push_back(stopEvent);
+            for (const auto& d : m_dirs)
+            {
+                handles.push_back(d->event);
+                watched.push_back(d.get());
+            }
+
+            for (;;)
+            {
+                Reap();
+                const DWORD timeout = FireDue(GetTickCount64());
+
+                const DWORD w = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, timeout);
+                if (w == WAIT_OBJECT_0 || w == WAIT_FAILED)
+                    break;
+                if (w == WAIT_TIMEOUT)
+                    continue;
+
+                const size_t index = w - WAIT_OBJECT_0 - 1u;
+                DirWatch& d = *watched[index];
+                DWORD bytes = 0u;
+                if (GetOverlappedResult(d.dir, &d.ov, &bytes, FALSE))
+                    OnNotify(d, bytes);
+                ResetEvent(d.event);
+
+                if (!d.Arm())
+                {
+                    Log(L"stopped watching " + d.path);
+                    handles.erase(handles.begin() + static_cast<std::ptrdiff_t>(index) + 1);
+                    watched.erase(watched.begin() + static_cast<std::ptrdiff_t>(index));
+                }
+            }
+
+            Shutdown();
+        }
+
+        void Watcher::Shutdown()
+        {
+            for (const auto& d : m_dirs)
+            {
+                DWORD bytes = 0u;
+                if (CancelIoEx(d->dir, &d->ov))
+                    GetOverlappedResult(d->dir, &d->ov, &bytes, TRUE);
+            }
+
+            for (Entry& e : m_entries)
+                e.pending.Cancel();
+            for (Entry& e : m_entries)
+                e.pending.Wait();
+        }
+    }
+
+    bool RunWatch(
+        const std::vector<WatchItem>& items,
+        const WatchOptions& opt,
+        HANDLE stopEvent,
+        const LogFn& log,
+        std::wstring& err)
+    {
+        err.clear();
+
+        if (items.empty())
+        {
+            err = L"Nothing to watch.";
+            return false;
+        }
+
+        Watcher w(opt, log);
+        if (!w.Init(items, err))
+            return false;
+
+        w.Run(stopEvent);
+        return true;
+    }
+}
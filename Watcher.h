@@ -0,0 +1,45 @@
+// Watcher.h
+#pragma once
+
+#include "CoreServices.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace EmbedPack::Watch
+{
+    struct WatchItem
+    {
+        std::wstring inPath;
+        std::wstring outPath;
+    };
+
+    struct WatchOptions
+    {
+        Converter::Format format{};
+        // Input transforms (Job::transforms), applied to every file.
+        Transform::Spec transforms;
+        // Quiet period after the last change notification before a file is regenerated.
+        uint32_t debounceMs = 250u;
+        // Patch outputs in place from their block manifests instead of rewriting them.
+        bool incremental = false;
+        // Format full rewrites straight into a mapped output file (Job::mappedOutput).
+        bool mappedOutput = false;
+        // Write a JSON stats sidecar next to every regenerated output.
+        bool writeStats = false;
+    };
+
+    using LogFn = std::function<void(const std::wstring&)>;
+
+    // Blocks until stopEvent is signalled. Changed inputs are hashed on the watcher thread and
+    // regenerated on the converter's worker pool; content that hashes the same as the last
+    // successful conversion is skipped.
+    bool RunWatch(
+        const std::vector<WatchItem>& items,
+        const WatchOptions& opt,
+        HANDLE stopEvent,
+        const LogFn& log,
+        std::wstring& err);
+}
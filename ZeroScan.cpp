@@ -0,0 +1,153 @@
+// ZeroScan.cpp
+#include "ZeroScan.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define EMBEDPACK_ZEROSCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace EmbedPack::ZeroScan
+{
+    namespace
+    {
+#if defined(EMBEDPACK_ZEROSCAN_SSE2)
+        static inline __m128i Load(const uint8_t* p) noexcept
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+        static inline bool IsZero(__m128i v) noexcept
+        {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+        }
+
+        static inline bool IsZeroLine(const uint8_t* p) noexcept
+        {
+            return IsZero(Load(p));
+        }
+
+        // Four lines per test while inside a long run.
+        static inline bool IsZeroQuad(const uint8_t* p) noexcept
+        {
+            const __m128i a = _mm_or_si128(Load(p), Load(p + 16));
+            const __m128i b = _mm_or_si128(Load(p + 32), Load(p + 48));
+            return IsZero(_mm_or_si128(a, b));
+        }
+#else
+        static inline uint64_t Read64(const uint8_t* p) noexcept
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static inline bool IsZeroLine(const uint8_t* p) noexcept
+        {
+            return (Read64(p) | Read64(p + 8)) == 0u;
+        }
+
+        static inline bool IsZeroQuad(const uint8_t* p) noexcept
+        {
+            uint64_t acc = 0u;
+            for (size_t i = 0u; i < 64u; i += 8u)
+                acc |= Read64(p + i);
+            return acc == 0u;
+        }
+#endif
+
+        static bool IsZeroBytes(const uint8_t* p, size_t n) noexcept
+        {
+            for (size_t i = 0u; i < n; ++i)
+            {
+                if (p[i] != 0u)
+                    return false;
+            }
+            return true;
+        }
+
+        // Consecutive all-zero whole lines starting at line.
+        static size_t CountZeroLines(const uint8_t* data, size_t line, size_t lines) noexcept
+        {
+            size_t i = line;
+            while (i + 4u <= lines && IsZeroQuad(data + i * LINE_BYTES))
+                i += 4u;
+            while (i < lines && IsZeroLine(data + i * LINE_BYTES))
+                ++i;
+            return i - line;
+        }
+
+        // Consecutive whole lines with at least one non-zero byte starting at line.
+        static size_t CountDataLines(const uint8_t* data, size_t line, size_t lines) noexcept
+        {
+            size_t i = line;
+            while (i < lines && !IsZeroLine(data + i * LINE_BYTES))
+                ++i;
+            return i - line;
+        }
+    }
+
+    size_t TrimmedSize(const uint8_t* data, size_t size)
+    {
+        size_t end = size;
+        const size_t partial = size % LINE_BYTES;
+        while (partial != 0u && end > size - partial && data[end - 1u] == 0u)
+            --end;
+        if (end != size - partial)
+            return end;
+
+        while (end >= LINE_BYTES && IsZeroLine(data + end - LINE_BYTES))
+            end -= LINE_BYTES;
+        while (end > 0u && data[end - 1u] == 0u)
+            --end;
+        return end;
+    }
+
+    std::vector<Segment> FindSegments(const uint8_t* data, size_t size, size_t minGapBytes)
+    {
+        std::vector<Segment> segments;
+
+        const size_t lines = size / LINE_BYTES;
+        const size_t tail = size % LINE_BYTES;
+        const size_t minGapLines = std::max<size_t>(1u, minGapBytes / LINE_BYTES);
+
+        bool open = false;
+        size_t line = 0u;
+        while (line < lines)
+        {
+            const size_t zeros = CountZeroLines(data, line, lines);
+            if (zeros != 0u)
+            {
+                // A short interior run is cheaper to emit than a new segment; leave it inside.
+                if (open && (zeros >= minGapLines || line + zeros == lines))
+                    open = false;
+                line += zeros;
+                continue;
+            }
+
+            const size_t run = CountDataLines(data, line, lines);
+            if (!open)
+            {
+                segments.push_back({ line * LINE_BYTES, 0u });
+                open = true;
+            }
+            line += run;
+            segments.back().end = line * LINE_BYTES;
+        }
+
+        if (tail != 0u && !IsZeroBytes(data + lines * LINE_BYTES, tail))
+        {
+            // A closed segment right before the tail still counts the zero lines between them.
+            const size_t lastEnd = segments.empty() ? 0u : segments.back().end;
+            const size_t gapLines = lines - lastEnd / LINE_BYTES;
+            if (segments.empty() || gapLines >= minGapLines)
+                segments.push_back({ lines * LINE_BYTES, size });
+            else
+                segments.back().end = size;
+        }
+
+        return segments;
+    }
+}
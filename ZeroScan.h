@@ -0,0 +1,28 @@
+// ZeroScan.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace EmbedPack::ZeroScan
+{
+    // Bytes per scanned line; matches the 16 input bytes of one generated line.
+    constexpr size_t LINE_BYTES = 16u;
+
+    // Non-zero span of the input, [begin, end). begin is a multiple of LINE_BYTES; end is one too
+    // unless it is the end of the input.
+    struct Segment
+    {
+        size_t begin = 0u;
+        size_t end = 0u;
+    };
+
+    // Length of the input without its trailing zero bytes.
+    size_t TrimmedSize(const uint8_t* data, size_t size);
+
+    // Splits the input at zero runs of at least minGapBytes (rounded down to whole lines).
+    // Leading and trailing zeros never belong to a segment; shorter interior runs stay inside
+    // the surrounding segment. An all-zero input yields no segments.
+    std::vector<Segment> FindSegments(const uint8_t* data, size_t size, size_t minGapBytes);
+}
@@ -0,0 +1,198 @@
+# EmbedPack.cmake
+#
+# embedpack_add_resources(<target>
+#     FILES <file>...
+#     [OUTPUT_DIR <dir>]
+#     [FORMAT uchar|uint8|byte|ushort|uint16|uint32|uint64]
+#     [STYLE const|static-const|constexpr|constexpr-array|static-constexpr-array]
+#     [BYTE_ORDER little|big] [ALIGN <n>] [SECTION <name>] [PAD none|cache-line|page]
+#     [CHECKSUM none|crc32c|xxh64|both] [ZEROS keep|trim|sparse] [TEXT never|auto]
+#     [TRANSFORM <stage>[,<stage>...]]
+#     [INCREMENTAL] [MAPPED]
+#     [LARGE_THRESHOLD <bytes>])
+#
+# Adds one custom command per file that runs 'EmbedPack convert' when the file or the converter
+# changes, so a build regenerates only the assets that changed. Every file becomes
+# <OUTPUT_DIR>/<name>_bytes.h, where <name> is the file name made a C identifier; OUTPUT_DIR
+# (default ${CMAKE_CURRENT_BINARY_DIR}/embedpack/<target>) is added to the target's include path.
+#
+# Files of LARGE_THRESHOLD bytes or more (default 1 MiB, measured at configure time) are not
+# meant to be included: each one is converted with --mapped and compiled once in its own
+# generated translation unit, in parallel with the rest of the target, behind an accessor
+# declared in <name>_resource.h:
+#
+#     EmbedPackResource embedpack::resources::<name>() noexcept;  // { data, size }
+#
+# Names must be unique per target across calls, since the accessors share one namespace.
+#
+# ZEROS sparse headers have no contiguous array and always stay header-only.
+#
+# TRANSFORM takes the comma-separated stages of 'convert --transform' (for example
+# "strip-comments,minify-glsl,nul" for shaders); LARGE_THRESHOLD compares the file before them.
+#
+# The converter is the EmbedPack target of this project, or EMBEDPACK_EXECUTABLE when set (a
+# prebuilt copy, for cross builds).
+
+set(EMBEDPACK_EXECUTABLE "" CACHE FILEPATH "Prebuilt EmbedPack.exe used by embedpack_add_resources(); empty uses the EmbedPack target.")
+
+function(embedpack_add_resources target)
+    cmake_parse_arguments(PARSE_ARGV 1 EP
+        "INCREMENTAL;MAPPED"
+        "OUTPUT_DIR;FORMAT;STYLE;BYTE_ORDER;ALIGN;SECTION;PAD;CHECKSUM;ZEROS;TEXT;TRANSFORM;LARGE_THRESHOLD"
+        "FILES")
+
+    if (EP_UNPARSED_ARGUMENTS)
+        message(FATAL_ERROR "embedpack_add_resources: unknown arguments: ${EP_UNPARSED_ARGUMENTS}")
+    endif()
+    if (NOT TARGET ${target})
+        message(FATAL_ERROR "embedpack_add_resources: '${target}' is not a target.")
+    endif()
+    if (NOT EP_FILES)
+        message(FATAL_ERROR "embedpack_add_resources: FILES is empty.")
+    endif()
+
+    if (EMBEDPACK_EXECUTABLE)
+        set(tool "${EMBEDPACK_EXECUTABLE}")
+        set(tool_dep "${EMBEDPACK_EXECUTABLE}")
+    elseif (TARGET EmbedPack)
+        set(tool "$<TARGET_FILE:EmbedPack>")
+        set(tool_dep EmbedPack)
+    else()
+        message(FATAL_ERROR "embedpack_add_resources: no EmbedPack target; set EMBEDPACK_EXECUTABLE.")
+    endif()
+
+    if (NOT EP_OUTPUT_DIR)
+        set(EP_OUTPUT_DIR "${CMAKE_CURRENT_BINARY_DIR}/embedpack/${target}")
+    endif()
+    if (NOT DEFINED EP_LARGE_THRESHOLD)
+        set(EP_LARGE_THRESHOLD 1048576)
+    endif()
+    file(MAKE_DIRECTORY "${EP_OUTPUT_DIR}")
+
+    # Keyword -> command line option; the values are checked by the converter.
+    set(format_args "")
+    foreach(pair FORMAT:type STYLE:style BYTE_ORDER:byte-order ALIGN:align SECTION:section
+                 PAD:pad CHECKSUM:checksum ZEROS:zeros TEXT:text TRANSFORM:transform)
+        string(REPLACE ":" ";" pair "${pair}")
+        list(GET pair 0 keyword)
+        list(GET pair 1 option)
+        if (DEFINED EP_${keyword})
+            list(APPEND format_args "--${option}" "${EP_${keyword}}")
+        endif()
+    endforeach()
+    if (EP_INCREMENTAL)
+        list(APPEND format_args --incremental)
+    endif()
+
+    get_target_property(names ${target} EMBEDPACK_RESOURCE_NAMES)
+    if (NOT names)
+        set(names "")
+    endif()
+    set(headers "")
+    set(sources "")
+
+    foreach(file IN LISTS EP_FILES)
+        get_filename_component(input "${file}" ABSOLUTE BASE_DIR "${CMAKE_CURRENT_SOURCE_DIR}")
+        if (NOT EXISTS "${input}")
+            message(FATAL_ERROR "embedpack_add_resources: input not found: ${input}")
+        endif()
+
+        get_filename_component(file_name "${input}" NAME)
+        string(MAKE_C_IDENTIFIER "${file_name}" name)
+        if (name IN_LIST names)
+            message(FATAL_ERROR "embedpack_add_resources: more than one file maps to '${name}' in ${target}.")
+        endif()
+        list(APPEND names "${name}")
+
+        set(header "${EP_OUTPUT_DIR}/${name}_bytes.h")
+        file(SIZE "${input}" size)
+
+        set(large FALSE)
+        if (size GREATER_EQUAL EP_LARGE_THRESHOLD AND NOT EP_ZEROS STREQUAL "sparse")
+            set(large TRUE)
+        endif()
+
+        set(args ${format_args})
+        if (EP_MAPPED OR large)
+            list(APPEND args --mapped)
+        endif()
+
+        set(byproducts "")
+        if (EP_INCREMENTAL)
+            set(byproducts BYPRODUCTS "${header}.epm")
+        endif()
+
+        add_custom_command(
+            OUTPUT "${header}"
+            ${byproducts}
+            COMMAND "${tool}" convert "${input}" "${header}" ${args}
+            DEPENDS "${input}" ${tool_dep}
+            COMMENT "Embedding ${file_name}"
+            VERBATIM)
+        list(APPEND headers "${header}")
+
+        if (large)
+            set(source "${EP_OUTPUT_DIR}/${name}_bytes.cpp")
+            file(CONFIGURE OUTPUT "${source}" CONTENT [=[
+// Generated by embedpack_add_resources(); do not edit.
+#include "@name@_resource.h"
+
+// Included ahead of the namespace below, so the generated header's own includes are no-ops there.
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace
+{
+    namespace fallback
+    {
+        // Only padded headers declare fileBytesOriginalSize; theirs hides this one.
+        constexpr std::size_t fileBytesOriginalSize = static_cast<std::size_t>(-1);
+    }
+
+    namespace data
+    {
+        using namespace fallback;
+#include "@name@_bytes.h"
+    }
+}
+
+EmbedPackResource embedpack::resources::@name@() noexcept
+{
+    const std::size_t size = (data::fileBytesOriginalSize != fallback::fileBytesOriginalSize)
+        ? data::fileBytesOriginalSize
+        : data::fileBytesSize;
+    return { std::data(data::fileBytes), size };
+}
+]=] @ONLY)
+            file(CONFIGURE OUTPUT "${EP_OUTPUT_DIR}/${name}_resource.h" CONTENT [=[
+// Generated by embedpack_add_resources(); do not edit.
+#pragma once
+
+#include <cstddef>
+
+#ifndef EMBEDPACK_RESOURCE_DEFINED
+#define EMBEDPACK_RESOURCE_DEFINED
+struct EmbedPackResource
+{
+    const void* data;
+    std::size_t size;
+};
+#endif
+
+namespace embedpack::resources
+{
+    EmbedPackResource @name@() noexcept;
+}
+]=] @ONLY)
+            set_source_files_properties("${source}" PROPERTIES OBJECT_DEPENDS "${header}")
+            list(APPEND headers "${EP_OUTPUT_DIR}/${name}_resource.h")
+            list(APPEND sources "${source}")
+        endif()
+    endforeach()
+
+    set_property(TARGET ${target} PROPERTY EMBEDPACK_RESOURCE_NAMES "${names}")
+    target_sources(${target} PRIVATE ${headers} ${sources})
+    target_include_directories(${target} PRIVATE "${EP_OUTPUT_DIR}")
+endfunction()
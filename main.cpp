@@ -1,8 +1,13 @@
 // main.cpp
 #include "App.h"
+#include "CommandLine.h"
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow)
 {
+    int exitCode = 0;
+    if (EmbedPack::CommandLine::TryRun(exitCode))
+        return exitCode;
+
     EmbedPack::App app(hInstance);
     return app.Run(nCmdShow);
 }